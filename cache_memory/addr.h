@@ -30,6 +30,32 @@
 #define PHY_PAGE_NUM    20
 #define PHY_ADDR        32 // = PHY_PAGE_NUM + PAGE_OFFSET
 
+/* a PUD (resp. PMD) entry with this bit set maps a whole 1 GiB (resp. 2 MiB)
+* huge page, aligned on its size, instead of pointing to a PMD (resp. page table)
+*/
+#define PTE_HUGE        0x80
+#define PTE_ADDR_MASK   (~(uint32_t) (PAGE_SIZE - 1))
+
+typedef enum {
+    PAGE_4K, PAGE_2M, PAGE_1G,
+    NB_PAGE_SIZES // not a size, their number
+} page_size_t;
+
+// number of bits of the virtual page number (4 kiB) within a page of each size
+#define PAGE_SIZE_SHIFT(size) ((size) == PAGE_1G ? PTE_ENTRY + PMD_ENTRY : (size) == PAGE_2M ? PTE_ENTRY : 0)
+#define PAGE_SIZE_MASK(size)  ((UINT64_C(1) << PAGE_SIZE_SHIFT(size)) - 1)
+
+/* as on x86-64 with PCIDs, the root of an address space (CR3) is the physical
+* address of its PGD, whose page offset bits hold the ASID tagging its TLB entries;
+* CR3 0 is the PGD at the beginning of memory, with ASID 0
+*/
+#define ASID_BITS       PAGE_OFFSET
+#define CR3_PGD(cr3)    ((pte_t) ((cr3) & PTE_ADDR_MASK))
+#define CR3_ASID(cr3)   ((uint16_t) ((cr3) & (PAGE_SIZE - 1)))
+// to XOR into the index of direct-mapped structures: odd, so that distinct
+// ASIDs get distinct offsets in any power of two of lines (0 for ASID 0)
+#define ASID_HASH(asid) ((uint64_t) (asid) * UINT64_C(0x9E3779B1))
+
 
 typedef uint32_t word_t;
 
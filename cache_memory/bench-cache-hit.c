@@ -0,0 +1,156 @@
+/**
+ * @file bench-cache-hit.c
+ * @brief microbenchmark of cache lookups: cache_hit() on the fixed entries
+ * against rt_cache_hit() on the packed tags of the run-time caches
+ *
+ * Built twice by the Makefile: bench-cache-hit compares tags with SIMD
+ * instructions where available, bench-cache-hit-scalar one way at a time.
+ */
+
+//for clock_gettime() with -std=c11
+#define _POSIX_C_SOURCE 200809L
+
+#include "error.h"
+#include "cache_mng.h"
+#include "rt_cache_mng.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h> // for PRIu64
+
+#define BENCH_DEFAULT_LOOKUPS 10000000ul
+#define BENCH_ADDRESSES 4096 // replayed in a loop, hits and misses interleaved
+
+// ======================================================================
+//deterministic pseudo-random numbers (xorshift)
+static uint32_t next_random(uint32_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+static phy_addr_t to_paddr(uint32_t phy_addr)
+{
+    phy_addr_t paddr;
+    paddr.phy_page_num = phy_addr >> PAGE_OFFSET;
+    paddr.page_offset = phy_addr % PAGE_SIZE;
+    return paddr;
+}
+
+// ======================================================================
+//filling both versions of a cache with the same valid lines
+#define FILL_CACHE(TYPE, WAYS, LINES, REMAINING_BITS, FIXED, RT, STATE) \
+    do { \
+        for (uint16_t index = 0; index < LINES; ++index) { \
+            foreach_way(way, WAYS) { \
+                const uint32_t tag = next_random(STATE) >> (REMAINING_BITS); \
+                TYPE* const entry = (FIXED) + index * (WAYS) + way; \
+                entry->v = 1; \
+                entry->age = way; \
+                entry->tag = tag; \
+                rt_cache_insert(RT, index, way, tag, entry->line); \
+                rt_cache_age(RT, index, way) = way; \
+            } \
+        } \
+    } while (0)
+
+//half of the addresses hit (on any way), the other half very probably miss
+static void make_addresses(phy_addr_t* addresses, const rt_cache_t* cache, uint32_t* state)
+{
+    for (size_t i = 0; i < BENCH_ADDRESSES; ++i) {
+        const uint16_t index = next_random(state) % cache->desc.lines;
+        const uint8_t way = next_random(state) % cache->desc.ways;
+        uint32_t phy_addr = next_random(state);
+        if (i % 2 == 0) {
+            phy_addr = (rt_cache_tag(cache, index, way) << cache->desc.tag_remaining_bits)
+                       | ((uint32_t) index << cache->desc.offset_bits);
+        }
+        addresses[i] = to_paddr(phy_addr & ~(uint32_t)(sizeof(word_t) - 1));
+    }
+}
+
+// ======================================================================
+#define TIME_LOOKUPS(NAME, NB_LOOKUPS, ADDRESSES, LOOKUP) \
+    do { \
+        uint64_t hits_ = 0; \
+        const double start_ = now(); \
+        for (size_t i = 0; i < (NB_LOOKUPS); ++i) { \
+            phy_addr_t* const paddr = &(ADDRESSES)[i % BENCH_ADDRESSES]; \
+            const uint32_t* p_line = NULL; \
+            uint8_t hit_way = HIT_WAY_MISS; \
+            uint16_t hit_index = HIT_INDEX_MISS; \
+            LOOKUP; \
+            hits_ += (hit_way != HIT_WAY_MISS); \
+        } \
+        const double ns_ = (now() - start_) * 1e9 / (double)(NB_LOOKUPS); \
+        printf("%-24s %8.2f ns/lookup  %10" PRIu64 " hits\n", NAME, ns_, hits_); \
+    } while (0)
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    const size_t nb_lookups = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_LOOKUPS;
+    if (nb_lookups == 0) {
+        fprintf(stderr, "usage:    %s [number_of_lookups]\n", argv[0]);
+        fprintf(stderr, "example:  %s %lu\n", argv[0], BENCH_DEFAULT_LOOKUPS);
+        return 1;
+    }
+
+    word_t memory_word = 0; // cache_hit() only checks the memory is there
+    l1_icache_entry_t* l1_fixed = calloc(1, L1_ICACHE_SIZE);
+    l2_cache_entry_t* l2_fixed = calloc(1, L2_CACHE_SIZE);
+    phy_addr_t* l1_addresses = calloc(BENCH_ADDRESSES, sizeof(phy_addr_t));
+    phy_addr_t* l2_addresses = calloc(BENCH_ADDRESSES, sizeof(phy_addr_t));
+    rt_cache_t l1_rt, l2_rt;
+    zero_init_var(l1_rt);
+    zero_init_var(l2_rt);
+    const cache_desc_t l1_desc = L1_ICACHE_DESC;
+    const cache_desc_t l2_desc = L2_CACHE_DESC;
+
+    int err = (l1_fixed == NULL || l2_fixed == NULL || l1_addresses == NULL || l2_addresses == NULL)
+              ? ERR_MEM : ERR_NONE;
+    if (err == ERR_NONE) err = rt_cache_init(&l1_rt, &l1_desc);
+    if (err == ERR_NONE) err = rt_cache_init(&l2_rt, &l2_desc);
+
+    if (err == ERR_NONE) {
+        uint32_t state = 0x2545F491u;
+        FILL_CACHE(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE_LINES, L1_ICACHE_TAG_REMAINING_BITS,
+                   l1_fixed, &l1_rt, &state);
+        FILL_CACHE(l2_cache_entry_t, L2_CACHE_WAYS, L2_CACHE_LINES, L2_CACHE_TAG_REMAINING_BITS,
+                   l2_fixed, &l2_rt, &state);
+        make_addresses(l1_addresses, &l1_rt, &state);
+        make_addresses(l2_addresses, &l2_rt, &state);
+
+        printf("%s: %zu lookups per cache\n", argv[0], nb_lookups);
+        void* cache = l1_fixed;
+        TIME_LOOKUPS("L1 cache_hit (fixed)", nb_lookups, l1_addresses,
+                     cache_hit(&memory_word, cache, paddr, &p_line, &hit_way, &hit_index, L1_ICACHE));
+        TIME_LOOKUPS("L1 rt_cache_hit", nb_lookups, l1_addresses,
+                     rt_cache_hit(&l1_rt, paddr, &p_line, &hit_way, &hit_index));
+        cache = l2_fixed;
+        TIME_LOOKUPS("L2 cache_hit (fixed)", nb_lookups, l2_addresses,
+                     cache_hit(&memory_word, cache, paddr, &p_line, &hit_way, &hit_index, L2_CACHE));
+        TIME_LOOKUPS("L2 rt_cache_hit", nb_lookups, l2_addresses,
+                     rt_cache_hit(&l2_rt, paddr, &p_line, &hit_way, &hit_index));
+    } else {
+        fprintf(stderr, "Cannot allocate the caches: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+    }
+
+    rt_cache_free(&l1_rt);
+    rt_cache_free(&l2_rt);
+    free(l1_fixed);
+    free(l2_fixed);
+    free(l1_addresses);
+    free(l2_addresses);
+    return (err == ERR_NONE) ? EXIT_SUCCESS : 2;
+}
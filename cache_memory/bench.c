@@ -0,0 +1,342 @@
+/**
+ * @file bench.c
+ * @brief benchmark suite: simulated accesses per second of each part of the
+ * simulator, on every synthetic access pattern of patterns.h
+ *
+ * Built twice by the Makefile, since the two TLB managers define the same
+ * functions: bench times page_walk() (without and with paging-structure
+ * caches), the TLB hierarchy (with 4 kiB pages, then with 2 MiB pages when
+ * the number of pages allows it) and the cache hierarchy; bench-tlb_simple (-DBENCH_TLB_SIMPLE) the fully associative TLB,
+ * with its linked list then with its hash and index list.
+ *
+ * Each measure is repeated on the same commands, from the same flushed state,
+ * after an untimed warm-up run. The output is CSV, one line per target and
+ * pattern: the median and the best time, the accesses per second of the
+ * median, and a check value (hits, or sum of what was translated or read)
+ * that only changes if the simulation does.
+ */
+
+//for clock_gettime() with -std=c11
+#define _POSIX_C_SOURCE 200809L
+
+#include "error.h"
+#include "util.h"
+#include "commands.h"
+#include "patterns.h"
+#include "page_walk.h"
+#ifdef BENCH_TLB_SIMPLE
+#include "tlb.h"
+#include "tlb_mng.h"
+#else
+#include "tlb_hrchy.h"
+#include "tlb_hrchy_mng.h"
+#include "cache.h"
+#include "cache_mng.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h> // for PRIu64
+
+#define BENCH_DEFAULT_ACCESSES    1000000ul
+#define BENCH_DEFAULT_REPETITIONS 5ul
+#define BENCH_DEFAULT_PAGES       4096ul // 16 MiB, larger than the TLBs and caches
+#define BENCH_SEED                0x2545F491u
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    const double x = *(const double*) a;
+    const double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// ======================================================================
+// what every target runs on
+typedef struct {
+    void* mem_space;
+    void* huge_mem_space; // the same pages mapped by 2 MiB pages, NULL if they cannot be
+    const command_t* commands;
+    const phy_addr_t* paddrs; // translations of the commands
+    size_t nb_commands;
+#ifdef BENCH_TLB_SIMPLE
+    tlb_entry_t tlb[TLB_LINES];
+    list_t ll;
+    index_list_t lru;
+    tlb_hash_t hash;
+    replacement_policy_t policy;
+#else
+    l1_itlb_entry_t l1_itlb[L1_ITLB_LINES];
+    l1_dtlb_entry_t l1_dtlb[L1_DTLB_LINES];
+    l2_tlb_entry_t l2_tlb[L2_TLB_LINES];
+    page_walk_cache_t pwc;
+    void* l1_icache;
+    void* l1_dcache;
+    void* l2_cache;
+#endif
+} bench_t;
+
+typedef struct {
+    const char* name;
+    int (*reset)(bench_t* bench); // back to the initial state, untimed (may be NULL)
+    int (*run)(bench_t* bench, uint64_t* check);
+    bool huge; // only run on huge_mem_space
+} target_t;
+
+// ======================================================================
+#ifdef BENCH_TLB_SIMPLE
+static int reset_tlb_simple(bench_t* bench)
+{
+    M_EXIT_IF_ERR(tlb_flush(bench->tlb), "flushing TLB");
+    clear_list(&bench->ll);
+    init_list(&bench->ll);
+    for (list_content_t line_index = 0; line_index < TLB_LINES; ++line_index) {
+        if (push_back(&bench->ll, &line_index) == NULL) {
+            return ERR_MEM;
+        }
+    }
+    zero_init_var(bench->policy);
+    bench->policy.ll = &bench->ll;
+    bench->policy.push_back = push_back;
+    bench->policy.move_back = move_back;
+    return ERR_NONE;
+}
+
+static int reset_tlb_simple_hash(bench_t* bench)
+{
+    M_EXIT_IF_ERR(tlb_flush(bench->tlb), "flushing TLB");
+    init_index_list(&bench->lru);
+    for (uint16_t line_index = 0; line_index < TLB_LINES; ++line_index) {
+        if (index_push_back(&bench->lru, line_index) == INDEX_NONE) {
+            return ERR_BAD_PARAMETER;
+        }
+    }
+    M_EXIT_IF_ERR(tlb_hash_init(&bench->hash, NULL), "initializing hash");
+    zero_init_var(bench->policy);
+    bench->policy.lru = &bench->lru;
+    bench->policy.hash = &bench->hash;
+    return ERR_NONE;
+}
+
+static int run_tlb_simple(bench_t* bench, uint64_t* check)
+{
+    for (size_t i = 0; i < bench->nb_commands; ++i) {
+        phy_addr_t paddr;
+        int hit = 0;
+        M_EXIT_IF_ERR(tlb_search(bench->mem_space, &bench->commands[i].vaddr, &paddr, bench->tlb,
+                                 &bench->policy, &hit), "searching TLB");
+        *check += (uint64_t) hit;
+    }
+    return ERR_NONE;
+}
+
+static const target_t TARGETS[] = {
+    { "tlb_simple", reset_tlb_simple, run_tlb_simple, false },
+    { "tlb_simple_hash", reset_tlb_simple_hash, run_tlb_simple, false }
+};
+#else
+static int run_page_walk(bench_t* bench, uint64_t* check)
+{
+    for (size_t i = 0; i < bench->nb_commands; ++i) {
+        phy_addr_t paddr;
+        M_EXIT_IF_ERR(page_walk(bench->mem_space, &bench->commands[i].vaddr, &paddr), "page walk");
+        *check += paddr.phy_page_num;
+    }
+    return ERR_NONE;
+}
+
+static int reset_page_walk_pwc(bench_t* bench)
+{
+    return page_walk_cache_flush(&bench->pwc);
+}
+
+static int run_page_walk_pwc(bench_t* bench, uint64_t* check)
+{
+    for (size_t i = 0; i < bench->nb_commands; ++i) {
+        phy_addr_t paddr;
+        M_EXIT_IF_ERR(page_walk_cached(bench->mem_space, 0, &bench->commands[i].vaddr, &paddr, &bench->pwc, NULL),
+                      "page walk");
+        *check += paddr.phy_page_num;
+    }
+    return ERR_NONE;
+}
+
+static int reset_tlb_hrchy(bench_t* bench)
+{
+    M_EXIT_IF_ERR(tlb_flush(bench->l1_itlb, L1_ITLB), "flushing L1 ITLB");
+    M_EXIT_IF_ERR(tlb_flush(bench->l1_dtlb, L1_DTLB), "flushing L1 DTLB");
+    M_EXIT_IF_ERR(tlb_flush(bench->l2_tlb, L2_TLB), "flushing L2 TLB");
+    return ERR_NONE;
+}
+
+static int search_tlb_hrchy(bench_t* bench, void* mem_space, uint64_t* check)
+{
+    for (size_t i = 0; i < bench->nb_commands; ++i) {
+        phy_addr_t paddr;
+        int hit = 0;
+        M_EXIT_IF_ERR(tlb_search(mem_space, &bench->commands[i].vaddr, &paddr, bench->commands[i].type,
+                                 bench->l1_itlb, bench->l1_dtlb, bench->l2_tlb, &hit), "searching TLBs");
+        *check += (uint64_t) hit;
+    }
+    return ERR_NONE;
+}
+
+static int run_tlb_hrchy(bench_t* bench, uint64_t* check)
+{
+    return search_tlb_hrchy(bench, bench->mem_space, check);
+}
+
+static int run_tlb_hrchy_2m(bench_t* bench, uint64_t* check)
+{
+    return search_tlb_hrchy(bench, bench->huge_mem_space, check);
+}
+
+static int reset_cache_hrchy(bench_t* bench)
+{
+    M_EXIT_IF_ERR(cache_flush(bench->l1_icache, L1_ICACHE), "flushing L1 icache");
+    M_EXIT_IF_ERR(cache_flush(bench->l1_dcache, L1_DCACHE), "flushing L1 dcache");
+    M_EXIT_IF_ERR(cache_flush(bench->l2_cache, L2_CACHE), "flushing L2 cache");
+    return ERR_NONE;
+}
+
+static int run_cache_hrchy(bench_t* bench, uint64_t* check)
+{
+    for (size_t i = 0; i < bench->nb_commands; ++i) {
+        const command_t* const command = &bench->commands[i];
+        phy_addr_t paddr = bench->paddrs[i];
+        if (command->order == WRITE) {
+            M_EXIT_IF_ERR(cache_write(bench->mem_space, &paddr, bench->l1_dcache, bench->l2_cache,
+                                      &command->write_data, LRU), "writing");
+        } else {
+            word_t word = 0;
+            void* const l1_cache = (command->type == INSTRUCTION) ? bench->l1_icache : bench->l1_dcache;
+            M_EXIT_IF_ERR(cache_read(bench->mem_space, &paddr, command->type, l1_cache, bench->l2_cache,
+                                     &word, LRU), "reading");
+            *check += word;
+        }
+    }
+    return ERR_NONE;
+}
+
+static const target_t TARGETS[] = {
+    { "page_walk", NULL, run_page_walk, false },
+    { "page_walk_pwc", reset_page_walk_pwc, run_page_walk_pwc, false },
+    { "tlb_hrchy", reset_tlb_hrchy, run_tlb_hrchy, false },
+    { "tlb_hrchy_2m", reset_tlb_hrchy, run_tlb_hrchy_2m, true },
+    { "cache_hrchy", reset_cache_hrchy, run_cache_hrchy, false }
+};
+#endif
+
+// ======================================================================
+// one CSV line: warm-up, then the timed repetitions
+static int measure(bench_t* bench, const target_t* target, pattern_t pattern, double* times, size_t repetitions)
+{
+    uint64_t check = 0;
+    for (size_t r = 0; r <= repetitions; ++r) {
+        if (target->reset != NULL) {
+            M_EXIT_IF_ERR(target->reset(bench), "resetting");
+        }
+        check = 0;
+        const double start = now();
+        M_EXIT_IF_ERR(target->run(bench, &check), "running");
+        if (r > 0) {
+            times[r - 1] = now() - start;
+        }
+    }
+
+    qsort(times, repetitions, sizeof(double), compare_doubles);
+    const double median = times[repetitions / 2];
+    printf("%s,%s,%zu,%zu,%.6f,%.6f,%.0f,%" PRIu64 "\n", target->name, pattern_name(pattern),
+           bench->nb_commands, repetitions, median, times[0], (double) bench->nb_commands / median, check);
+    fflush(stdout);
+    return ERR_NONE;
+}
+
+static int bench_all(bench_t* bench, command_t* commands, phy_addr_t* paddrs, double* times,
+                     size_t repetitions, size_t nb_pages)
+{
+    printf("target,pattern,accesses,repetitions,median_s,best_s,accesses_per_s,check\n");
+    for (pattern_t pattern = 0; pattern < NB_PATTERNS; ++pattern) {
+        M_EXIT_IF_ERR(pattern_generate(commands, bench->nb_commands, pattern, nb_pages, BENCH_SEED), "generating");
+        for (size_t i = 0; i < bench->nb_commands; ++i) {
+            M_EXIT_IF_ERR(page_walk(bench->mem_space, &commands[i].vaddr, &paddrs[i]), "translating");
+        }
+        for (size_t t = 0; t < sizeof(TARGETS) / sizeof(TARGETS[0]); ++t) {
+            if (TARGETS[t].huge && bench->huge_mem_space == NULL) {
+                continue;
+            }
+            M_EXIT_IF_ERR(measure(bench, &TARGETS[t], pattern, times, repetitions), TARGETS[t].name);
+        }
+    }
+    return ERR_NONE;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t nb_accesses = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_ACCESSES;
+    const size_t repetitions = (argc > 2) ? strtoul(argv[2], NULL, 10) : BENCH_DEFAULT_REPETITIONS;
+    const size_t nb_pages = (argc > 3) ? strtoul(argv[3], NULL, 10) : BENCH_DEFAULT_PAGES;
+    if (nb_accesses == 0 || repetitions == 0 || nb_pages == 0 || nb_pages > PATTERN_MAX_PAGES) {
+        fprintf(stderr, "usage:    %s [number_of_accesses [repetitions [number_of_pages]]]\n", argv[0]);
+        fprintf(stderr, "example:  %s %lu %lu %lu\n", argv[0],
+                BENCH_DEFAULT_ACCESSES, BENCH_DEFAULT_REPETITIONS, BENCH_DEFAULT_PAGES);
+        fprintf(stderr, "at most %d pages\n", PATTERN_MAX_PAGES);
+        return 1;
+    }
+
+    bench_t bench;
+    zero_init_var(bench);
+    size_t mem_size = 0;
+    int err = pattern_memory_init(&bench.mem_space, &mem_size, nb_pages, PAGE_4K, BENCH_SEED);
+    if (err == ERR_NONE && nb_pages % PD_ENTRIES == 0) {
+        err = pattern_memory_init(&bench.huge_mem_space, &mem_size, nb_pages, PAGE_2M, BENCH_SEED);
+    }
+
+    command_t* commands = calloc(nb_accesses, sizeof(command_t));
+    phy_addr_t* paddrs = calloc(nb_accesses, sizeof(phy_addr_t));
+    double* times = calloc(repetitions, sizeof(double));
+    if (commands == NULL || paddrs == NULL || times == NULL) {
+        err = ERR_MEM;
+    }
+    bench.commands = commands;
+    bench.paddrs = paddrs;
+    bench.nb_commands = nb_accesses;
+#ifdef BENCH_TLB_SIMPLE
+    init_list(&bench.ll);
+#else
+    bench.l1_icache = calloc(1, L1_ICACHE_SIZE);
+    bench.l1_dcache = calloc(1, L1_DCACHE_SIZE);
+    bench.l2_cache = calloc(1, L2_CACHE_SIZE);
+    if (bench.l1_icache == NULL || bench.l1_dcache == NULL || bench.l2_cache == NULL) {
+        err = ERR_MEM;
+    }
+#endif
+
+    if (err == ERR_NONE) {
+        err = bench_all(&bench, commands, paddrs, times, repetitions, nb_pages);
+    }
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Benchmark failed: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+    }
+
+#ifdef BENCH_TLB_SIMPLE
+    clear_list(&bench.ll);
+#else
+    free(bench.l1_icache);
+    free(bench.l1_dcache);
+    free(bench.l2_cache);
+#endif
+    free(commands);
+    free(paddrs);
+    free(times);
+    free(bench.mem_space);
+    free(bench.huge_mem_space);
+    return (err == ERR_NONE) ? EXIT_SUCCESS : 2;
+}
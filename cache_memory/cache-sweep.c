@@ -0,0 +1,70 @@
+/**
+ * @file cache-sweep.c
+ * @brief Simulate one trace on several cache configurations, in parallel
+ */
+
+#include "error.h"
+#include "memory.h"
+#include "sweep.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5) {
+        fprintf(stderr, "usage:    %s trace_filename memory_dump nb_threads config [config...]\n", argv[0]);
+        fprintf(stderr, "example:  %s commands.bin memory_dump.bin 4 lru srrip:l1=8x64:l2=16x1024\n", argv[0]);
+        return 1;
+    }
+
+    const size_t nb_threads = strtoul(argv[3], NULL, 10);
+    const size_t nb_configs = (size_t)(argc - 4);
+
+    sweep_config_t* configs = calloc(nb_configs, sizeof(sweep_config_t));
+    sweep_result_t* results = calloc(nb_configs, sizeof(sweep_result_t));
+    if (configs == NULL || results == NULL) {
+        fprintf(stderr, "Not enough memory for %zu configurations.\n", nb_configs);
+        free(configs);
+        free(results);
+        return 2;
+    }
+
+    for (size_t i = 0; i < nb_configs; ++i) {
+        if (sweep_config_parse(argv[4 + i], &configs[i]) != ERR_NONE) {
+            fprintf(stderr, "Unknown configuration \"%s\".\n", argv[4 + i]);
+            free(configs);
+            free(results);
+            return 3;
+        }
+    }
+
+    // the page tables are only read: one shared mapping is enough to translate the trace
+    void* mem_space = NULL;
+    size_t mem_size = 0;
+    if (mem_init_from_dumpfile_mmap(argv[2], &mem_space, &mem_size) != ERR_NONE) {
+        fprintf(stderr, "Cannot read memory dump from \"%s\".\n", argv[2]);
+        free(configs);
+        free(results);
+        return 4;
+    }
+
+    sweep_trace_t trace;
+    int err = sweep_trace_load(argv[1], mem_space, mem_size, &trace);
+    mem_release_mmap(mem_space, mem_size);
+
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Cannot read commands from \"%s\": %s\n", argv[1], ERR_MESSAGES[err - ERR_NONE]);
+    } else {
+        err = sweep_run(&trace, argv[2], configs, results, nb_configs, nb_threads);
+        if (err == ERR_NONE) {
+            sweep_print(stdout, configs, results, nb_configs);
+        } else {
+            fprintf(stderr, "Sweep failed: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+        }
+        sweep_trace_free(&trace);
+    }
+
+    free(configs);
+    free(results);
+    return (err == ERR_NONE) ? EXIT_SUCCESS : 5;
+}
@@ -41,7 +41,7 @@
  *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
  *  - 64 sets (= 64 blocks per way) (= 6 bits to index)
  *  - total capacity = 4kiB
- *  - write-through policy (no dirty bit)
+ *  - write-through policy, or write-back with a dirty bit (see cache_write_t in cache_mng.h)
  *  - write-allocate on write miss
  *
  * L2 CACHE:
@@ -51,7 +51,7 @@
  *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
  *  - 512 sets (= 512 blocks per way) (= 9 bits to index)
  *  - total capacity = 64kiB
- *  - write-through policy (no dirty bit)
+ *  - write-through policy, or write-back with a dirty bit: an evicted dirty line is written back
  *  - write-allocate on write miss
  *
  *  Exclusive policy (https://en.wikipedia.org/wiki/Cache_inclusion_policy)
@@ -66,11 +66,16 @@
  *      in L2, then it is fetched from main memory and placed just in L1 and not
  *      in L2.
  *
+ *  With several cores, each has its own L1 ICACHE and L1 DCACHE, kept
+ *  coherent by MESI snooping (see coherence.h), and all share the L2 CACHE.
+ *
  */
 
 typedef struct{
 	uint8_t v : 1; //validation bit
 	uint8_t age : 2; //number of bits needed to represent max. L1_CACHE_WAYS - 1 
+	uint8_t state : 2; //MESI state of a valid line, kept with several cores only (see coherence.h)
+	uint8_t dirty : 1; //written since read from memory, write-back policy only
 	uint32_t tag : L1_ICACHE_TAG_BITS;
 	word_t line[L1_ICACHE_WORDS_PER_LINE];
 }l1_icache_entry_t;
@@ -80,16 +85,62 @@ typedef l1_icache_entry_t l1_dcache_entry_t;
 typedef struct{
 	uint8_t v : 1; //validation bit
 	uint8_t age : 3; //number of bits needed to represent max. L2_CACHE_WAYS - 1 
+	uint8_t dirty : 1; //same as in level 1, from which it comes
 	uint32_t tag : L2_CACHE_TAG_BITS;
 	word_t line[L2_CACHE_WORDS_PER_LINE];
 }l2_cache_entry_t;
 
+// replacement state of the sets, besides the ages of their entries (see cache_replace_t in cache_mng.h),
+// kept right after the entries: the caches are allocated with L1_ICACHE_SIZE, L1_DCACHE_SIZE and L2_CACHE_SIZE
+// bytes. Bit n (1 <= n < ways) of a tree-PLRU mask is node n of a binary tree whose leaves are the ways
+// (children of n: 2n and 2n + 1), set when the next line to evict is on the right of n.
+// SRRIP and BRRIP keep the re-reference prediction values of the lines in their ages
+typedef struct{
+	uint8_t plru[L1_ICACHE_LINES]; // 3 bits for 4 ways
+	uint32_t random; // state of the generator used by RANDOM and BRRIP, 0 until first used
+}l1_cache_policy_t;
+
+typedef struct{
+	uint8_t plru[L2_CACHE_LINES]; // 7 bits for 8 ways
+	uint32_t random;
+}l2_cache_policy_t;
+
+#define L1_ICACHE_SIZE (L1_ICACHE_LINES * L1_ICACHE_WAYS * sizeof(l1_icache_entry_t) + sizeof(l1_cache_policy_t))
+#define L1_DCACHE_SIZE L1_ICACHE_SIZE
+#define L2_CACHE_SIZE  (L2_CACHE_LINES * L2_CACHE_WAYS * sizeof(l2_cache_entry_t) + sizeof(l2_cache_policy_t))
+
 typedef enum{
 	
 	L1_ICACHE, L1_DCACHE, L2_CACHE
 	
 }cache_t;
 
+/**
+ * Geometry of a cache whose layout is only known at run time (see rt_cache.h).
+ * All sizes are powers of two; build it with cache_desc_init().
+ */
+typedef struct{
+	uint16_t ways;
+	uint16_t lines; // number of sets
+	uint16_t words_per_line;
+	uint8_t offset_bits; // log_2(bytes per line): select byte + select word
+	uint8_t index_bits; // log_2(lines): select line
+	uint8_t tag_remaining_bits; // offset_bits + index_bits
+	uint8_t tag_bits; // 32 - tag_remaining_bits
+}cache_desc_t;
+
+#define L1_ICACHE_OFFSET_BITS 4 // 2(select byte) + 2(select word)
+#define L1_ICACHE_INDEX_BITS  6 // log_2(L1_ICACHE_LINES)
+#define L2_CACHE_OFFSET_BITS  L1_ICACHE_OFFSET_BITS
+#define L2_CACHE_INDEX_BITS   9 // log_2(L2_CACHE_LINES)
+
+// the default (Kaby Lake) geometries above, as descriptors
+#define L1_ICACHE_DESC ((cache_desc_t){ L1_ICACHE_WAYS, L1_ICACHE_LINES, L1_ICACHE_WORDS_PER_LINE, \
+        L1_ICACHE_OFFSET_BITS, L1_ICACHE_INDEX_BITS, L1_ICACHE_TAG_REMAINING_BITS, L1_ICACHE_TAG_BITS })
+#define L1_DCACHE_DESC L1_ICACHE_DESC
+#define L2_CACHE_DESC ((cache_desc_t){ L2_CACHE_WAYS, L2_CACHE_LINES, L2_CACHE_WORDS_PER_LINE, \
+        L2_CACHE_OFFSET_BITS, L2_CACHE_INDEX_BITS, L2_CACHE_TAG_REMAINING_BITS, L2_CACHE_TAG_BITS })
+
 
 // --------------------------------------------------
 #define cache_cast(TYPE) ((TYPE *)cache)
@@ -113,3 +164,7 @@ typedef enum{
 // --------------------------------------------------
 #define cache_line(TYPE, WAYS, LINE_INDEX, WAY) \
         cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->line
+
+// --------------------------------------------------
+#define cache_policy(TYPE, POLICY_TYPE, WAYS, LINES) \
+        ((POLICY_TYPE *)(cache_cast(TYPE) + (LINES) * (WAYS)))
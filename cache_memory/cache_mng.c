@@ -12,12 +12,184 @@
 #include "error.h"
 #include "addr.h"
 #include "lru.h"
+#include "rt_cache.h" // for the RRIP constants and the seed of RANDOM
 #include "stdlib.h"
 #include <stdbool.h>
 #include <inttypes.h> // for PRIx macros
 #include <limits.h> // for UCHAR_MAX
+#include <pthread.h>
 
 
+//writing a line back to memory (see insert_evicted_into_l2() and write_back_dirty_lines())
+static inline void write_back(void * mem_space, const word_t * line, uint32_t line_addr){
+	uint32_t* const central_mem = mem_space;
+	for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
+		central_mem[line_addr / sizeof(word_t) + i] = line[i];
+}
+
+static bool is_policy(cache_replace_t replace){
+	switch(replace){
+	case LRU:
+	case PLRU:
+	case SRRIP:
+	case BRRIP:
+	case RANDOM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//the replacement state of a cache (see l1_cache_policy_t), instruction and data caches sharing the same layout
+static inline uint8_t* plru_mask(void * cache, cache_t cache_type, uint16_t index){
+	if(cache_type == L2_CACHE){
+		return cache_policy(l2_cache_entry_t, l2_cache_policy_t, L2_CACHE_WAYS, L2_CACHE_LINES)->plru + index;
+	}
+	return cache_policy(l1_icache_entry_t, l1_cache_policy_t, L1_ICACHE_WAYS, L1_ICACHE_LINES)->plru + index;
+}
+
+static inline uint32_t* random_state(void * cache, cache_t cache_type){
+	if(cache_type == L2_CACHE){
+		return &cache_policy(l2_cache_entry_t, l2_cache_policy_t, L2_CACHE_WAYS, L2_CACHE_LINES)->random;
+	}
+	return &cache_policy(l1_icache_entry_t, l1_cache_policy_t, L1_ICACHE_WAYS, L1_ICACHE_LINES)->random;
+}
+
+static inline uint8_t entry_age(void * cache, cache_t cache_type, uint16_t index, uint8_t way){
+	return (cache_type == L2_CACHE) ? cache_age(l2_cache_entry_t, L2_CACHE_WAYS, index, way)
+		: cache_age(l1_icache_entry_t, L1_ICACHE_WAYS, index, way);
+}
+
+static inline void entry_age_set(void * cache, cache_t cache_type, uint16_t index, uint8_t way, uint8_t age){
+	if(cache_type == L2_CACHE){
+		cache_age(l2_cache_entry_t, L2_CACHE_WAYS, index, way) = age;
+	}else{
+		cache_age(l1_icache_entry_t, L1_ICACHE_WAYS, index, way) = age;
+	}
+}
+
+//deterministic pseudo-random numbers (xorshift), from the same seed as the run-time caches
+static inline uint32_t next_random(uint32_t* state){
+	if(*state == 0){
+		*state = RT_CACHE_RANDOM_SEED;
+	}
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+//tree-PLRU: the nodes from the root to a way all point away from it
+static inline void plru_touch(uint8_t * plru, uint8_t way, uint8_t ways){
+	unsigned int node = 1;
+	for(int level = __builtin_ctz(ways) - 1; level >= 0; --level){
+		const unsigned int right = (way >> level) & 1u;
+		*plru = (uint8_t)((*plru & ~(1u << node)) | ((right ^ 1u) << node));
+		node = 2 * node + right;
+	}
+}
+
+//tree-PLRU: following the nodes from the root
+static inline uint8_t plru_victim(uint8_t plru, uint8_t ways){
+	unsigned int node = 1;
+	while(node < ways){
+		node = 2 * node + ((plru >> node) & 1u);
+	}
+	return (uint8_t)(node - ways);
+}
+
+//a hit on a way of a set, or a line moved on it
+static inline void policy_hit(void * cache, cache_t cache_type, uint16_t index, uint8_t hit_way,
+                              cache_replace_t replace){
+	switch(replace){
+	case LRU:
+		if(cache_type == L2_CACHE){
+			LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, hit_way, index);
+		}else{
+			LRU_age_update(l1_icache_entry_t, L1_ICACHE_WAYS, hit_way, index);
+		}
+		break;
+	case PLRU:
+		plru_touch(plru_mask(cache, cache_type, index), hit_way, (cache_type == L2_CACHE) ? L2_CACHE_WAYS : L1_ICACHE_WAYS);
+		break;
+	case SRRIP:
+	case BRRIP:
+		//reused: predicted to be reused again soon
+		entry_age_set(cache, cache_type, index, hit_way, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+//a line just inserted on a way, free or evicted (see policy_evict())
+static inline void policy_fill(void * cache, cache_t cache_type, uint16_t index, uint8_t fill_way, bool evicted,
+                               cache_replace_t replace){
+	switch(replace){
+	case LRU:
+		if(evicted){
+			policy_hit(cache, cache_type, index, fill_way, replace);
+		}else if(cache_type == L2_CACHE){
+			LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, fill_way, index);
+		}else{
+			LRU_age_increase(l1_icache_entry_t, L1_ICACHE_WAYS, fill_way, index);
+		}
+		break;
+	case PLRU:
+		policy_hit(cache, cache_type, index, fill_way, replace);
+		break;
+	case SRRIP:
+		entry_age_set(cache, cache_type, index, fill_way, RT_CACHE_RRPV_LONG);
+		break;
+	case BRRIP:
+		entry_age_set(cache, cache_type, index, fill_way,
+			(next_random(random_state(cache, cache_type)) % RT_CACHE_BRRIP_LONG_ONE_IN == 0)
+			? RT_CACHE_RRPV_LONG : RT_CACHE_RRPV_DISTANT);
+		break;
+	default:
+		break;
+	}
+}
+
+//the way to evict from a full set, without changing anything (see policy_evict()):
+//LRU evicts the first of the oldest lines, SRRIP and BRRIP the first predicted the most distant
+static inline uint8_t policy_victim(void * cache, cache_t cache_type, uint16_t index, cache_replace_t replace){
+	const uint8_t ways = (cache_type == L2_CACHE) ? L2_CACHE_WAYS : L1_ICACHE_WAYS;
+	if(replace == RANDOM){
+		uint32_t state = *random_state(cache, cache_type);
+		return (uint8_t)(next_random(&state) & (ways - 1u));
+	}
+	if(replace == PLRU){
+		return plru_victim(*plru_mask(cache, cache_type, index), ways);
+	}
+
+	uint8_t eviction_way = 0;
+	uint8_t max_age = 0;
+	foreach_way(way, ways){
+		const uint8_t age = entry_age(cache, cache_type, index, way);
+		if(max_age < age){
+			max_age = age;
+			eviction_way = way;
+		}
+	}
+	return eviction_way;
+}
+
+//evicting the way policy_victim() chooses: RANDOM draws its number, and if no line is predicted
+//RT_CACHE_RRPV_DISTANT, the whole set ages until the victim is
+static inline uint8_t policy_evict(void * cache, cache_t cache_type, uint16_t index, cache_replace_t replace){
+	const uint8_t eviction_way = policy_victim(cache, cache_type, index, replace);
+	if(replace == RANDOM){
+		(void) next_random(random_state(cache, cache_type));
+	}else if(replace == SRRIP || replace == BRRIP){
+		const uint8_t max_age = entry_age(cache, cache_type, index, eviction_way);
+		foreach_way(way, (cache_type == L2_CACHE) ? L2_CACHE_WAYS : L1_ICACHE_WAYS){
+			entry_age_set(cache, cache_type, index, way,
+				(uint8_t)(entry_age(cache, cache_type, index, way) + RT_CACHE_RRPV_DISTANT - max_age));
+		}
+	}
+	return eviction_way;
+}
 
 int cache_entry_init(const void * mem_space,
                      const phy_addr_t * paddr,
@@ -62,15 +234,15 @@ int cache_flush(void *cache, cache_t cache_type){
 
 	if(cache_type == L1_ICACHE){
 		
-		init_cache_for_flush(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_WAYS);
+		init_cache_for_flush(l1_icache_entry_t, l1_cache_policy_t, L1_ICACHE_LINES, L1_ICACHE_WAYS);
 
 	}else if(cache_type == L1_DCACHE){	
 		
-		init_cache_for_flush(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE_WAYS);
+		init_cache_for_flush(l1_dcache_entry_t, l1_cache_policy_t, L1_DCACHE_LINES, L1_DCACHE_WAYS);
 		
 	}else if(cache_type == L2_CACHE){
 		
-		init_cache_for_flush(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_WAYS);
+		init_cache_for_flush(l2_cache_entry_t, l2_cache_policy_t, L2_CACHE_LINES, L2_CACHE_WAYS);
 		
 	}else{
 		return ERR_BAD_PARAMETER;
@@ -80,6 +252,33 @@ int cache_flush(void *cache, cache_t cache_type){
 	return ERR_NONE;
 }
 
+int cache_write_back(void * mem_space, void *cache, cache_t cache_type, uint64_t * nb_lines){
+
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM);
+	M_REQUIRE_NON_NULL(cache);
+	uint64_t written = 0;
+
+	//instruction and data entries share the same layout
+	if(cache_type == L1_ICACHE || cache_type == L1_DCACHE){
+
+		write_back_dirty_lines(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_WAYS,
+			L1_ICACHE_TAG_REMAINING_BITS, L1_ICACHE_LINE);
+
+	}else if(cache_type == L2_CACHE){
+
+		write_back_dirty_lines(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_WAYS,
+			L2_CACHE_TAG_REMAINING_BITS, L2_CACHE_LINE);
+
+	}else{
+		return ERR_BAD_PARAMETER;
+	}
+
+	if(nb_lines != NULL){
+		*nb_lines += written;
+	}
+	return ERR_NONE;
+}
+
 
 int cache_hit (const void * mem_space,
                void * cache,
@@ -105,17 +304,17 @@ int cache_hit (const void * mem_space,
 	if(cache_type == L1_ICACHE){
 
 	cache_hit_miss_process(L1_ICACHE_WORDS_PER_LINE, L1_ICACHE_LINES, 
-		L1_ICACHE_WAYS, L1_ICACHE_TAG_REMAINING_BITS, l1_icache_entry_t);
+		L1_ICACHE_WAYS, L1_ICACHE_TAG_REMAINING_BITS, l1_icache_entry_t, STATS_L1_ICACHE);
 
 	}else if(cache_type == L1_DCACHE){	
 		
 	cache_hit_miss_process(L1_DCACHE_WORDS_PER_LINE, L1_DCACHE_LINES, 
-		L1_DCACHE_WAYS, L1_DCACHE_TAG_REMAINING_BITS, l1_dcache_entry_t);
+		L1_DCACHE_WAYS, L1_DCACHE_TAG_REMAINING_BITS, l1_dcache_entry_t, STATS_L1_DCACHE);
 
 		
 	}else if(cache_type == L2_CACHE){
 	cache_hit_miss_process(L2_CACHE_WORDS_PER_LINE, L2_CACHE_LINES, 
-		L2_CACHE_WAYS, L2_CACHE_TAG_REMAINING_BITS, l2_cache_entry_t);
+		L2_CACHE_WAYS, L2_CACHE_TAG_REMAINING_BITS, l2_cache_entry_t, STATS_L2_CACHE);
 		
 	}else{
 		return ERR_BAD_PARAMETER;
@@ -148,15 +347,18 @@ int cache_insert(uint16_t cache_line_index,
 			 
 	if(cache_type == L1_ICACHE){	
 		
-		insert_cache(L1_ICACHE_LINES, L1_ICACHE_WAYS, l1_icache_entry_t);
+		insert_cache(L1_ICACHE_LINES, L1_ICACHE_WAYS, l1_icache_entry_t,
+			L1_ICACHE_TAG_REMAINING_BITS, L1_ICACHE_LINE, STATS_L1_ICACHE);
 		 
 	}else if(cache_type == L1_DCACHE){
 		
-		insert_cache(L1_DCACHE_LINES, L1_DCACHE_WAYS, l1_dcache_entry_t);
+		insert_cache(L1_DCACHE_LINES, L1_DCACHE_WAYS, l1_dcache_entry_t,
+			L1_DCACHE_TAG_REMAINING_BITS, L1_DCACHE_LINE, STATS_L1_DCACHE);
 
 	}else if(cache_type == L2_CACHE){
 	
-		insert_cache(L2_CACHE_LINES, L2_CACHE_WAYS, l2_cache_entry_t);		
+		insert_cache(L2_CACHE_LINES, L2_CACHE_WAYS, l2_cache_entry_t,
+			L2_CACHE_TAG_REMAINING_BITS, L2_CACHE_LINE, STATS_L2_CACHE);
 
 	}else{
 		return ERR_BAD_PARAMETER;
@@ -166,7 +368,7 @@ int cache_insert(uint16_t cache_line_index,
 }
 
 
-int cache_read(const void * mem_space,
+int cache_read(void * mem_space,
                phy_addr_t * paddr,
                mem_access_t access,
                void * l1_cache,
@@ -179,173 +381,77 @@ int cache_read(const void * mem_space,
 	M_REQUIRE_NON_NULL(l1_cache);
 	M_REQUIRE_NON_NULL(l2_cache);	
 	M_REQUIRE_NON_NULL(word);	
-	M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "Wrong replacement policy", replace);
+	M_REQUIRE(is_policy(replace), ERR_BAD_PARAMETER, "Wrong replacement policy", replace);
 	M_REQUIRE(paddr->page_offset % sizeof(word_t) == 0, ERR_BAD_PARAMETER, "Physical address not aligned with words", paddr);
 	M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "Wrong access demand", access);
-	void* cache;			
-	
-	word_t l1_line[L1_DCACHE_WORDS_PER_LINE];
-	word_t l2_line[L2_CACHE_WORDS_PER_LINE];
+	void* cache = l1_cache;
 	
-	const uint32_t** p_l1_line = &l1_line;
-	const uint32_t**  p_l2_line = &l2_line;
-	 
+	const uint32_t* p_line = NULL;
 
 	uint8_t hit_way = HIT_WAY_MISS;
 	uint16_t hit_index = HIT_INDEX_MISS;
 	uint32_t phy_addr = convert_paddr(paddr);	
 	
-	//getting the word select bytes
-	uint8_t word_select = phy_addr & 0xC;
-	uint8_t way = 0;	
-	bool way_found = false;
+	//getting the index of the word in the line
+	uint8_t word_select = (phy_addr % L1_DCACHE_LINE) / sizeof(word_t);
 	
+	//instruction and data entries share the same layout (l1_dcache_entry_t is l1_icache_entry_t)
 	cache_t cache_type = (access == INSTRUCTION) ? L1_ICACHE : L1_DCACHE;
-		
-	cache = (l1_icache_entry_t*)l1_cache;
-		
-	if(cache_type == L1_DCACHE){
-		cache = (l1_dcache_entry_t*)l1_cache;
-	}
-	
 	
-	M_EXIT_IF_ERR(cache_hit(mem_space, l1_cache, paddr, p_l1_line, &hit_way, &hit_index, L1_DCACHE),
+	M_EXIT_IF_ERR(cache_hit(mem_space, l1_cache, paddr, &p_line, &hit_way, &hit_index, cache_type),
 		"looking for hit in level 1");		
-			
 	
 	//data is on level 1 		
 	if(hit_way != HIT_WAY_MISS){
-		if(cache_type == L1_ICACHE){
-		*word = cache_line(l1_icache_entry_t, L1_ICACHE_WAYS, hit_index, hit_way)[word_select];
-		}else{
-		*word = cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way)[word_select];	
-		}
+		*word = p_line[word_select];
+		policy_hit(l1_cache, cache_type, hit_index, hit_way, replace);
 		return ERR_NONE;
+	}
+	
+	//its MESI state is only set with several cores (see coherence_read_miss())
+	l1_icache_entry_t l1_insertion;
+	zero_init_var(l1_insertion);
+	uint16_t l1_insertion_index = (phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES;
+	
+	//not found on level 1, looking for it in level 2	
+	M_EXIT_IF_ERR(cache_hit(mem_space, l2_cache, paddr, &p_line, &hit_way, &hit_index, L2_CACHE),
+		"looking for hit in level 2");	
+	
+	if(hit_way != HIT_WAY_MISS){
+		//found in level 2: the line moves to level 1
+		cache = l2_cache;
+		cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way) = 0;
 		
+		l1_insertion.v = 1;
+		l1_insertion.age = 0;
+		l1_insertion.dirty = cache_entry(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way)->dirty;
+		l1_insertion.tag = phy_addr >> L1_ICACHE_TAG_REMAINING_BITS;
+		for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
+			l1_insertion.line[i] = p_line[i];
 		
 	}else{
-		
-		//not found on level 1, looking for it in level 2	
-		
-		M_EXIT_IF_ERR(cache_hit(mem_space, l2_cache, paddr, p_l2_line, &hit_way, &hit_index, L2_CACHE),
-			"looking for hit in level 2");	
-		
-		if(hit_way != HIT_WAY_MISS){
-			//found in level2
-			
-			//devalidating entry in level 2
-			cache_valid(l2_cache_entry_t,L2_CACHE_WAYS, hit_index,hit_way) = 0;
-
-			*word = cache_line(l2_cache_entry_t, L2_CACHE_WAYS, hit_index,hit_way)[word_select];
-			
-			uint32_t l1_insertion_index = phy_addr / (L1_DCACHE_WORDS_PER_LINE * sizeof(word_t));
-			l1_insertion_index %=  L1_DCACHE_LINES;
-			
-			word_t read_line[L2_CACHE_WORDS_PER_LINE];
-			
-			for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
-				read_line[i] = cache_line(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way)[i];
-			
-			void* entry_to_insert;
-			
-			if(cache_type == L1_ICACHE){
-			l1_icache_entry_t i_entry_to_insert;
-			i_entry_to_insert.age = 0;
-			i_entry_to_insert.v = 1 ;
-			i_entry_to_insert.tag = phy_addr >> L1_ICACHE_TAG_REMAINING_BITS;
-			search_place_and_insert(l1_icache_entry_t,L1_ICACHE_WAYS, hit_index, i_entry_to_insert, l1_cache, L1_ICACHE);
-			for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
-				i_entry_to_insert.line[i] = read_line[i];
-			
-			entry_to_insert = &i_entry_to_insert;
-			
-			}else{
-			l1_dcache_entry_t d_entry_to_insert;
-			d_entry_to_insert.v = 1 ;
-			d_entry_to_insert.age = 0;
-			d_entry_to_insert.tag = phy_addr >> L1_DCACHE_TAG_REMAINING_BITS;
-			for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
-				d_entry_to_insert.line[i] = read_line[i];
-			search_place_and_insert(l1_dcache_entry_t,L1_DCACHE_WAYS, hit_index, d_entry_to_insert, l1_cache, L1_DCACHE);
-			
-			entry_to_insert = &d_entry_to_insert;
-			}
-
-			if(!way_found){
-	
-				if(cache_type == L1_ICACHE){
-				l1_icache_entry_t l1_entry_evicted;
-				place_on_max_way(l1_icache_entry_t, L1_ICACHE_WAYS, entry_to_insert , 
-						l1_insertion_index, l1_cache, L1_ICACHE);
-				insert_evicted_into_l2(l1_entry_evicted, l1_insertion_index);
-				
-				}else{
-				l1_dcache_entry_t l1_entry_evicted;
-				place_on_max_way(l1_dcache_entry_t, L1_DCACHE_WAYS, entry_to_insert , 
-						l1_insertion_index, l1_cache, L1_DCACHE);
-				insert_evicted_into_l2(l1_entry_evicted, l1_insertion_index);
-						
-				}			
-			}
-			
-		}else{
-		//not found in either caches
-	
-			
-			void* l1_final_insertion;
-			cache = l1_cache;	
-			uint16_t l1_final_index;
-			
-			if(cache_type == L1_ICACHE){
-				l1_icache_entry_t l1_i_insertion;
-				M_EXIT_IF_ERR(cache_entry_init(mem_space,paddr, &l1_i_insertion, L1_ICACHE), 
-					"initializing from central memory");
-				*word = l1_i_insertion.line[word_select];
-				l1_final_insertion = &l1_i_insertion;
-				l1_final_index = phy_addr / (L1_ICACHE_WORDS_PER_LINE * sizeof(word_t));
-				l1_final_index %= L1_ICACHE_LINES; 
-				
-				search_place_and_insert(l1_icache_entry_t, L1_ICACHE_WAYS, l1_final_index, 
-					l1_final_insertion, l1_cache, L1_ICACHE);
-			}else{
-				l1_dcache_entry_t l1_d_insertion;
-				M_EXIT_IF_ERR(cache_entry_init(mem_space,paddr, &l1_d_insertion, L1_ICACHE),
-					"initializing from central memory");
-				*word = l1_d_insertion.line[word_select];
-				l1_final_insertion = &l1_d_insertion;
-				l1_final_index = phy_addr / (L1_DCACHE_WORDS_PER_LINE * sizeof(word_t));
-				l1_final_index %= L1_DCACHE_LINES; 
-				
-				search_place_and_insert(l1_dcache_entry_t, L1_DCACHE_WAYS, l1_final_index, 
-						l1_final_insertion, l1_cache, L1_DCACHE);	
-			}
-
-
-			if(!way_found){
+		//not found in either caches: the line comes from memory
+		M_EXIT_IF_ERR(cache_entry_init(mem_space, paddr, &l1_insertion, cache_type), 
+			"initializing from central memory");
+	}
+	*word = l1_insertion.line[word_select];
 	
-				if(cache_type == L1_ICACHE){
-				l1_icache_entry_t l1_entry_evicted;
-				place_on_max_way(l1_icache_entry_t, L1_ICACHE_WAYS, l1_final_insertion , 
-						l1_final_index, l1_cache, L1_ICACHE);
-				insert_evicted_into_l2(l1_entry_evicted, l1_final_index);
-				
-				}else{
-				l1_dcache_entry_t l1_entry_evicted;
-				place_on_max_way(l1_dcache_entry_t, L1_DCACHE_WAYS, l1_final_insertion , 
-						l1_final_index, l1_cache, L1_DCACHE);
-				insert_evicted_into_l2(l1_entry_evicted, l1_final_index);
-						
-				}			
-			}
-
-		}	
+	cache = l1_cache;
+	search_place_and_insert(l1_icache_entry_t, L1_ICACHE_WAYS, l1_insertion_index, 
+		l1_insertion, l1_cache, cache_type);
 
+	//no free way in level 1: the evicted line goes to level 2
+	if(!way_found){
+		l1_icache_entry_t l1_entry_evicted;
+		place_on_max_way(l1_icache_entry_t, L1_ICACHE_WAYS, l1_insertion, 
+				l1_insertion_index, l1_cache, cache_type);
+		insert_evicted_into_l2(l1_entry_evicted, l1_insertion_index);
 	}
 	
      return ERR_NONE;
 }
 
-int cache_read_byte(const void * mem_space,
+int cache_read_byte(void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
                     void * l1_cache,
@@ -355,39 +461,46 @@ int cache_read_byte(const void * mem_space,
 
 	M_REQUIRE_NON_NULL(p_paddr);
 	//other controls are made in cache_read
+	uint32_t phy_addr = convert_paddr(p_paddr);
+	uint8_t byte_select = phy_addr % sizeof(word_t);
+	
+	//reading the whole word the byte belongs to
+	phy_addr_t word_paddr = *p_paddr;
+	word_paddr.page_offset -= byte_select;
+	
 	word_t word;
-	int err_code = cache_read(mem_space,p_paddr, access, l1_cache, l2_cache, &word, replace);
+	int err_code = cache_read(mem_space, &word_paddr, access, l1_cache, l2_cache, &word, replace);
 	if(err_code != ERR_NONE){
 		return err_code;
 	}
-	uint32_t phy_addr = convert_paddr(p_paddr);
-	uint8_t byte_select = phy_addr % sizeof(word_t);
 	
 	*p_byte = (word >> (BYTE_WIDTH * byte_select)) & UCHAR_MAX;
 	return ERR_NONE;
 }
 
-int cache_write(void * mem_space,
-                phy_addr_t * paddr,
-                void * l1_cache,
-                void * l2_cache,
-                const uint32_t * word,
-                cache_replace_t replace){
+//cache_write() with either policy: written back, the line is only marked dirty
+static int write_word(void * mem_space,
+                      phy_addr_t * paddr,
+                      void * l1_cache,
+                      void * l2_cache,
+                      const uint32_t * word,
+                      cache_replace_t replace,
+                      cache_write_t write_policy){
 				
 	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM);	
 	M_REQUIRE_NON_NULL(paddr);		
 	M_REQUIRE_NON_NULL(l1_cache);
 	M_REQUIRE_NON_NULL(l2_cache);	
 	M_REQUIRE_NON_NULL(word);	
-	M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "Wrong replacement policy", replace);
+	M_REQUIRE(is_policy(replace), ERR_BAD_PARAMETER, "Wrong replacement policy", replace);
 	M_REQUIRE(paddr->page_offset % sizeof(word_t) == 0, ERR_BAD_PARAMETER, "Physical address not aligned with words", paddr);
 	void* cache;
 	
-	word_t l1_line[L1_DCACHE_WORDS_PER_LINE];
-	word_t l2_line[L2_CACHE_WORDS_PER_LINE];
+	const uint32_t* l1_line = NULL;
+	const uint32_t* l2_line = NULL;
 	
 	const uint32_t** p_l1_line = &l1_line;
-	const uint32_t**  p_l2_line = &l2_line;
+	const uint32_t** p_l2_line = &l2_line;
 	
 	
 	l1_dcache_entry_t l1_entry_evicted; //in case we have to evict something
@@ -396,8 +509,8 @@ int cache_write(void * mem_space,
 	uint16_t hit_index = HIT_INDEX_MISS;
 	uint32_t phy_addr = convert_paddr(paddr);
 	
-	//getting the word select bytes
-	uint8_t word_select = phy_addr & 0xC;
+	//getting the index of the word in the line
+	uint8_t word_select = (phy_addr % L1_DCACHE_LINE) / sizeof(word_t);
 	uint32_t* central_mem = mem_space;	
 	
 	
@@ -410,8 +523,11 @@ int cache_write(void * mem_space,
 		cache = l1_cache;
 		
 		l1_dcache_entry_t modified_entry; 
+		zero_init_var(modified_entry);
 		modified_entry.v = 1;
-		modified_entry.age = 0;
+		modified_entry.state = cache_entry(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way)->state;
+		modified_entry.dirty = (write_policy == WRITE_BACK);
+		modified_entry.age = cache_age(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way);
 		modified_entry.tag = cache_tag(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way);
 		
 		for(size_t i=0; i<L1_DCACHE_WORDS_PER_LINE; i++)
@@ -421,14 +537,16 @@ int cache_write(void * mem_space,
 		modified_entry.line[word_select] = *word;	
 		M_EXIT_IF_ERR(cache_insert(hit_index, hit_way, &modified_entry, l1_cache, L1_DCACHE),
 			"reinserting data in level 1");
-		LRU_age_update(l1_dcache_entry_t,L1_DCACHE_WAYS,hit_way,hit_index);
-		
-		uint32_t addr_beginning = 0;		
-		addr_beginning = phy_addr - (phy_addr % L1_DCACHE_LINE);
-		addr_beginning /= L1_DCACHE_WORDS_PER_LINE;
+		policy_hit(l1_cache, L1_DCACHE, hit_index, hit_way, replace);
 		
-		for(size_t i=0; i<L1_DCACHE_WORDS_PER_LINE; i++)
-			*(central_mem + addr_beginning + i) = modified_entry.line[i];
+		if(write_policy == WRITE_THROUGH){
+			uint32_t addr_beginning = 0;		
+			addr_beginning = phy_addr - (phy_addr % L1_DCACHE_LINE);
+			addr_beginning /= L1_DCACHE_WORDS_PER_LINE;
+			
+			for(size_t i=0; i<L1_DCACHE_WORDS_PER_LINE; i++)
+				*(central_mem + addr_beginning + i) = modified_entry.line[i];
+		}
 	
 
 	}else{
@@ -445,6 +563,8 @@ int cache_write(void * mem_space,
 			
 			l2_cache_entry_t l2_modified_entry;
 			l2_modified_entry.v = 1;
+			l2_modified_entry.dirty = cache_entry(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way)->dirty;
+			l2_modified_entry.age = cache_age(l2_cache_entry_t, L2_CACHE_WAYS, hit_index, hit_way);
 			l2_modified_entry.tag = cache_tag(l2_cache_entry_t,L2_CACHE_WAYS,hit_index ,hit_way);
 			
 			for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
@@ -453,14 +573,24 @@ int cache_write(void * mem_space,
 			l2_modified_entry.line[word_select] = *word;
 			M_EXIT_IF_ERR(cache_insert(hit_index, hit_way, &l2_modified_entry, l2_cache, L2_CACHE),
 				"reinserting data in level 2");	
-			LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS,hit_way,hit_index);
+			policy_hit(l2_cache, L2_CACHE, hit_index, hit_way, replace);
 
 			//devalidating entry in level 2
 			cache_valid(l2_cache_entry_t,L2_CACHE_WAYS, hit_index,hit_way) = 0;
 		
+			//write-through
+			if(write_policy == WRITE_THROUGH){
+				uint32_t addr_beginning = phy_addr - (phy_addr % L2_CACHE_LINE);
+				addr_beginning /= sizeof(word_t);
+				for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
+					*(central_mem + addr_beginning + i) = l2_modified_entry.line[i];
+			}
+		
 			//now insertion to level1
 			l1_dcache_entry_t l1_insertion_entry;
+			zero_init_var(l1_insertion_entry);
 			l1_insertion_entry.v = 1;
+			l1_insertion_entry.dirty = (write_policy == WRITE_BACK);
 			l1_insertion_entry.tag = phy_addr >> L1_DCACHE_TAG_REMAINING_BITS;
 			
 			for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++)
@@ -469,7 +599,7 @@ int cache_write(void * mem_space,
 			uint32_t l1_insertion_index = phy_addr / (L1_DCACHE_WORDS_PER_LINE * sizeof(word_t));
 			l1_insertion_index %=  L1_DCACHE_LINES;
 			
-			//this is for macros to work - LRU_age_increase
+			//this is for macros to work - cache_valid
 			cache = l1_cache;
 			
 			search_place_and_insert(l1_dcache_entry_t, L1_DCACHE_WAYS, l1_insertion_index, 
@@ -503,12 +633,15 @@ int cache_write(void * mem_space,
 			line_read[word_select] = *word;
 			
 			l1_dcache_entry_t l1_final_insertion;
+			zero_init_var(l1_final_insertion);
 			l1_final_insertion.v = 1;
 			l1_final_insertion.age = 0;
+			l1_final_insertion.dirty = (write_policy == WRITE_BACK);
 			l1_final_insertion.tag = phy_addr >> L1_DCACHE_TAG_REMAINING_BITS;
 		
 			for(size_t i=0; i<L1_DCACHE_WORDS_PER_LINE; i++){
-			*(central_mem + addr_beginning + i) = line_read[i];
+			if(write_policy == WRITE_THROUGH)
+				*(central_mem + addr_beginning + i) = line_read[i];
 			l1_final_insertion.line[i] = line_read[i];
 			}
 
@@ -537,6 +670,15 @@ int cache_write(void * mem_space,
 		return ERR_NONE;
 }
 
+int cache_write(void * mem_space,
+                phy_addr_t * paddr,
+                void * l1_cache,
+                void * l2_cache,
+                const uint32_t * word,
+                cache_replace_t replace){
+	return write_word(mem_space, paddr, l1_cache, l2_cache, word, replace, WRITE_THROUGH);
+}
+
 int cache_write_byte(void * mem_space,
                      phy_addr_t * paddr,
                      void * l1_cache,
@@ -548,12 +690,17 @@ int cache_write_byte(void * mem_space,
 	M_REQUIRE_NON_NULL(paddr);
 	M_REQUIRE_NON_NULL(l1_cache);
 	M_REQUIRE_NON_NULL(l2_cache);	
-	M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "Wrong replacement policy", replace);		 
+	M_REQUIRE(is_policy(replace), ERR_BAD_PARAMETER, "Wrong replacement policy", replace);		 
 	
 	uint32_t phy_addr = convert_paddr(paddr);
 	uint8_t byte_select = phy_addr % sizeof(word_t);
+	
+	//reading then writing back the whole word the byte belongs to
+	phy_addr_t word_paddr = *paddr;
+	word_paddr.page_offset -= byte_select;
+	
 	word_t word;
-	int err_code = cache_read(mem_space, paddr, L1_DCACHE, l1_cache, l2_cache, &word, replace);
+	int err_code = cache_read(mem_space, &word_paddr, DATA, l1_cache, l2_cache, &word, replace);
 	if(err_code != ERR_NONE){
 		fprintf(stderr, "Some error encountered in cache_read\n");
 		return err_code;
@@ -564,7 +711,277 @@ int cache_write_byte(void * mem_space,
 	word &= mask;
 	uint32_t temp = p_byte << (BYTE_WIDTH * byte_select);
 	word |= temp;
-	return cache_write(mem_space, paddr, l1_cache, l2_cache, &word, replace);
+	return cache_write(mem_space, &word_paddr, l1_cache, l2_cache, &word, replace);
+}
+
+//looking for a word in level 1, without any check;
+//on hit, the word is read from its line and the policy is updated as cache_read() does
+static inline bool l1_read_hit(void * cache, uint32_t phy_addr, word_t * word, cache_replace_t replace){
+	const uint16_t index = (phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES;
+	const uint32_t tag = phy_addr >> L1_ICACHE_TAG_REMAINING_BITS;
+
+	foreach_way(hit_way, L1_ICACHE_WAYS){
+		if(cache_valid(l1_icache_entry_t, L1_ICACHE_WAYS, index, hit_way) == 1
+			&& cache_tag(l1_icache_entry_t, L1_ICACHE_WAYS, index, hit_way) == tag){
+			*word = cache_line(l1_icache_entry_t, L1_ICACHE_WAYS, index, hit_way)[(phy_addr % L1_ICACHE_LINE) / sizeof(word_t)];
+			policy_hit(cache, L1_ICACHE, index, hit_way, replace);
+			return true;
+		}
+	}
+	return false;
+}
+
+//same for a write in level 1 data cache: the whole line is written through, as cache_write() does,
+//or marked dirty
+static inline bool l1_write_hit(void * cache, uint32_t * central_mem, uint32_t phy_addr, word_t word,
+                                cache_replace_t replace, cache_write_t write_policy){
+	const uint16_t index = (phy_addr / L1_DCACHE_LINE) % L1_DCACHE_LINES;
+	const uint32_t tag = phy_addr >> L1_DCACHE_TAG_REMAINING_BITS;
+
+	foreach_way(hit_way, L1_DCACHE_WAYS){
+		if(cache_valid(l1_dcache_entry_t, L1_DCACHE_WAYS, index, hit_way) == 1
+			&& cache_tag(l1_dcache_entry_t, L1_DCACHE_WAYS, index, hit_way) == tag){
+			word_t* const line = cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, index, hit_way);
+			line[(phy_addr % L1_DCACHE_LINE) / sizeof(word_t)] = word;
+			policy_hit(cache, L1_DCACHE, index, hit_way, replace);
+			if(write_policy == WRITE_BACK){
+				cache_entry(l1_dcache_entry_t, L1_DCACHE_WAYS, index, hit_way)->dirty = 1;
+				return true;
+			}
+
+			const uint32_t addr_beginning = (phy_addr - (phy_addr % L1_DCACHE_LINE)) / sizeof(word_t);
+			for(size_t i=0; i<L1_DCACHE_WORDS_PER_LINE; i++)
+				central_mem[addr_beginning + i] = line[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+//recording a miss in level 1 before it is processed: what level 2 does,
+//and which lines will be evicted from level 1 and then from level 2
+static void record_l1_miss(sim_stats_t * stats, void * l1_cache, void * l2_cache, mem_access_t type, uint32_t phy_addr,
+                           cache_replace_t replace){
+	const stats_level_t l1_level = (type == INSTRUCTION) ? STATS_L1_ICACHE : STATS_L1_DCACHE;
+	const uint64_t line_number = phy_addr / L1_ICACHE_LINE;
+	stats_access(stats, l1_level, line_number, false);
+
+	void* cache = l2_cache;
+	const uint16_t l2_index = (phy_addr / L2_CACHE_LINE) % L2_CACHE_LINES;
+	const uint32_t l2_tag = phy_addr >> L2_CACHE_TAG_REMAINING_BITS;
+	uint8_t l2_hit_way = HIT_WAY_MISS;
+	foreach_way(way, L2_CACHE_WAYS){
+		if(l2_hit_way == HIT_WAY_MISS && cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, l2_index, way) == 1
+			&& cache_tag(l2_cache_entry_t, L2_CACHE_WAYS, l2_index, way) == l2_tag){
+			l2_hit_way = way;
+		}
+	}
+	stats_access(stats, STATS_L2_CACHE, line_number, l2_hit_way != HIT_WAY_MISS);
+
+	//a full set of level 1 evicts a line (as place_on_max_way() chooses it) into level 2
+	cache = l1_cache;
+	const uint16_t l1_index = (phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES;
+	foreach_way(way, L1_ICACHE_WAYS){
+		if(cache_valid(l1_icache_entry_t, L1_ICACHE_WAYS, l1_index, way) == 0){
+			return;
+		}
+	}
+	const uint8_t eviction_way = policy_victim(l1_cache, L1_ICACHE, l1_index, replace);
+	++stats->levels[l1_level].evictions;
+	++stats->victims;
+
+	//which evicts a line of level 2 in turn, unless its set has a free way
+	//(possibly the one the missing line is moved up from) or a copy of it,
+	//written back if dirty
+	const uint32_t victim_tag = cache_tag(l1_icache_entry_t, L1_ICACHE_WAYS, l1_index, eviction_way);
+	const uint16_t l2_victim_index = ((victim_tag & LSB_THREE_MASK) << LINE_INDEX_BITS) | l1_index;
+	cache = l2_cache;
+	foreach_way(way, L2_CACHE_WAYS){
+		if(cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, l2_victim_index, way) == 0
+			|| (l2_victim_index == l2_index && way == l2_hit_way)
+			|| cache_tag(l2_cache_entry_t, L2_CACHE_WAYS, l2_victim_index, way) == victim_tag >> TAG_DIFFERENCE_BITS){
+			return;
+		}
+	}
+	const uint8_t l2_eviction_way = policy_victim(l2_cache, L2_CACHE, l2_victim_index, replace);
+	++stats->levels[STATS_L2_CACHE].evictions;
+	stats->memory_writes += cache_entry(l2_cache_entry_t, L2_CACHE_WAYS, l2_victim_index, l2_eviction_way)->dirty;
+}
+
+//a line missing from a level 1 cache may be dirty in another one: that of the other kind of its
+//core (an instruction written as data, or a dirty line moved up from level 2), or with several
+//cores any of theirs (see coherence_write_back()); it is written back before being read
+static size_t write_back_copies(void * mem_space, void * l1_icache, void * l1_dcache,
+                                coherence_t * coherence, size_t core, mem_access_t type, uint32_t phy_addr){
+	if(coherence != NULL){
+		return coherence_write_back(coherence, core, type, mem_space, phy_addr);
+	}
+	void* const cache = (type == INSTRUCTION) ? l1_dcache : l1_icache;
+	const uint16_t index = (phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES;
+	const uint32_t tag = phy_addr >> L1_ICACHE_TAG_REMAINING_BITS;
+	foreach_way(way, L1_ICACHE_WAYS){
+		l1_icache_entry_t* const entry = cache_entry(l1_icache_entry_t, L1_ICACHE_WAYS, index, way);
+		if(entry->v == 1 && entry->tag == tag && entry->dirty == 1){
+			write_back(mem_space, entry->line, phy_addr - (phy_addr % L1_ICACHE_LINE));
+			entry->dirty = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//with several cores, level 2 and the memory are only accessed holding the bus,
+//and level 1 is only looked up holding either the bus or the lock of its core (see coherence.h)
+static inline void bus_acquire(coherence_t * coherence){
+	if(coherence != NULL){
+		pthread_mutex_lock(&coherence->bus);
+	}
+}
+
+static inline void bus_release(coherence_t * coherence){
+	if(coherence != NULL){
+		pthread_mutex_unlock(&coherence->bus);
+	}
+}
+
+static inline void l1_lock_acquire(coherence_t * coherence, size_t core){
+	if(coherence != NULL){
+		pthread_mutex_lock(&coherence->l1_locks[core]);
+	}
+}
+
+static inline void l1_lock_release(coherence_t * coherence, size_t core){
+	if(coherence != NULL){
+		pthread_mutex_unlock(&coherence->l1_locks[core]);
+	}
+}
+
+int cache_access_batch(void * mem_space,
+                       cache_access_t * accesses,
+                       size_t nb_accesses,
+                       void * l1_icache,
+                       void * l1_dcache,
+                       void * l2_cache,
+                       coherence_t * coherence,
+                       size_t core,
+                       cache_replace_t replace,
+                       cache_write_t write_policy,
+                       size_t prefetch_distance,
+                       sim_stats_t * stats){
+
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM);
+	M_REQUIRE_NON_NULL(accesses);
+	M_REQUIRE_NON_NULL(l1_icache);
+	M_REQUIRE_NON_NULL(l1_dcache);
+	M_REQUIRE_NON_NULL(l2_cache);
+	M_REQUIRE(is_policy(replace), ERR_BAD_PARAMETER, "Wrong replacement policy %d", replace);
+	M_REQUIRE(write_policy == WRITE_THROUGH || write_policy == WRITE_BACK, ERR_BAD_PARAMETER,
+		"Wrong write policy %d", write_policy);
+	M_REQUIRE(coherence == NULL || core < coherence->nb_cores, ERR_BAD_PARAMETER, "Wrong core %zu", core);
+
+	for(size_t i = 0; i < nb_accesses; ++i){
+		cache_access_t* const access = &accesses[i];
+		M_REQUIRE(access->type == INSTRUCTION || access->type == DATA, ERR_BAD_PARAMETER,
+			"Wrong access demand %d", access->type);
+		M_REQUIRE(access->order == READ || (access->order == WRITE && access->type == DATA), ERR_BAD_PARAMETER,
+			"Wrong order %d", access->order);
+		M_REQUIRE(access->data_size == sizeof(word_t) || access->data_size == 1, ERR_BAD_PARAMETER,
+			"Wrong data size %" PRIu8, access->data_size);
+		M_REQUIRE(access->data_size == 1 || access->paddr.page_offset % sizeof(word_t) == 0, ERR_BAD_PARAMETER,
+			"Physical address not aligned with words%s", "");
+
+		if(prefetch_distance > 0 && i + prefetch_distance < nb_accesses){
+			const cache_access_t* const ahead = &accesses[i + prefetch_distance];
+			void* cache = (ahead->type == INSTRUCTION) ? l1_icache : l1_dcache;
+			const uint16_t ahead_index = (convert_paddr((&ahead->paddr)) / L1_ICACHE_LINE) % L1_ICACHE_LINES;
+			const l1_icache_entry_t* const set = cache_entry(l1_icache_entry_t, L1_ICACHE_WAYS, ahead_index, 0);
+			__builtin_prefetch(set, 1);
+			__builtin_prefetch(set + L1_ICACHE_WAYS - 1, 1);
+		}
+
+		void* const l1_cache = (access->type == INSTRUCTION) ? l1_icache : l1_dcache;
+		const uint32_t phy_addr = convert_paddr((&access->paddr));
+		const uint8_t byte_select = phy_addr % sizeof(word_t);
+		phy_addr_t word_paddr = access->paddr;
+		word_paddr.page_offset -= byte_select;
+
+		//reads, and writes of a byte, first read the whole word
+		word_t word = access->data;
+		if(access->order == READ || access->data_size == 1){
+			l1_lock_acquire(coherence, core);
+			const bool hit = l1_read_hit(l1_cache, phy_addr - byte_select, &word, replace);
+			l1_lock_release(coherence, core);
+			if(hit){
+				HEATMAP_RECORD((access->type == INSTRUCTION) ? STATS_L1_ICACHE : STATS_L1_DCACHE,
+					(phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES, phy_addr >> PAGE_OFFSET, HEATMAP_HIT);
+				if(stats != NULL){
+					stats_access(stats, (access->type == INSTRUCTION) ? STATS_L1_ICACHE : STATS_L1_DCACHE,
+						phy_addr / L1_ICACHE_LINE, true);
+				}
+			}else{
+				bus_acquire(coherence);
+				if(stats != NULL){
+					record_l1_miss(stats, l1_cache, l2_cache, access->type, phy_addr, replace);
+				}
+				if(write_policy == WRITE_BACK){
+					const size_t written = write_back_copies(mem_space, l1_icache, l1_dcache, coherence, core,
+						access->type, phy_addr);
+					if(stats != NULL){
+						stats->memory_writes += written;
+					}
+				}
+				const int err = cache_read(mem_space, &word_paddr, access->type, l1_cache, l2_cache, &word, replace);
+				if(coherence != NULL && err == ERR_NONE){
+					coherence_read_miss(coherence, core, access->type, phy_addr);
+				}
+				bus_release(coherence);
+				M_EXIT_IF_ERR(err, "reading word");
+			}
+		}
+
+		if(access->order == READ){
+			access->data = (access->data_size == 1) ? (word >> (BYTE_WIDTH * byte_select)) & UCHAR_MAX : word;
+			continue;
+		}
+
+		if(access->data_size == 1){
+			word &= ~((word_t) UCHAR_MAX << (BYTE_WIDTH * byte_select));
+			word |= (access->data & UCHAR_MAX) << (BYTE_WIDTH * byte_select);
+		}
+		if(stats != NULL && write_policy == WRITE_THROUGH){
+			//write-through: the whole line goes to memory, whatever the level
+			++stats->memory_writes;
+		}
+		bus_acquire(coherence);
+		const mesi_state_t state = (coherence != NULL) ? coherence_state(l1_dcache, phy_addr) : MESI_INVALID;
+		int err = ERR_NONE;
+		if(l1_write_hit(l1_dcache, mem_space, phy_addr - byte_select, word, replace, write_policy)){
+			HEATMAP_RECORD(STATS_L1_DCACHE, (phy_addr / L1_DCACHE_LINE) % L1_DCACHE_LINES,
+				phy_addr >> PAGE_OFFSET, HEATMAP_HIT);
+			if(stats != NULL && access->data_size != 1){
+				stats_access(stats, STATS_L1_DCACHE, phy_addr / L1_DCACHE_LINE, true);
+			}
+		}else{
+			if(stats != NULL){
+				record_l1_miss(stats, l1_dcache, l2_cache, DATA, phy_addr, replace);
+			}
+			if(write_policy == WRITE_BACK){
+				const size_t written = write_back_copies(mem_space, l1_icache, l1_dcache, coherence, core,
+					DATA, phy_addr);
+				if(stats != NULL){
+					stats->memory_writes += written;
+				}
+			}
+			err = write_word(mem_space, &word_paddr, l1_dcache, l2_cache, &word, replace, write_policy);
+		}
+		if(coherence != NULL && err == ERR_NONE){
+			coherence_write(coherence, core, l2_cache, phy_addr, state);
+		}
+		bus_release(coherence);
+		M_EXIT_IF_ERR(err, "writing word");
+	}
+
+	return ERR_NONE;
 }
 
 //=========================================================================
@@ -11,11 +11,42 @@
 #include "mem_access.h"
 #include "addr.h"
 #include "cache.h"
+#include "commands.h" // for command_word_t
+#include "stats.h"
+#include "heatmap.h"
+#include "coherence.h"
 #include <stdio.h> // for FILE
 
-enum cache_replacement_policy { LRU };
+// replacement policies, of both the caches of cache_mng.c (see l1_cache_policy_t in cache.h)
+// and the run-time caches (rt_cache_mng.h):
+//  - PLRU: tree pseudo-LRU, one bit per node of a binary tree over the ways of a set
+//  - SRRIP: static re-reference interval prediction, lines inserted as "long" re-reference
+//  - BRRIP: bimodal RRIP, lines mostly inserted as "distant" re-reference (scan resistant)
+//  - RANDOM: evicting any way
+enum cache_replacement_policy { LRU, PLRU, SRRIP, BRRIP, RANDOM };
 typedef enum cache_replacement_policy cache_replace_t;
 
+// how writes reach the memory:
+//  - WRITE_THROUGH: the whole line, on every write
+//  - WRITE_BACK: only once the line leaves the caches, evicted from level 2 or written back by
+//    cache_write_back(); a dirty bit marks the lines written since they were read from memory
+// cache_write() writes through; cache_access_batch() implements both
+enum cache_write_policy { WRITE_THROUGH, WRITE_BACK };
+typedef enum cache_write_policy cache_write_t;
+
+/**
+ * One access of a batch (see cache_access_batch()).
+ */
+typedef struct{
+	phy_addr_t paddr; // aligned on a word for word accesses
+	word_t data; // word or byte to write; word or byte read, once processed
+	command_word_t order;
+	mem_access_t type; // writes are DATA
+	uint8_t data_size; // sizeof(word_t) or 1
+}cache_access_t;
+
+#define CACHE_BATCH_PREFETCH_DISTANCE 4 // worth it once the caches no longer fit in those of the host
+
 #define HIT_WAY_MISS   ((uint8_t)  -1)
 #define HIT_INDEX_MISS ((uint16_t) -1)
 
@@ -36,17 +67,33 @@ typedef enum cache_replacement_policy cache_replace_t;
  
 #define convert_paddr(paddr) ((paddr->phy_page_num << PAGE_OFFSET) | paddr->page_offset) 
 
-#define init_cache_for_flush(cache_type, cache_lines, cache_ways) \
+#define init_cache_for_flush(cache_type, policy_type, cache_lines, cache_ways) \
 	cache_type* chosen_cache = cache; \
 	for(int i=0; i<(cache_lines * cache_ways); i++){ \
 		zero_init_var(chosen_cache[i]); \
 	} \
+	zero_init_ptr(cache_policy(cache_type, policy_type, cache_ways, cache_lines)); \
+
+//writing every dirty line of a cache back to memory, at the address of its tag and index
+#define write_back_dirty_lines(cache_type, cache_lines, cache_ways, cache_remaining_bits, cache_line) \
+	for(uint16_t index = 0; index < cache_lines; index++){ \
+		foreach_way(way, cache_ways){ \
+			cache_type* const dirty_entry = cache_entry(cache_type, cache_ways, index, way); \
+			if(dirty_entry->v == 1 && dirty_entry->dirty == 1){ \
+				write_back(mem_space, dirty_entry->line, \
+					((uint32_t) dirty_entry->tag << (cache_remaining_bits)) | (index * (cache_line))); \
+				dirty_entry->dirty = 0; \
+				++written; \
+			} \
+		} \
+	} \
 
 #define set_cache_init_val(cache_type, remaining_bits, words_per_line, cache_line)\
 	cache_type* cache_init = cache_entry; \
 	cache_init -> tag = (phy_addr >> remaining_bits); \
 	cache_init -> age = 0; \
 	cache_init -> v = 1; \
+	cache_init -> dirty = 0; \
 	addr_beginning = phy_addr - (phy_addr % cache_line); \
 	addr_beginning /= words_per_line; \
 	const uint32_t* newMem = mem_space;	\
@@ -56,7 +103,7 @@ typedef enum cache_replacement_policy cache_replace_t;
 	
 //checking if there is a match condition for ways in index
 //sets hit_way and hit_index accordingly	
-#define cache_hit_miss_process(words_per_line, cache_lines, cache_ways, cache_remaining_bits, cache_type) \
+#define cache_hit_miss_process(words_per_line, cache_lines, cache_ways, cache_remaining_bits, cache_type, level) \
 	index = phy_addr / (words_per_line * sizeof(word_t)); \
 	index %=  cache_lines; \
 	tag = (phy_addr >>  cache_remaining_bits); \
@@ -66,79 +113,107 @@ typedef enum cache_replacement_policy cache_replace_t;
 			*hit_way = way; \
 			*hit_index = index; \
 			*p_line = cache_line(cache_type, cache_ways, index, way); \
+			HEATMAP_RECORD(level, index, phy_addr >> PAGE_OFFSET, HEATMAP_HIT); \
 			return ERR_NONE; \
 		}else{ \
 			*hit_way = HIT_WAY_MISS; \
 			*hit_index = HIT_INDEX_MISS; \
 		} \
 	} \
+	HEATMAP_RECORD(level, index, phy_addr >> PAGE_OFFSET, HEATMAP_MISS); \
 	
+//a valid line replaced by a line of another tag counts as an eviction
+//at the physical page of the replaced line (moves and updates do not)
+#ifdef HEATMAP
+#define heatmap_cache_eviction(old_entry, new_entry, cache_remaining_bits, cache_line, level) \
+	if((old_entry).v == 1 && (new_entry).v == 1 && (old_entry).tag != (new_entry).tag){ \
+		HEATMAP_RECORD(level, cache_line_index, \
+			(((uint32_t) (old_entry).tag << (cache_remaining_bits)) | (cache_line_index * (cache_line))) >> PAGE_OFFSET, \
+			HEATMAP_EVICTION); \
+	}
+#else
+#define heatmap_cache_eviction(old_entry, new_entry, cache_remaining_bits, cache_line, level)
+#endif
+
 //controlling if line and way index are in bounds then
 //inserting the cache entry in argument
-#define insert_cache(cache_lines, cache_ways, cache_type) \
+#define insert_cache(cache_lines, cache_ways, cache_type, cache_remaining_bits, cache_line, level) \
 	M_REQUIRE(cache_line_index < cache_lines, ERR_BAD_PARAMETER, "Wrong index for insertion in cache", cache_line_in); \
 	M_REQUIRE(cache_way < cache_ways, ERR_BAD_PARAMETER, "Wrong cache_way for insertion in cache", cache_way); \
 	cache_type *  cache_to_insert = cache; \
 	const cache_type *  cache_entry = cache_line_in; \
+	heatmap_cache_eviction(cache_to_insert[cache_way +  ((cache_ways) * cache_line_index)], *cache_entry, \
+		cache_remaining_bits, cache_line, level) \
 	cache_to_insert[cache_way +  ((cache_ways) * cache_line_index)] = *cache_entry; \
 	
 
-//founding the way index of the entry to evict
+//founding the way index of the entry to evict, as the replacement policy chooses it
 //memorising the entry to evict 
 #define place_on_max_way(cache_type, cache_ways, insertion_entry , insertion_index, cache, cache_enum) \
-	uint8_t eviction_way = 0; \
-	uint8_t max_age = 0; \
-		for(size_t i = 0; i<cache_ways; i++){ \
-			if(max_age < cache_age(cache_type,cache_ways,insertion_index, i)){ \
-				max_age = cache_age(cache_type,cache_ways,insertion_index, i); \
-				eviction_way = i; \
-			} \
-		} \
+	const uint8_t eviction_way = policy_evict(cache, cache_enum, insertion_index, replace); \
 		l1_entry_evicted = *(cache_entry(cache_type, cache_ways,insertion_index, eviction_way)); \
+		insertion_entry.age = l1_entry_evicted.age; /* so that LRU_age_update() ages the other ways */ \
 		M_EXIT_IF_ERR(cache_insert(insertion_index,eviction_way, &insertion_entry, cache, cache_enum) \
 				,"insertion of entry on lru"); \
-		LRU_age_update(cache_type, cache_ways,eviction_way, insertion_index); \
+		policy_fill(cache, cache_enum, insertion_index, eviction_way, true, replace); \
   
 //cache = l2_cache is for LRU age changes to work on level 2 cache macro
 //we compute the line to insert evicted entry back in level 2
 //to do so we use last three bits of tag(0x7 masking) and index in level1 
-//then we look for a free place in ways on l2_evicted_insertion_index
+//a copy already there (evicted by the level 1 cache of another core) is replaced,
+//its data only kept if it is dirty and the evicted line is not (see WRITE_BACK)
+//otherwise we look for a free place in ways on l2_evicted_insertion_index
 //in case we couldn't find a place on l2_evicted_insertion_index
-//we put it on least recently used
-//also finding the way index of the entry to evict
+//we put it on the way the replacement policy evicts
+//also finding the way index of the entry to evict, written back to memory if dirty
 #define insert_evicted_into_l2(evicted_l1, index_for_l1) \
 	cache = l2_cache; \
 	uint16_t l2_evicted_insertion_index = ((evicted_l1.tag & LSB_THREE_MASK) << LINE_INDEX_BITS) | index_for_l1; \
 	l2_cache_entry_t l2_evicted_insertion; \
 	l2_evicted_insertion.v = 1; \
 	l2_evicted_insertion.age = 0; \
+	l2_evicted_insertion.dirty = evicted_l1.dirty; \
 	l2_evicted_insertion.tag = evicted_l1.tag >> TAG_DIFFERENCE_BITS; \
 	for(size_t i=0; i<L2_CACHE_WORDS_PER_LINE; i++){ \
 		l2_evicted_insertion.line[i] = evicted_l1.line[i]; \
 	} \
 	way_found = false; \
+	foreach_way(copy_way, L2_CACHE_WAYS){ \
+		const l2_cache_entry_t* const l2_copy = cache_entry(l2_cache_entry_t, L2_CACHE_WAYS, \
+			l2_evicted_insertion_index, copy_way); \
+		if(!way_found && l2_copy->v == 1 && l2_copy->tag == l2_evicted_insertion.tag){ \
+			if(l2_copy->dirty == 1 && l2_evicted_insertion.dirty == 0){ \
+				l2_evicted_insertion = *l2_copy; \
+			} \
+			l2_evicted_insertion.age = l2_copy->age; \
+			M_EXIT_IF_ERR(cache_insert(l2_evicted_insertion_index, \
+				copy_way, &l2_evicted_insertion, l2_cache, L2_CACHE),"replacement of the copy of the evicted entry "); \
+			way_found = true; \
+			policy_hit(l2_cache, L2_CACHE, l2_evicted_insertion_index, copy_way, replace); \
+		} \
+	} \
 	way = 0; \
 	while(way < L2_CACHE_WAYS && !way_found){ \
 		if(cache_valid(l2_cache_entry_t,L2_CACHE_WAYS, l2_evicted_insertion_index, way) == 0){ \
 			M_EXIT_IF_ERR(cache_insert(l2_evicted_insertion_index, \
 				way, &l2_evicted_insertion, l2_cache, L2_CACHE),"insertion of the evicted entry "); \
 			way_found = true; \
-			LRU_age_increase(l2_cache_entry_t,L2_CACHE_WAYS, way, l2_evicted_insertion_index); \
+			policy_fill(l2_cache, L2_CACHE, l2_evicted_insertion_index, way, false, replace); \
 		} \
 	way++; \
 	} \
 	if(!way_found){ \
-		uint8_t eviction_way = 0; \
-		uint8_t max_age = 0; \
-		for(size_t i = 0; i<L2_CACHE_WAYS; i++){ \
-			if(max_age < cache_age(l2_cache_entry_t,L2_CACHE_WAYS,l2_evicted_insertion_index, i)){ \
-				max_age = cache_age(l2_cache_entry_t,L2_CACHE_WAYS,l2_evicted_insertion_index, i); \
-				eviction_way = i; \
-			} \
+		const uint8_t eviction_way = policy_evict(l2_cache, L2_CACHE, l2_evicted_insertion_index, replace); \
+		const l2_cache_entry_t* const l2_victim = cache_entry(l2_cache_entry_t, L2_CACHE_WAYS, \
+			l2_evicted_insertion_index, eviction_way); \
+		if(l2_victim->dirty == 1){ \
+			write_back(mem_space, l2_victim->line, ((uint32_t) l2_victim->tag << L2_CACHE_TAG_REMAINING_BITS) \
+				| (l2_evicted_insertion_index * L2_CACHE_LINE)); \
 		} \
+		l2_evicted_insertion.age = l2_victim->age; \
 		M_EXIT_IF_ERR(cache_insert(l2_evicted_insertion_index,eviction_way, \
 			&l2_evicted_insertion,l2_cache,L2_CACHE),"insertion of the evicted entry "); \
-		LRU_age_update(l2_cache_entry_t,L2_CACHE_WAYS,eviction_way, l2_evicted_insertion_index); \
+		policy_fill(l2_cache, L2_CACHE, l2_evicted_insertion_index, eviction_way, true, replace); \
 	} \
 	
 //we look for a free place in ways on l1_insertion_index
@@ -150,7 +225,7 @@ typedef enum cache_replacement_policy cache_replace_t;
 			M_EXIT_IF_ERR(cache_insert(insertion_index, way, &insertion_entry, cache, cache_enum), \
 				"insertion of entry on free way"); \
 			way_found = true; \
-			LRU_age_increase(cache_type,cache_ways,way,insertion_index); \
+			policy_fill(cache, cache_enum, insertion_index, way, false, replace); \
 		} \
 		way++; \
 	} \
@@ -161,13 +236,27 @@ typedef enum cache_replacement_policy cache_replace_t;
 /**
  * @brief Clean a cache (invalidate, reset...).
  *
- * This function erases all cache data.
- * @param cache pointer to the cache
+ * This function erases all cache data: dirty lines are lost, unless written back
+ * first by cache_write_back(). The replacement state of its sets is reset too.
+ * @param cache pointer to the cache, of L1_ICACHE_SIZE, L1_DCACHE_SIZE or L2_CACHE_SIZE bytes
  * @param cache_type an enum to distinguish between different caches
  * @return error code
  */
 int cache_flush(void *cache, cache_t cache_type);
 
+//=========================================================================
+/**
+ * @brief Write every dirty line of a cache back to memory (see WRITE_BACK),
+ *        the lines staying valid, clean.
+ *
+ * @param mem_space pointer to the memory space
+ * @param cache pointer to the cache
+ * @param cache_type an enum to distinguish between different caches
+ * @param nb_lines (modified) incremented by the number of lines written, NULL if not needed
+ * @return error code
+ */
+int cache_write_back(void * mem_space, void *cache, cache_t cache_type, uint64_t * nb_lines);
+
 //=========================================================================
 /**
  * @brief Check if a instruction/data is present in one of the caches.
@@ -241,6 +330,9 @@ int cache_entry_init(const void * mem_space,
  *      in L2, then it is fetched from main memory and placed just in L1 and not
  *      in L2.
  *
+ * A dirty line evicted from L2 to make room for the one evicted from L1 is
+ * written back to memory (see WRITE_BACK).
+ *
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
  * @param access to distinguish between fetching instructions and reading/writing data
@@ -250,7 +342,7 @@ int cache_entry_init(const void * mem_space,
  * @param replace replacement policy
  * @return error code
  */
-int cache_read(const void * mem_space,
+int cache_read(void * mem_space,
                phy_addr_t * paddr,
                mem_access_t access,
                void * l1_cache,
@@ -271,7 +363,7 @@ int cache_read(const void * mem_space,
  * @param replace replacement policy
  * @return error code
  */
-int cache_read_byte(const void * mem_space,
+int cache_read_byte(void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
                     void * l1_cache,
@@ -318,6 +410,58 @@ int cache_write_byte(void * mem_space,
                      uint8_t p_byte,
                      cache_replace_t replace);
 
+//=========================================================================
+/**
+ * @brief Process a batch of accesses in order, with the same results as
+ *        cache_read(), cache_read_byte(), cache_write() and cache_write_byte()
+ *        called one at a time.
+ *
+ * The caches, the memory and the policy are checked once for the whole batch.
+ * On error, processing stops at the faulty access: the following ones are
+ * left unchanged.
+ *
+ * Statistics count one reference per access: a byte write is counted as
+ * its read (the word is then written to level 1, where it always hits).
+ *
+ * Writes follow the given policy: WRITE_THROUGH gives the same results as
+ * cache_write(); with WRITE_BACK, the memory is only up to date once the
+ * caches are written back by cache_write_back(). A line missing from a level 1
+ * cache is first written back if dirty in another one, so that none misses a
+ * write.
+ *
+ * With several cores, the level 1 caches are those of one of them, kept
+ * coherent with the others' on the bus shared with level 2 (see coherence.h):
+ * every access but a level 1 read hit holds the bus, since it reaches level 2,
+ * writes to memory or snoops the other cores.
+ *
+ * @param mem_space pointer to the memory space
+ * @param accesses (modified) the accesses, reads get their data
+ * @param nb_accesses number of accesses
+ * @param l1_icache pointer to the beginning of L1 ICACHE
+ * @param l1_dcache pointer to the beginning of L1 DCACHE
+ * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param coherence the bus of the cores sharing L2 CACHE, NULL for a single core
+ * @param core the core whose level 1 caches are given, among those of the bus
+ * @param replace replacement policy
+ * @param write_policy WRITE_THROUGH or WRITE_BACK
+ * @param prefetch_distance the level 1 set of the access that many
+ *        accesses ahead is prefetched on the host (0: no prefetch)
+ * @param stats (modified) hits, misses, evictions and memory writes of the caches, NULL for none
+ * @return error code
+ */
+int cache_access_batch(void * mem_space,
+                       cache_access_t * accesses,
+                       size_t nb_accesses,
+                       void * l1_icache,
+                       void * l1_dcache,
+                       void * l2_cache,
+                       coherence_t * coherence,
+                       size_t core,
+                       cache_replace_t replace,
+                       cache_write_t write_policy,
+                       size_t prefetch_distance,
+                       sim_stats_t * stats);
+
 //=========================================================================
 /**
  * @brief Print the contents of a cache to a stream.
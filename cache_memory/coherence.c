@@ -0,0 +1,181 @@
+/**
+ * @file coherence.c
+ * @brief MESI coherence between the private level 1 caches of several cores
+ */
+
+#include "coherence.h"
+#include "cache.h"
+#include "cache_mng.h" // for foreach_way
+#include "error.h"
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define L1_CACHES_PER_CORE 2 // ICACHE then DCACHE
+
+// ======================================================================
+int coherence_init(coherence_t* coherence, size_t nb_cores){
+	M_REQUIRE_NON_NULL(coherence);
+	M_REQUIRE(nb_cores > 0, ERR_BAD_PARAMETER, "no core%s", "");
+
+	coherence->nb_cores = nb_cores;
+	coherence->l1_caches = calloc(L1_CACHES_PER_CORE * nb_cores, sizeof(void*));
+	coherence->l1_locks = calloc(nb_cores, sizeof(pthread_mutex_t));
+	coherence->stats = calloc(nb_cores, sizeof(coherence_stats_t));
+	if(coherence->l1_caches == NULL || coherence->l1_locks == NULL || coherence->stats == NULL){
+		free(coherence->l1_caches);
+		free(coherence->l1_locks);
+		free(coherence->stats);
+		coherence->l1_caches = NULL;
+		return ERR_MEM;
+	}
+	pthread_mutex_init(&coherence->bus, NULL);
+	for(size_t core = 0; core < nb_cores; ++core){
+		pthread_mutex_init(&coherence->l1_locks[core], NULL);
+	}
+	return ERR_NONE;
+}
+
+int coherence_attach(coherence_t* coherence, size_t core, void* l1_icache, void* l1_dcache){
+	M_REQUIRE_NON_NULL(coherence);
+	M_REQUIRE_NON_NULL(l1_icache);
+	M_REQUIRE_NON_NULL(l1_dcache);
+	M_REQUIRE(core < coherence->nb_cores, ERR_BAD_PARAMETER, "core %zu of %zu", core, coherence->nb_cores);
+
+	coherence->l1_caches[L1_CACHES_PER_CORE * core] = l1_icache;
+	coherence->l1_caches[L1_CACHES_PER_CORE * core + 1] = l1_dcache;
+	return ERR_NONE;
+}
+
+int coherence_free(coherence_t* coherence){
+	M_REQUIRE_NON_NULL(coherence);
+
+	//its initialization failed
+	if(coherence->l1_caches == NULL){
+		return ERR_NONE;
+	}
+	for(size_t core = 0; core < coherence->nb_cores; ++core){
+		pthread_mutex_destroy(&coherence->l1_locks[core]);
+	}
+	pthread_mutex_destroy(&coherence->bus);
+	free(coherence->l1_caches);
+	free(coherence->l1_locks);
+	free(coherence->stats);
+	coherence->l1_caches = NULL;
+	return ERR_NONE;
+}
+
+// ======================================================================
+//the entry of a line in a level 1 cache (instructions and data share their layout), NULL if absent
+static l1_icache_entry_t* l1_find(void* cache, uint32_t phy_addr){
+	const uint16_t index = (phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES;
+	const uint32_t tag = phy_addr >> L1_ICACHE_TAG_REMAINING_BITS;
+	foreach_way(way, L1_ICACHE_WAYS){
+		if(cache_valid(l1_icache_entry_t, L1_ICACHE_WAYS, index, way) == 1
+			&& cache_tag(l1_icache_entry_t, L1_ICACHE_WAYS, index, way) == tag){
+			return cache_entry(l1_icache_entry_t, L1_ICACHE_WAYS, index, way);
+		}
+	}
+	return NULL;
+}
+
+mesi_state_t coherence_state(void* l1_cache, uint32_t phy_addr){
+	const l1_icache_entry_t* const entry = l1_find(l1_cache, phy_addr);
+	return (entry == NULL) ? MESI_INVALID : (mesi_state_t) entry->state;
+}
+
+//every level 1 cache but the requester's sharing the line, or invalidating it;
+//returns the number of copies found
+static size_t snoop(coherence_t* coherence, size_t core, const void* requester, uint32_t phy_addr, bool write){
+	coherence_stats_t* const stats = &coherence->stats[core];
+	size_t copies = 0;
+	bool transfer = false;
+	for(size_t other = 0; other < coherence->nb_cores; ++other){
+		//the other cache of the requesting core is its own: the bus is enough
+		if(other != core){
+			pthread_mutex_lock(&coherence->l1_locks[other]);
+		}
+		for(size_t i = L1_CACHES_PER_CORE * other; i < L1_CACHES_PER_CORE * (other + 1); ++i){
+			l1_icache_entry_t* const entry = (coherence->l1_caches[i] == requester) ? NULL
+				: l1_find(coherence->l1_caches[i], phy_addr);
+			if(entry == NULL){
+				continue;
+			}
+			++copies;
+			transfer |= (entry->state == MESI_EXCLUSIVE || entry->state == MESI_MODIFIED);
+			if(write){
+				entry->v = 0;
+			}else{
+				entry->state = MESI_SHARED;
+			}
+		}
+		if(other != core){
+			pthread_mutex_unlock(&coherence->l1_locks[other]);
+		}
+	}
+	stats->transfers += transfer;
+	if(write){
+		stats->invalidations += copies;
+	}
+	return copies;
+}
+
+void coherence_read_miss(coherence_t* coherence, size_t core, mem_access_t type, uint32_t phy_addr){
+	void* const requester = coherence->l1_caches[L1_CACHES_PER_CORE * core + (type == DATA)];
+	l1_icache_entry_t* const entry = l1_find(requester, phy_addr);
+	const size_t copies = snoop(coherence, core, requester, phy_addr, false);
+	if(entry != NULL){
+		entry->state = (copies > 0) ? MESI_SHARED : MESI_EXCLUSIVE;
+	}
+}
+
+void coherence_write(coherence_t* coherence, size_t core, void* l2_cache, uint32_t phy_addr, mesi_state_t state){
+	void* const requester = coherence->l1_caches[L1_CACHES_PER_CORE * core + 1];
+	//a Modified or Exclusive line has no other copy
+	if(state != MESI_MODIFIED && state != MESI_EXCLUSIVE){
+		coherence->stats[core].upgrades += (state == MESI_SHARED);
+		snoop(coherence, core, requester, phy_addr, true);
+
+		//nor in level 2, where another core may have evicted its copy
+		void* const cache = l2_cache;
+		const uint16_t index = (phy_addr / L2_CACHE_LINE) % L2_CACHE_LINES;
+		const uint32_t tag = phy_addr >> L2_CACHE_TAG_REMAINING_BITS;
+		foreach_way(way, L2_CACHE_WAYS){
+			if(cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, index, way) == 1
+				&& cache_tag(l2_cache_entry_t, L2_CACHE_WAYS, index, way) == tag){
+				cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, index, way) = 0;
+			}
+		}
+	}
+	l1_icache_entry_t* const entry = l1_find(requester, phy_addr);
+	if(entry != NULL){
+		entry->state = MESI_MODIFIED;
+	}
+}
+
+size_t coherence_write_back(coherence_t* coherence, size_t core, mem_access_t type, void* mem_space, uint32_t phy_addr){
+	const void* const requester = coherence->l1_caches[L1_CACHES_PER_CORE * core + (type == DATA)];
+	uint32_t* const central_mem = mem_space;
+	const uint32_t addr_beginning = (phy_addr - (phy_addr % L1_ICACHE_LINE)) / sizeof(word_t);
+	size_t written = 0;
+	for(size_t other = 0; other < coherence->nb_cores; ++other){
+		//as snoop() does
+		if(other != core){
+			pthread_mutex_lock(&coherence->l1_locks[other]);
+		}
+		for(size_t i = L1_CACHES_PER_CORE * other; i < L1_CACHES_PER_CORE * (other + 1); ++i){
+			l1_icache_entry_t* const entry = (coherence->l1_caches[i] == requester) ? NULL
+				: l1_find(coherence->l1_caches[i], phy_addr);
+			if(entry != NULL && entry->dirty == 1){
+				for(size_t w = 0; w < L1_ICACHE_WORDS_PER_LINE; ++w){
+					central_mem[addr_beginning + w] = entry->line[w];
+				}
+				entry->dirty = 0;
+				++written;
+			}
+		}
+		if(other != core){
+			pthread_mutex_unlock(&coherence->l1_locks[other]);
+		}
+	}
+	return written;
+}
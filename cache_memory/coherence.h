@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ * @file coherence.h
+ * @brief MESI coherence between the private level 1 caches of several cores
+ *
+ * The cores snoop each other on a bus, which is also the lock of the shared
+ * L2 cache and of the memory: every access going beyond level 1 holds it
+ * (see cache_access_batch()), and only then are the level 1 caches of other
+ * cores looked at or changed. Each core locks its own level 1 caches when it
+ * looks a line up in them without the bus, so that a line is never seen
+ * while another core invalidates it.
+ *
+ * Each valid line of a level 1 cache is in one of the states
+ *   - Modified: the only copy, written by its core;
+ *   - Exclusive: the only copy, not written yet;
+ *   - Shared: other level 1 caches may hold it too.
+ * Memory being written through (see cache.h), Modified lines are never
+ * dirty: the state only tells who last wrote them. Written back instead
+ * (WRITE_BACK in cache_mng.h), they are, and only them: before a core misses
+ * a line, another's dirty copy is written back to memory, staying valid
+ * until the miss is snooped.
+ *
+ * A read miss takes the line Exclusive if no other level 1 cache holds it,
+ * Shared otherwise; a Modified or Exclusive copy then becomes Shared, and the
+ * line counts as transferred from cache to cache. A write takes the line
+ * Modified after invalidating every other copy, level 2 included; if it hits
+ * a Shared line, it counts as an upgrade. Instruction caches take part as
+ * readers, so that writes invalidate their copies, even on the writing core.
+ */
+
+#include "mem_access.h" // for mem_access_t
+#include <stdint.h>
+#include <stddef.h> // for size_t
+#include <pthread.h>
+
+typedef enum{
+	MESI_INVALID, MESI_SHARED, MESI_EXCLUSIVE, MESI_MODIFIED
+}mesi_state_t;
+
+typedef struct{
+	uint64_t invalidations; // copies in other level 1 caches, invalidated by writes
+	uint64_t upgrades; // writes hitting a Shared line
+	uint64_t transfers; // misses served by a Modified or Exclusive copy in another level 1 cache
+}coherence_stats_t;
+
+typedef struct{
+	pthread_mutex_t bus; // of the L2 cache and the memory too
+	size_t nb_cores;
+	void** l1_caches; // L1 ICACHE then L1 DCACHE of every core
+	pthread_mutex_t* l1_locks; // of the level 1 caches of every core
+	coherence_stats_t* stats; // of the accesses of every core
+}coherence_t;
+
+//=========================================================================
+/**
+ * @brief Initialize the bus of cores, their counters to 0.
+ * @param coherence (modified) the bus
+ * @param nb_cores number of cores
+ * @return error code
+ */
+int coherence_init(coherence_t* coherence, size_t nb_cores);
+
+//=========================================================================
+/**
+ * @brief Give a core its level 1 caches, empty or holding lines of valid states.
+ * @param coherence the bus
+ * @param core the core
+ * @param l1_icache its L1 ICACHE
+ * @param l1_dcache its L1 DCACHE
+ * @return error code
+ */
+int coherence_attach(coherence_t* coherence, size_t core, void* l1_icache, void* l1_dcache);
+
+//=========================================================================
+/**
+ * @brief Free the bus (not the caches).
+ * @param coherence the bus
+ * @return error code
+ */
+int coherence_free(coherence_t* coherence);
+
+//=========================================================================
+/**
+ * @brief State of a line in a level 1 cache.
+ * @param l1_cache the cache
+ * @param phy_addr a physical address in the line
+ * @return its state, MESI_INVALID if the cache does not hold it
+ */
+mesi_state_t coherence_state(void* l1_cache, uint32_t phy_addr);
+
+//=========================================================================
+/**
+ * @brief Snoop a read miss, once the line has been brought into the level 1
+ * cache of the core. The bus must be held.
+ * @param coherence the bus
+ * @param core the core which missed
+ * @param type whether the line was fetched as instructions or data
+ * @param phy_addr a physical address in the line
+ */
+void coherence_read_miss(coherence_t* coherence, size_t core, mem_access_t type, uint32_t phy_addr);
+
+//=========================================================================
+/**
+ * @brief Snoop a write, once the word has been written into the L1 DCACHE
+ * of the core. The bus must be held.
+ * @param coherence the bus
+ * @param core the core which wrote
+ * @param l2_cache the L2 CACHE, whose copy is invalidated
+ * @param phy_addr a physical address in the line
+ * @param state of the line in the L1 DCACHE of the core before the write
+ */
+void coherence_write(coherence_t* coherence, size_t core, void* l2_cache, uint32_t phy_addr, mesi_state_t state);
+
+//=========================================================================
+/**
+ * @brief Write back the dirty copies of a line in the level 1 caches other
+ * than the one of a core about to miss it, before it reads the line from
+ * level 2 or the memory. The bus must be held.
+ * @param coherence the bus
+ * @param core the core about to miss
+ * @param type whether it misses the line as instructions or data
+ * @param mem_space the memory space
+ * @param phy_addr a physical address in the line
+ * @return the number of lines written back
+ */
+size_t coherence_write_back(coherence_t* coherence, size_t core, mem_access_t type, void* mem_space, uint32_t phy_addr);
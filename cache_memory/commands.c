@@ -1,17 +1,65 @@
+//for pthreads with -std=c11
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h> // for fstat()
 #include "commands.h"
+#include "trace_bin.h"
 #include "error.h"
 #include "addr_mng.h"
 #include "util.h"
 
+//checking that a command is well-formed
+static int command_check(const command_t* command){
+
+	M_REQUIRE(command->order == READ || command->order == WRITE || command->order == SWITCH
+		|| command->order == INVALIDATE, ERR_BAD_PARAMETER,"Order is not correct", command -> order);
+	
+	M_REQUIRE(command->type == INSTRUCTION || command->type == DATA, 
+		ERR_BAD_PARAMETER,"Type is not correct", command -> type);
+		
+	M_REQUIRE(command->data_size == sizeof(byte_t) ||command->data_size == sizeof(word_t), 
+		ERR_BAD_PARAMETER,"Data size is not correct", command -> data_size);	
+	
+
+	if(command -> type == INSTRUCTION ){
+		M_REQUIRE(command->data_size == sizeof(word_t),
+		ERR_BAD_PARAMETER, "Instruction type must have data size 4 not %d ", command->data_size);
+		M_REQUIRE(command -> order == READ, ERR_BAD_PARAMETER, "Instruction type can only be read",command -> order);	
+	}
+	
+	//a context switch writes a whole CR3 and accesses no memory
+	if(command -> order == SWITCH){
+		M_REQUIRE(command->type == DATA && command->data_size == sizeof(word_t), ERR_BAD_PARAMETER,
+			"Context switch must be a data word, not size %zu", command->data_size);
+		M_REQUIRE(virt_addr_t_to_uint64_t(&command->vaddr) == 0, ERR_BAD_PARAMETER,
+			"Context switch has no address%s", "");
+	}
+	if(command -> order == INVALIDATE){
+		M_REQUIRE(command->type == DATA && command->data_size == sizeof(word_t), ERR_BAD_PARAMETER,
+			"Invalidation must be a data word, not size %zu", command->data_size);
+	}
+
+	if(command -> data_size == sizeof(byte_t) && command->order == WRITE){
+		M_REQUIRE(command -> write_data <= UCHAR_MAX, ERR_BAD_PARAMETER, "write data too large for write size", command -> write_data);
+	}
+
+	int rest = command -> vaddr.page_offset  % command -> data_size;
+	M_REQUIRE(rest == 0, ERR_BAD_PARAMETER,
+	 "Incorrect virtual address with offset= %d, data_size = %d", 
+		command -> vaddr.page_offset, command -> data_size );
+
+	return ERR_NONE;
+}
+
 int program_init(program_t* program){
 	M_REQUIRE_NON_NULL(program);
-	M_REQUIRE_NON_NULL(program->listing);
 	
 	//program->listing is allocated for initial size(=10)
 	program->listing = calloc(PROGRAM_INITIAL_SIZE, sizeof(command_t));
@@ -33,6 +81,18 @@ int program_print(FILE* output, const program_t* program){
 	
 	for(int i = 0; i < program->nb_lines; ++i){
 		
+		if(program->listing[i].core != 0){
+			fprintf(output, "C%02" PRIX8 " ", program->listing[i].core);
+		}
+		if(program->listing[i].order == SWITCH){
+			fprintf(output, "S 0x%08" PRIX32 "\n", program->listing[i].write_data);
+			continue;
+		}
+		if(program->listing[i].order == INVALIDATE){
+			fprintf(output, "V 0x%08" PRIX32 " @0x%016" PRIX64 "\n", program->listing[i].write_data,
+				virt_addr_t_to_uint64_t(&(program->listing[i].vaddr)));
+			continue;
+		}
 		if(program->listing[i].order == READ){
 			fprintf(output, "R ");	
 		}
@@ -52,206 +112,493 @@ int program_print(FILE* output, const program_t* program){
 		}	
 		if(program->listing[i].order == WRITE){
 			 if(program->listing[i].data_size == sizeof(word_t)){
-				fprintf(output, "0x%08" PRIX32, program->listing[i].write_data);
+				fprintf(output, "0x%08" PRIX32 " ", program->listing[i].write_data);
 			}
 			else{
-				fprintf(output, "0x%02" PRIX32, program->listing[i].write_data);
+				fprintf(output, "0x%02" PRIX32 " ", program->listing[i].write_data);
 			}
 		}
-		fprintf(output, "@0x%016" PRIX64, virt_addr_t_to_uint64_t(&(program->listing[i].vaddr)));		
-		printf("\n");
+		fprintf(output, "@0x%016" PRIX64 "\n", virt_addr_t_to_uint64_t(&(program->listing[i].vaddr)));
 	}	
 	return ERR_NONE;
 }
 
-int program_read(const char* filename, program_t* program){   
-   
-	M_REQUIRE_NON_NULL(filename);
-	M_REQUIRE_NON_NULL(program);
-	
-	M_EXIT_IF_ERR(program_init(program), "initializing program");
-	
-    FILE *fp = fopen(filename, "r");
-	M_REQUIRE(fp != NULL, ERR_IO, "File not found", filename);
-	
-	bool commands_not_finished = true;
-	
-    while(commands_not_finished && !feof(fp) && !ferror(fp)){
-        char order_char = ' ';
-        if(fscanf(fp, "%c", &order_char) <= 0){
-			commands_not_finished = false;
-        }else{
-        
-		//Local variables to form command
-		command_word_t order;
-		mem_access_t type;
-		size_t data_size = 0;
-		word_t write_data = 0;
-		virt_addr_t vaddr;
-		zero_init_var(vaddr);
-		uint64_t vaddr64 = 0;
-			
-        char mem_access[2];
-            
-        if(order_char == 'W'){
-			order = WRITE;
-        }
-        else if(order_char == 'R'){
-			order = READ;
+//value + 1 of each hexadecimal digit, 0 for any other character
+#define HEX_DIGIT(C, V) [C] = (V) + 1
+static const uint8_t hex_digits[UCHAR_MAX + 1] = {
+	HEX_DIGIT('0', 0x0), HEX_DIGIT('1', 0x1), HEX_DIGIT('2', 0x2), HEX_DIGIT('3', 0x3),
+	HEX_DIGIT('4', 0x4), HEX_DIGIT('5', 0x5), HEX_DIGIT('6', 0x6), HEX_DIGIT('7', 0x7),
+	HEX_DIGIT('8', 0x8), HEX_DIGIT('9', 0x9),
+	HEX_DIGIT('a', 0xa), HEX_DIGIT('b', 0xb), HEX_DIGIT('c', 0xc),
+	HEX_DIGIT('d', 0xd), HEX_DIGIT('e', 0xe), HEX_DIGIT('f', 0xf),
+	HEX_DIGIT('A', 0xA), HEX_DIGIT('B', 0xB), HEX_DIGIT('C', 0xC),
+	HEX_DIGIT('D', 0xD), HEX_DIGIT('E', 0xE), HEX_DIGIT('F', 0xF)
+};
+
+static inline const char* skip_blanks(const char* p, const char* end){
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')){
+		++p;
+	}
+	return p;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HEX8 // parsing 8 hexadecimal digits at once, see hex8()
+
+#define BYTES_OF(B) (UINT64_C(0x0101010101010101) * (B))
+
+//value of the 8 hexadecimal digits from p, UINT64_MAX if one of them is not
+//a digit: each byte is checked then reduced to its nibble in one 64-bit word
+//(SWAR), the first character landing in the lowest byte
+static inline uint64_t hex8(const char* p){
+	uint64_t chars = 0;
+	memcpy(&chars, p, sizeof(chars));
+	if(chars & BYTES_OF(0x80)){
+		return UINT64_MAX;
+	}
+	//digits are left as they are, letters lowered
+	const uint64_t lower = chars | BYTES_OF(0x20);
+	//high bit of each byte set when it is at least lo, resp. at most hi (bytes below 0x80)
+	#define BYTES_IN(X, lo, hi) (((X) + BYTES_OF(0x80 - (lo))) & ~((X) + BYTES_OF(0x7F - (hi))) & BYTES_OF(0x80))
+	const uint64_t digits = BYTES_IN(lower, '0', '9');
+	const uint64_t letters = BYTES_IN(lower, 'a', 'f');
+	#undef BYTES_IN
+	if((digits | letters) != BYTES_OF(0x80)){
+		return UINT64_MAX;
+	}
+	//'a' to 'f' end with 1 to 6
+	uint64_t nibbles = (lower & BYTES_OF(0x0F)) + (letters >> 7) * 9;
+
+	//gathering them two by two, most significant first
+	nibbles = ((nibbles & UINT64_C(0x000F000F000F000F)) << 4) | ((nibbles >> 8) & UINT64_C(0x000F000F000F000F));
+	nibbles = ((nibbles & UINT64_C(0x000000FF000000FF)) << 8) | ((nibbles >> 16) & UINT64_C(0x000000FF000000FF));
+	return ((nibbles & UINT64_C(0xFFFF)) << 16) | ((nibbles >> 32) & UINT64_C(0xFFFF));
+}
+#endif
+
+//parsing an hexadecimal number with optional 0x prefix
+//of at most max_digits (at most 16) significant digits
+//returns the first character after the number, NULL if there is none
+static const char* parse_hex(const char* p, const char* end, uint64_t* value, size_t max_digits){
+	if(end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hex_digits[(unsigned char) p[2]]){
+		p += 2;
+	}
+	const char* const start = p;
+
+	//significant digits are counted from the value: leading zeros keep it 0
+	uint64_t result = 0;
+#ifdef HEX8
+	while(max_digits >= 8 && end - p >= 8 && (result >> (4 * (max_digits - 8))) == 0){
+		const uint64_t digits = hex8(p);
+		if(digits == UINT64_MAX){
+			break;
 		}
-		else{
-			fclose(fp);
-            fprintf(stderr, "Can't read order");
-			return ERR_IO;
-		}     
-        if(fscanf(fp, "%s", mem_access) <= 0){
-            fclose(fp);
-            fprintf(stderr, "Can't read memory access type");
-		    return ERR_IO;
-         }
-
-		if(mem_access[0] == 'I'){
-			type = INSTRUCTION;
-			data_size = sizeof(word_t);
+		result = (result << 32) | digits;
+		p += 8;
+	}
+#endif
+	while(p < end && hex_digits[(unsigned char) *p]){
+		if((result >> (4 * max_digits - 4)) != 0){
+			return NULL;
 		}
-		else if(mem_access[0] == 'D'){
-			type = DATA;
-			
-			if(mem_access[1] == 'W'){
-				data_size = sizeof(word_t);
-			}
-			else if(mem_access[1] == 'B'){
-				data_size = sizeof(byte_t);
-			}
-			else{
-				fclose(fp);
-				fprintf(stderr, "Invalid data size");
-				return ERR_IO;
-				}
-			}
-		else{
-			fclose(fp);
-			fprintf(stderr, "Can't read memory access type");
+		result = (result << 4) | (uint64_t)(hex_digits[(unsigned char) *p] - 1);
+		++p;
+	}
+
+	if(p == start){
+		return NULL;
+	}
+	*value = result;
+	return p;
+}
+
+//parsing one command from a line (without its newline)
+static int command_parse(const char* p, const char* end, command_t* command){
+
+	zero_init_ptr(command);
+
+	//optional core issuing the command: C followed by its number
+	if(p < end && *p == 'C'){
+		uint64_t core64 = 0;
+		p = parse_hex(p + 1, end, &core64, 2 * sizeof(uint8_t));
+		if(p == NULL){
+			fprintf(stderr, "Can't read core");
 			return ERR_IO;
 		}
-								
-        if(order_char == 'W' ){
-            if(fscanf(fp, "%"SCNx32, &write_data) <= 0){
-                 fclose(fp);
-				 fprintf(stderr, "Can't read data to write");
-				 return ERR_IO;
-            }
-                    
+		command->core = (uint8_t) core64;
+		p = skip_blanks(p, end);
+	}
+
+	//context switch: S followed by the new CR3, the rest of the line is ignored
+	if(p < end && *p == 'S'){
+		uint64_t cr3 = 0;
+		if(parse_hex(skip_blanks(p + 1, end), end, &cr3, 2 * sizeof(word_t)) == NULL){
+			fprintf(stderr, "Can't read CR3");
+			return ERR_IO;
 		}
+		command->order = SWITCH;
+		command->type = DATA;
+		command->data_size = sizeof(word_t);
+		command->write_data = (word_t) cr3;
+		return ERR_NONE;
+	}
 
-         char address_char  = ' ';
-         while(address_char == ' ' && !feof(fp) && !ferror(fp)){
-			if(fscanf(fp, "%c", &address_char) <= 0 ){ 
-				fclose(fp);
-				fprintf(stderr, "Can't read virtual address");
-				return ERR_IO;
-							
-			}
+	if(p < end && *p == 'W'){
+		command->order = WRITE;
+	}
+	else if(p < end && *p == 'R'){
+		command->order = READ;
+	}
+	else if(p < end && *p == 'V'){
+		//invalidation: V followed by the number of pages then their address, as a write without type
+		command->order = INVALIDATE;
+		command->type = DATA;
+		command->data_size = sizeof(word_t);
+	}
+	else{
+		fprintf(stderr, "Can't read order");
+		return ERR_IO;
+	}
+	p = skip_blanks(p + 1, end);
+
+	if(command->order == INVALIDATE){
+		//no memory access type
+	}
+	else if(p < end && *p == 'I'){
+		command->type = INSTRUCTION;
+		command->data_size = sizeof(word_t);
+		++p;
+	}
+	else if(end - p >= 2 && p[0] == 'D'){
+		command->type = DATA;
+
+		if(p[1] == 'W'){
+			command->data_size = sizeof(word_t);
 		}
-                                        
-		if(address_char != '@'){ 
-			fclose(fp);
-			fprintf(stderr, "Invalid address beginning, should have start with @");
+		else if(p[1] == 'B'){
+			command->data_size = sizeof(byte_t);
+		}
+		else{
+			fprintf(stderr, "Invalid data size");
 			return ERR_IO;
 		}
-             
-		if(fscanf(fp, "%"SCNx64, &vaddr64) <= 0){
-			fclose(fp);
-			fprintf(stderr, "Can't read virtual address");
-			return ERR_IO;	
-							
+		p += 2;
+	}
+	else{
+		fprintf(stderr, "Can't read memory access type");
+		return ERR_IO;
+	}
+	p = skip_blanks(p, end);
+
+	if(command->order == WRITE || command->order == INVALIDATE){
+		uint64_t write_data = 0;
+		p = parse_hex(p, end, &write_data, 2 * sizeof(word_t));
+		if(p == NULL){
+			fprintf(stderr, "Can't read data to write");
+			return ERR_IO;
 		}
-		
-		char new_line_char  = ' ';
-		
-		while(new_line_char != '\n' && !feof(fp) && !ferror(fp)){
-			if(fscanf(fp, "%c", &new_line_char) <= 0 ){ 
-				fclose(fp);
-				fprintf(stderr, "Can't skip the line");
-				return ERR_IO;
-			}
+		command->write_data = (word_t) write_data;
+		p = skip_blanks(p, end);
+	}
+
+	if(p == end || *p != '@'){
+		fprintf(stderr, "Invalid address beginning, should have start with @");
+		return ERR_IO;
+	}
+
+	uint64_t vaddr64 = 0;
+	if(parse_hex(p + 1, end, &vaddr64, 2 * sizeof(uint64_t)) == NULL){
+		fprintf(stderr, "Can't read virtual address");
+		return ERR_IO;
+	}
+
+	//the rest of the line is ignored
+	M_EXIT_IF_ERR(init_virt_addr64(&command->vaddr, vaddr64), "unable to initialize virtual address");
+
+	return ERR_NONE;
+}
+
+//moving the unparsed bytes to the front of the stream buffer
+//and reading as much as possible from file after them
+static int stream_refill(program_stream_t* stream){
+	const size_t remaining = stream->buf_end - stream->buf_start;
+	memmove(stream->buffer, stream->buffer + stream->buf_start, remaining);
+	stream->buf_start = 0;
+	stream->buf_end = remaining + fread(stream->buffer + remaining, sizeof(char),
+		PROGRAM_STREAM_BUFFER - remaining, stream->file);
+
+	return ferror(stream->file) ? ERR_IO : ERR_NONE;
+}
+
+//reading one command (line) from the stream buffer,
+//refilling the buffer from file when no full line is left
+//returns ERR_EOF when there is no more command to read
+static int command_read_text(program_stream_t* stream, command_t* command){
+
+	const char* new_line = memchr(stream->buffer + stream->buf_start, '\n', stream->buf_end - stream->buf_start);
+
+	if(new_line == NULL && !feof(stream->file)){
+		const size_t remaining = stream->buf_end - stream->buf_start;
+		M_EXIT_IF_ERR(stream_refill(stream), "reading program file");
+
+		new_line = memchr(stream->buffer + remaining, '\n', stream->buf_end - remaining);
+		if(new_line == NULL && stream->buf_end == PROGRAM_STREAM_BUFFER){
+			M_EXIT(ERR_IO, "line too long, more than %d bytes", PROGRAM_STREAM_BUFFER);
+		}
+	}
+
+	if(stream->buf_start == stream->buf_end){
+		return ERR_EOF;
+	}
+
+	//last line may have no newline
+	const char* const line = stream->buffer + stream->buf_start;
+	const char* const line_end = (new_line != NULL) ? new_line : stream->buffer + stream->buf_end;
+	stream->buf_start = (size_t)(line_end - stream->buffer) + (new_line != NULL);
+
+	return command_parse(line, line_end, command);
+}
+
+//decoding one record of a binary trace from the stream buffer (see trace_bin.h)
+static int command_read_bin(program_stream_t* stream, command_t* command){
+
+	if(stream->lines_read == stream->total_lines){
+		return ERR_EOF;
+	}
+
+	size_t size = 0;
+	int err = trace_bin_decode((const uint8_t*) stream->buffer + stream->buf_start,
+		stream->buf_end - stream->buf_start, command, &stream->prev_vaddr, &size);
+
+	if(err == ERR_EOF && !feof(stream->file)){
+		M_EXIT_IF_ERR(stream_refill(stream), "reading program file");
+		err = trace_bin_decode((const uint8_t*) stream->buffer, stream->buf_end,
+			command, &stream->prev_vaddr, &size);
+	}
+	//the header announced more commands than the file contains
+	M_REQUIRE(err != ERR_EOF, ERR_IO, "truncated binary trace after %" PRIu64 " commands", stream->lines_read);
+	M_EXIT_IF_ERR(err, "decoding binary trace");
+
+	stream->buf_start += size;
+	++stream->lines_read;
+	return ERR_NONE;
+}
+
+static inline int command_read(program_stream_t* stream, command_t* command){
+	return stream->binary ? command_read_bin(stream, command) : command_read_text(stream, command);
+}
+
+//"R I @0x" then 16 digits and a newline: the shortest memory access printed by program_print()
+#define PROGRAM_TEXT_LINE 24
+
+//making room for nb_more commands after those of a program, at least
+//doubling its allocation so that appending them one by one stays linear
+static int program_reserve(program_t* program, size_t nb_more){
+	M_REQUIRE(nb_more <= SIZE_MAX / sizeof(command_t) - program->nb_lines, ERR_MEM,
+		"too many commands (%zu more)", nb_more);
+	const size_t needed = program->nb_lines + nb_more;
+	if(needed * sizeof(command_t) <= program->allocated){
+		return ERR_NONE;
+	}
+
+	size_t new_lines = program->allocated / sizeof(command_t) * 2;
+	if(new_lines < needed || new_lines > SIZE_MAX / sizeof(command_t)){
+		new_lines = needed;
+	}
+	command_t* const listing = realloc(program->listing, new_lines * sizeof(command_t));
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(listing, ERR_MEM);
+	program->listing = listing;
+	program->allocated = new_lines * sizeof(command_t);
+	return ERR_NONE;
+}
+
+int program_read(const char* filename, program_t* program){
+
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL(program);
+
+	M_EXIT_IF_ERR(program_init(program), "initializing program");
+
+	program_stream_t stream;
+	M_EXIT_IF_ERR(program_stream_open(filename, &stream, PROGRAM_STREAM_BATCH), "opening program stream");
+
+	//binary traces announce their length: allocating it all at once
+	if(stream.binary && (stream.total_lines > SIZE_MAX
+		|| program_reserve(program, (size_t) stream.total_lines) != ERR_NONE)){
+		program_stream_close(&stream);
+		return ERR_MEM;
+	}
+	//text ones usually have about one command per PROGRAM_TEXT_LINE bytes: reserving
+	//them at once avoids copying the listing while it grows, which it still can
+	struct stat file_stat;
+	if(!stream.binary && fstat(fileno(stream.file), &file_stat) == 0){
+		(void) program_reserve(program, (size_t) file_stat.st_size / PROGRAM_TEXT_LINE);
+	}
+
+	const command_t* batch = NULL;
+	size_t nb_lines = 0;
+
+	do{
+		int err = program_stream_next(&stream, &batch, &nb_lines);
+		if(err != ERR_NONE){
+			program_stream_close(&stream);
+			return err;
 		}
 
-            
-		if(init_virt_addr64(&vaddr, vaddr64) != ERR_NONE){
-			fclose(fp);
-			M_EXIT(ERR_BAD_PARAMETER, "unable to initialize virtual address", vaddr);
+		//adding the newly read commands to program, already checked by the stream
+		if(program_reserve(program, nb_lines) != ERR_NONE){
+			program_stream_close(&stream);
+			M_EXIT(ERR_MEM, "unable to add %zu commands after %zu", nb_lines, program->nb_lines);
 		}
-	
-	
-		//creating new command
-		command_t new_command = {order, type, data_size, write_data, vaddr};
-		
-		
-		//adding the newly created command to program
-		if(program_add_command(program, &new_command) != ERR_NONE){
-			fclose(fp);
-			M_EXIT(ERR_BAD_PARAMETER, "unable to add command", new_command);	
+		memcpy(program->listing + program->nb_lines, batch, nb_lines * sizeof(command_t));
+		program->nb_lines += nb_lines;
+	}while(nb_lines > 0);
+
+	program_stream_close(&stream);
+
+	M_EXIT_IF_ERR(program_shrink(program), "unable to shrink program");
+
+	return ERR_NONE;
+}
+
+//fills one batch of the stream; run by the reader thread so that
+//the next batch is parsed while the caller simulates the current one
+static void* stream_fill(void* arg){
+	program_stream_t* stream = arg;
+	const int fill = 1 - stream->current;
+	command_t* batch = stream->batches[fill];
+
+	size_t nb_lines = 0;
+	int err = ERR_NONE;
+
+	while(nb_lines < stream->capacity && err == ERR_NONE){
+		err = command_read(stream, &batch[nb_lines]);
+		if(err == ERR_NONE){
+			err = command_check(&batch[nb_lines]);
+		}
+		if(err == ERR_NONE){
+			++nb_lines;
 		}
-		
-		}	
 	}
-	
-	if(program_shrink(program) != ERR_NONE){
-		fclose(fp);
-		M_EXIT(ERR_BAD_PARAMETER, "unable to shrink program", program);		
+
+	stream->nb_lines[fill] = nb_lines;
+	stream->err[fill] = (err == ERR_EOF) ? ERR_NONE : err;
+	stream->eof = (err == ERR_EOF);
+	return NULL;
+}
+
+int program_stream_open(const char* filename, program_stream_t* stream, size_t batch_size){
+
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL(stream);
+	M_REQUIRE(batch_size > 0, ERR_BAD_PARAMETER, "batch size must be positive (%zu)", batch_size);
+
+	zero_init_ptr(stream);
+
+	stream->file = fopen(filename, "rb");
+	M_REQUIRE(stream->file != NULL, ERR_IO, "File not found %s", filename);
+
+	stream->capacity = batch_size;
+	stream->batches[0] = calloc(batch_size, sizeof(command_t));
+	stream->batches[1] = calloc(batch_size, sizeof(command_t));
+	stream->buffer = malloc(PROGRAM_STREAM_BUFFER);
+	if(stream->batches[0] == NULL || stream->batches[1] == NULL || stream->buffer == NULL){
+		program_stream_close(stream);
+		return ERR_MEM;
 	}
-	
-	//Closing the file and return
-	fclose(fp);
+
+	//binary traces are recognised from their header, see trace_bin.h
+	if(stream_refill(stream) != ERR_NONE){
+		program_stream_close(stream);
+		return ERR_IO;
+	}
+	if(trace_bin_header_read((const uint8_t*) stream->buffer, stream->buf_end, &stream->total_lines) == ERR_NONE){
+		stream->binary = true;
+		stream->buf_start = TRACE_BIN_HEADER_SIZE;
+	}
+
+	//the first batch is parsed in advance, in batches[0]
+	stream->current = 1;
+	if(pthread_create(&stream->reader, NULL, stream_fill, stream) != 0){
+		program_stream_close(stream);
+		return ERR_MEM;
+	}
+	stream->reading = true;
+
 	return ERR_NONE;
 }
 
+int program_stream_next(program_stream_t* stream, const command_t** batch, size_t* nb_lines){
 
-int program_add_command(program_t* program, const command_t* command){
-	
-	M_REQUIRE_NON_NULL(command);
-	M_REQUIRE_NON_NULL(program);
-	
-	//doubles times allocation in case program's allocated
-	//part is full 
-	if((program -> nb_lines * sizeof(command_t)) == program->allocated){	
-		//buffer check
-		size_t new_allocated = program -> allocated * 2 ; 	
-		if(new_allocated > (SIZE_MAX / sizeof(command_t))){
-			new_allocated = program -> allocated;
+	M_REQUIRE_NON_NULL(stream);
+	M_REQUIRE_NON_NULL(batch);
+	M_REQUIRE_NON_NULL(nb_lines);
+
+	*batch = NULL;
+	*nb_lines = 0;
+
+	if(stream->failed != ERR_NONE){
+		return stream->failed;
+	}
+	if(!stream->reading){
+		//end of file already reached
+		return ERR_NONE;
+	}
+
+	pthread_join(stream->reader, NULL);
+	stream->reading = false;
+
+	stream->current = 1 - stream->current;
+	const int ready = stream->current;
+	stream->failed = stream->err[ready];
+	M_EXIT_IF_ERR(stream->failed, "reading program stream");
+
+	*batch = stream->batches[ready];
+	*nb_lines = stream->nb_lines[ready];
+
+	//starting to parse the following batch while this one is used
+	if(!stream->eof){
+		if(pthread_create(&stream->reader, NULL, stream_fill, stream) != 0){
+			stream->failed = ERR_MEM;
+			M_EXIT(ERR_MEM, "cannot start reader thread for %p", (void*) stream);
 		}
-		program -> allocated = new_allocated;
-		
-		program->listing = realloc(program->listing, program->allocated);
-		M_REQUIRE_NON_NULL(program->listing);
-	} 
-	
-	M_REQUIRE(command->order == READ || command->order == WRITE, 
-		ERR_BAD_PARAMETER,"Order is not correct", command -> order);
-	
-	M_REQUIRE(command->type == INSTRUCTION || command->type == DATA, 
-		ERR_BAD_PARAMETER,"Type is not correct", command -> type);
-		
-	M_REQUIRE(command->data_size == sizeof(byte_t) ||command->data_size == sizeof(word_t), 
-		ERR_BAD_PARAMETER,"Data size is not correct", command -> data_size);	
-	
+		stream->reading = true;
+	}
 
-	if(command -> type == INSTRUCTION ){
-		M_REQUIRE(command->data_size == sizeof(word_t),
-		ERR_BAD_PARAMETER, "Instruction type must have data size 4 not %d ", command->data_size);
-		M_REQUIRE(command -> order == READ, ERR_BAD_PARAMETER, "Instruction type can only be read",command -> order);	
+	return ERR_NONE;
+}
+
+int program_stream_close(program_stream_t* stream){
+	M_REQUIRE_NON_NULL(stream);
+
+	if(stream->reading){
+		pthread_join(stream->reader, NULL);
+		stream->reading = false;
 	}
-	
-	if(command -> data_size == sizeof(byte_t) && command->order == WRITE){
-		M_REQUIRE(command -> write_data <= UCHAR_MAX, ERR_BAD_PARAMETER, "write data too large for write size", command -> write_data);
+	if(stream->file != NULL){
+		fclose(stream->file);
+		stream->file = NULL;
 	}
+	free(stream->batches[0]);
+	free(stream->batches[1]);
+	free(stream->buffer);
+	stream->batches[0] = NULL;
+	stream->batches[1] = NULL;
+	stream->buffer = NULL;
+	stream->capacity = 0;
 
-	int rest = command -> vaddr.page_offset  % command -> data_size;
-	M_REQUIRE(rest == 0, ERR_BAD_PARAMETER,
-	 "Incorrect virtual address with offset= %d, data_size = %d", 
-		command -> vaddr.page_offset, command -> data_size );
+	return ERR_NONE;
+}
+
+
+int program_add_command(program_t* program, const command_t* command){
 	
+	M_REQUIRE_NON_NULL(command);
+	M_REQUIRE_NON_NULL(program);
+	
+	M_EXIT_IF_ERR(command_check(command), "checking command");
+	M_EXIT_IF_ERR(program_reserve(program, 1), "growing program");
+
 	//CASE ALL PARAMETERS ARE CORRECT
 	program -> listing[program -> nb_lines] = *command; 
 	++program -> nb_lines;	 
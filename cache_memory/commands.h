@@ -12,6 +12,8 @@
 #include "addr.h" // for virt_addr_t
 #include <stdio.h> // for size_t, FILE
 #include <stdint.h> // for uint32_t
+#include <stdbool.h>
+#include <pthread.h> // for pthread_t
 
 #define PROGRAM_INITIAL_SIZE 10
 #define MAX_LENGTH 35
@@ -19,11 +21,14 @@
 #define VIRT_ADDR_STR_LENGTH 19
 #define WRITE_DATA_STR_START 2
 #define WRITE_DATA_STR_LENGTH 10
- 
-#define PROGRAM_INITIAL_SIZE 10
+
+#define PROGRAM_STREAM_BATCH 4096 // default number of commands per stream batch
+#define PROGRAM_STREAM_BUFFER (1 << 20) // bytes of file read at once by a stream; bounds line length
 
 typedef enum{
-	READ, WRITE
+	READ, WRITE,
+	SWITCH, // context switch: write_data is the CR3 of the address space to run (see addr.h)
+	INVALIDATE // of the translations of write_data pages from vaddr in the running address space, all if 0
 }command_word_t;
 
 
@@ -32,6 +37,7 @@ typedef struct{
 	mem_access_t type;
 	size_t data_size;
 	word_t write_data;
+	uint8_t core; // issuing it, 0 on a single core
 	virt_addr_t vaddr; 
 }command_t; 
 
@@ -41,6 +47,31 @@ typedef struct{
 	size_t allocated;
 }program_t; 
 
+/**
+ * @brief A program read batch by batch from a file, in constant memory.
+ * While the caller works on one batch, a reader thread parses the next one
+ * into the other buffer.
+ */
+typedef struct{
+	FILE* file;
+	char* buffer; // raw file content, parsed in place
+	size_t buf_start; // first byte not parsed yet
+	size_t buf_end; // end of valid bytes in buffer
+	bool binary; // binary trace, see trace_bin.h
+	uint64_t total_lines; // number of commands announced by a binary trace
+	uint64_t lines_read; // number of commands decoded from a binary trace
+	uint64_t prev_vaddr; // last decoded virtual address of a binary trace
+	command_t* batches[2];
+	size_t nb_lines[2];
+	int err[2];
+	int failed; // error of the first batch that failed, returned by every later call
+	size_t capacity; // number of commands per batch
+	int current; // index of the batch handed to the caller
+	bool eof;
+	bool reading; // reader thread running
+	pthread_t reader;
+}program_stream_t;
+
 /**
  * @brief A useful macro to loop over all program lines.
  * X is the name of the variable to be used for the line;
@@ -100,3 +131,32 @@ int program_read(const char* filename, program_t* program);
  * @return ERR_NONE if ok, appropriate error code otherwise.
  */
 int program_free(program_t* program);
+
+/**
+ * @brief Open a program file for reading it batch by batch.
+ * The first batch starts being parsed in the background right away.
+ * @param filename the name of the file to read from.
+ * @param stream (modified) the stream to be initialized.
+ * @param batch_size maximum number of commands per batch (e.g. PROGRAM_STREAM_BATCH).
+ * @return ERR_NONE if ok, appropriate error code otherwise.
+ */
+int program_stream_open(const char* filename, program_stream_t* stream, size_t batch_size);
+
+/**
+ * @brief Get the next batch of commands of a stream.
+ * The returned batch remains valid until the next call on the same stream.
+ * Commands are checked with the same rules as program_add_command().
+ * Once a batch fails, its error is returned again by every later call.
+ * @param stream the stream to read from.
+ * @param batch (modified) set to the first command of the batch.
+ * @param nb_lines (modified) number of commands in the batch, 0 at end of file.
+ * @return ERR_NONE if ok, appropriate error code otherwise.
+ */
+int program_stream_next(program_stream_t* stream, const command_t** batch, size_t* nb_lines);
+
+/**
+ * @brief Close a stream and free its content.
+ * @param stream the stream to be closed.
+ * @return ERR_NONE if ok, appropriate error code otherwise.
+ */
+int program_stream_close(program_stream_t* stream);
@@ -0,0 +1,133 @@
+/**
+ * @file heatmap.c
+ * @brief per-set and per-physical-page access, miss and eviction counters
+ */
+
+#include "heatmap.h"
+#include "tlb_hrchy.h"
+#include "cache.h"
+#include "addr.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h> // for PRIu64
+
+#define BYTE_BITS 8
+#define HEATMAP_PAGES ((size_t) 1 << PHY_PAGE_NUM)
+#define HEATMAP_BIN_ROW_SIZE (sizeof(uint32_t) + 3 * sizeof(uint64_t))
+
+static const char* const LEVEL_NAMES[STATS_LEVELS] = {
+	"l1_itlb", "l1_dtlb", "l2_tlb", "l1_icache", "l1_dcache", "l2_cache"
+};
+
+static const size_t LEVEL_SETS[STATS_LEVELS] = {
+	L1_ITLB_LINES, L1_DTLB_LINES, L2_TLB_LINES, L1_ICACHE_LINES, L1_DCACHE_LINES, L2_CACHE_LINES
+};
+
+//allocated on the first event of their level; calloc() leaves the pages never accessed untouched
+static heatmap_cell_t* sets[STATS_LEVELS];
+static heatmap_cell_t* pages[STATS_LEVELS];
+
+static inline void count(heatmap_cell_t* cell, heatmap_event_t event){
+	if(event == HEATMAP_EVICTION){
+		++cell->evictions;
+	}else{
+		++cell->accesses;
+		cell->misses += (event == HEATMAP_MISS);
+	}
+}
+
+void heatmap_record(stats_level_t level, uint32_t set, uint32_t page, heatmap_event_t event){
+	if(sets[level] == NULL){
+		sets[level] = calloc(LEVEL_SETS[level], sizeof(heatmap_cell_t));
+		pages[level] = calloc(HEATMAP_PAGES, sizeof(heatmap_cell_t));
+		if(sets[level] == NULL || pages[level] == NULL){
+			free(sets[level]);
+			free(pages[level]);
+			sets[level] = pages[level] = NULL;
+			return;
+		}
+	}
+	count(&sets[level][set % LEVEL_SETS[level]], event);
+	count(&pages[level][page % HEATMAP_PAGES], event);
+}
+
+void heatmap_free(void){
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		free(sets[level]);
+		free(pages[level]);
+		sets[level] = pages[level] = NULL;
+	}
+}
+
+// ======================================================================
+static inline bool is_used(const heatmap_cell_t* cell){
+	return cell->accesses != 0 || cell->evictions != 0;
+}
+
+static void print_rows(FILE* output, size_t level, const char* kind, const heatmap_cell_t* cells, size_t nb_cells){
+	if(cells == NULL){
+		return;
+	}
+	for(size_t i = 0; i < nb_cells; ++i){
+		if(is_used(&cells[i])){
+			fprintf(output, "%s,%s,%zu,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", LEVEL_NAMES[level], kind, i,
+				cells[i].accesses, cells[i].misses, cells[i].evictions);
+		}
+	}
+}
+
+int heatmap_print_csv(FILE* output){
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(output, ERR_IO);
+
+	fputs("level,kind,index,accesses,misses,evictions\n", output);
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		print_rows(output, level, "set", sets[level], LEVEL_SETS[level]);
+		print_rows(output, level, "page", pages[level], HEATMAP_PAGES);
+	}
+	return ferror(output) ? ERR_IO : ERR_NONE;
+}
+
+// ======================================================================
+static inline void put_le(uint8_t* buf, uint64_t value, size_t bytes){
+	for(size_t i = 0; i < bytes; ++i){
+		buf[i] = (uint8_t)(value >> (BYTE_BITS * i));
+	}
+}
+
+static int write_rows(FILE* output, const heatmap_cell_t* cells, size_t nb_cells){
+	uint32_t nb_rows = 0;
+	for(size_t i = 0; cells != NULL && i < nb_cells; ++i){
+		nb_rows += is_used(&cells[i]);
+	}
+	uint8_t buf[HEATMAP_BIN_ROW_SIZE];
+	put_le(buf, nb_rows, sizeof(uint32_t));
+	M_REQUIRE(fwrite(buf, sizeof(uint32_t), 1, output) == 1, ERR_IO, "cannot write %u rows", nb_rows);
+
+	for(size_t i = 0; cells != NULL && i < nb_cells; ++i){
+		if(is_used(&cells[i])){
+			put_le(buf, i, sizeof(uint32_t));
+			put_le(buf + sizeof(uint32_t), cells[i].accesses, sizeof(uint64_t));
+			put_le(buf + sizeof(uint32_t) + sizeof(uint64_t), cells[i].misses, sizeof(uint64_t));
+			put_le(buf + sizeof(uint32_t) + 2 * sizeof(uint64_t), cells[i].evictions, sizeof(uint64_t));
+			M_REQUIRE(fwrite(buf, sizeof(buf), 1, output) == 1, ERR_IO, "cannot write row %zu", i);
+		}
+	}
+	return ERR_NONE;
+}
+
+int heatmap_write_bin(FILE* output){
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(output, ERR_IO);
+
+	uint8_t header[HEATMAP_BIN_MAGIC_SIZE + 2 * sizeof(uint32_t)];
+	memcpy(header, HEATMAP_BIN_MAGIC, HEATMAP_BIN_MAGIC_SIZE);
+	put_le(header + HEATMAP_BIN_MAGIC_SIZE, HEATMAP_BIN_VERSION, sizeof(uint32_t));
+	put_le(header + HEATMAP_BIN_MAGIC_SIZE + sizeof(uint32_t), 0, sizeof(uint32_t));
+	M_REQUIRE(fwrite(header, sizeof(header), 1, output) == 1, ERR_IO, "cannot write header%s", "");
+
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		M_EXIT_IF_ERR(write_rows(output, sets[level], LEVEL_SETS[level]), "writing sets");
+		M_EXIT_IF_ERR(write_rows(output, pages[level], HEATMAP_PAGES), "writing pages");
+	}
+	return ERR_NONE;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * @file heatmap.h
+ * @brief per-set and per-physical-page access, miss and eviction counters
+ *
+ * The hooks (HEATMAP_RECORD()) are placed in cache_hit(), cache_insert(),
+ * tlb_hit() and tlb_insert() of the TLB and cache hierarchies. They are only
+ * compiled in with -DHEATMAP (see the Makefile): otherwise they expand to
+ * nothing and the hot paths are left exactly as they were.
+ *
+ * The binary heatmap is little-endian:
+ *   - HEATMAP_BIN_MAGIC (8 bytes), format version (uint32_t), reserved, 0 (uint32_t)
+ * then, for every level (stats_level_t order), first per set then per page:
+ *   - number of rows (uint32_t)
+ *   - one row per set or page accessed at least once:
+ *     index (uint32_t), accesses, misses, evictions (uint64_t each)
+ */
+
+#include "stats.h" // for stats_level_t
+#include <stdint.h>
+#include <stdio.h> // for FILE
+
+#define HEATMAP_BIN_MAGIC      "PPSHEATM"
+#define HEATMAP_BIN_MAGIC_SIZE 8
+#define HEATMAP_BIN_VERSION    1
+
+typedef enum{
+	HEATMAP_HIT, HEATMAP_MISS, // both are accesses
+	HEATMAP_EVICTION // a valid entry replaced by another one
+}heatmap_event_t;
+
+typedef struct{
+	uint64_t accesses;
+	uint64_t misses;
+	uint64_t evictions;
+}heatmap_cell_t;
+
+#ifdef HEATMAP
+#define HEATMAP_RECORD(level, set, page, event) heatmap_record(level, set, page, event)
+#else
+#define HEATMAP_RECORD(level, set, page, event) do{}while(0)
+#endif
+
+//=========================================================================
+/**
+ * @brief Count an event of a level, at a set and a physical page.
+ * The counters are allocated on the first event of each level;
+ * events are dropped if they cannot be.
+ * @param level the TLB or cache
+ * @param set the line index (TLBs) or set index (caches)
+ * @param page the physical page number
+ * @param event what happened
+ */
+void heatmap_record(stats_level_t level, uint32_t set, uint32_t page, heatmap_event_t event);
+
+//=========================================================================
+/**
+ * @brief Print the heatmap as CSV, one line per set or page accessed at least once.
+ * @param output the stream to print to
+ * @return error code
+ */
+int heatmap_print_csv(FILE* output);
+
+//=========================================================================
+/**
+ * @brief Write the heatmap in the binary format above.
+ * @param output the stream to write to
+ * @return error code
+ */
+int heatmap_write_bin(FILE* output);
+
+//=========================================================================
+/**
+ * @brief Free the counters, which start again from 0.
+ */
+void heatmap_free(void);
@@ -0,0 +1,102 @@
+#include <stdio.h> // for fprintf()
+#include <stdint.h> // for uint16_t
+#include <inttypes.h> // for PRIx macros
+#include "index_list.h"
+#include "error.h"
+
+int is_empty_index_list(const index_list_t* this){
+	M_REQUIRE_NON_NULL(this);
+	return this -> front == INDEX_NONE ? 1 : 0;
+}
+
+void init_index_list(index_list_t* this){
+	if(this == NULL)
+		return;
+
+	this -> front = INDEX_NONE;
+	this -> back = INDEX_NONE;
+	for(size_t i = 0; i < INDEX_LIST_CAPACITY; i++){
+		this -> previous[i] = INDEX_NONE;
+		this -> next[i] = INDEX_NONE;
+	}
+}
+
+//the front is the only value of the list without a previous one
+static inline int in_index_list(const index_list_t* this, uint16_t value){
+	return value == this -> front || this -> previous[value] != INDEX_NONE;
+}
+
+uint16_t index_push_back(index_list_t* this, uint16_t value){
+	if(this == NULL || value >= INDEX_LIST_CAPACITY || in_index_list(this, value)){
+		return INDEX_NONE;
+	}
+
+	this -> next[value] = INDEX_NONE;
+	this -> previous[value] = this -> back;
+	if(this -> back == INDEX_NONE){
+		this -> front = value;
+	}
+	else{
+		this -> next[this -> back] = value;
+	}
+	this -> back = value;
+	return value;
+}
+
+void index_move_back(index_list_t* this, uint16_t value){
+	//case value is back already, there is nothing to be done
+	if(this != NULL && value < INDEX_LIST_CAPACITY && value != this -> back && in_index_list(this, value)){
+		const uint16_t previous = this -> previous[value];
+		const uint16_t next = this -> next[value];
+		if(value == this -> front){
+			this -> front = next;
+		}
+		else{
+			this -> next[previous] = next;
+		}
+		this -> previous[next] = previous;
+
+		this -> next[value] = INDEX_NONE;
+		this -> previous[value] = this -> back;
+		this -> next[this -> back] = value;
+		this -> back = value;
+	}
+}
+
+int print_index_list(FILE* stream, const index_list_t* this){
+	M_REQUIRE_NON_NULL(stream);
+	M_REQUIRE_NON_NULL(this);
+
+	int total = 0;
+	total += fprintf(stream,"(");
+	for_all_indices(X, this){
+		if(X != this -> front){
+			total += fprintf(stream, " ");
+		}
+		total += fprintf(stream, "%" PRIu16, X);
+		if(X != this -> back){
+			total += fprintf(stream, ",");
+		}
+	}
+	total += fprintf(stream, ")");
+	return total;
+}
+
+int print_reverse_index_list(FILE* stream, const index_list_t* this){
+	M_REQUIRE_NON_NULL(stream);
+	M_REQUIRE_NON_NULL(this);
+
+	int total = 0;
+	total += fprintf(stream,"(");
+	for_all_indices_reverse(X, this){
+		if(X != this -> back){
+			total += fprintf(stream, " ");
+		}
+		total += fprintf(stream, "%" PRIu16, X);
+		if(X != this -> front){
+			total += fprintf(stream, ",");
+		}
+	}
+	total += fprintf(stream, ")");
+	return total;
+}
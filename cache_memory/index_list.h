@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * @file index_list.h
+ * @brief Doubly linked lists of small indices, stored in arrays
+ *
+ * Same operations as list.h for lists whose values are distinct indices
+ * below INDEX_LIST_CAPACITY (e.g. the lines of a TLB): each value is its
+ * own node, linked by uint16_t previous/next indices. Nothing is allocated
+ * and a whole list lies in a few hundred contiguous bytes.
+ */
+
+// for some C99 printf flags like %PRI to compile in Windows
+#if defined _WIN32  || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "tlb.h" // for TLB_LINES
+#include <stdio.h> // for fprintf()
+#include <stdint.h> // for uint16_t
+
+#define INDEX_LIST_CAPACITY TLB_LINES
+#define INDEX_NONE ((uint16_t) -1)
+
+/**
+ * @brief Doubly linked list of indices
+ *
+ */
+typedef struct {
+    uint16_t front;
+    uint16_t back;
+    uint16_t previous[INDEX_LIST_CAPACITY]; // INDEX_NONE for the front and for values not in the list
+    uint16_t next[INDEX_LIST_CAPACITY]; // INDEX_NONE for the back
+} index_list_t;
+
+/**
+ * @brief check whether the list is empty or not
+ * @param this list to check
+ * @return 0 if the list is (well-formed and) not empty
+ */
+int is_empty_index_list(const index_list_t* this);
+
+/**
+ * @brief initialize a list to the empty list
+ * @param this list to initialize
+ */
+void init_index_list(index_list_t* this);
+
+/**
+ * @brief add a new value at the end of the list
+ * @param this list where to add to
+ * @param value value to be added, below INDEX_LIST_CAPACITY and not already in the list
+ * @return value, or INDEX_NONE in case of error
+ */
+uint16_t index_push_back(index_list_t* this, uint16_t value);
+
+/**
+ * @brief move a value of the list to its end
+ * @param this list to modify
+ * @param value value to be moved (nothing is done if it is not in the list)
+ */
+void index_move_back(index_list_t* this, uint16_t value);
+
+/**
+ * @brief print a list, as print_list() does
+ * @param stream where to print to
+ * @param this the list to print
+ * @return number of printed characters
+ */
+int print_index_list(FILE* stream, const index_list_t* this);
+
+/**
+ * @brief print a list in reverse order, as print_reverse_list() does
+ * @param stream where to print to
+ * @param this the list to print
+ * @return number of printed characters
+ */
+int print_reverse_index_list(FILE* stream, const index_list_t* this);
+
+#define for_all_indices(X, L)         for (uint16_t X = (L)->front; X != INDEX_NONE; X = (L)->next[X]    )
+#define for_all_indices_reverse(X, L) for (uint16_t X = (L)->back ; X != INDEX_NONE; X = (L)->previous[X])
@@ -10,6 +10,9 @@
 #define __USE_MINGW_ANSI_STDIO 1
 #endif
 
+// for mmap(), open() and fstat() with -std=c11
+#define _POSIX_C_SOURCE 200809L
+
 #define STR(X) #X
 #define INPUT_LIM(X) "%" STR(X) "s"
 //macro in order to limit fscanf to MAX_STR_LENGTH 
@@ -28,6 +31,10 @@
 #include <assert.h>
 #include "addr.h"
 #include <stdbool.h>
+#include <sys/mman.h> // for mmap()
+#include <sys/stat.h> // for fstat()
+#include <fcntl.h>    // for open()
+#include <unistd.h>   // for close()
 
 //opening file and doing checks
 //getting the capacity as suggested in instructions
@@ -75,6 +82,55 @@ int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capa
 	
 }
 
+//mapping the dump file privately: pages are only faulted in when touched
+//and writes (e.g. from cache_write) stay copy-on-write, never reaching the file
+int mem_init_from_dumpfile_mmap(const char* filename, void** memory, size_t* mem_capacity_in_bytes){
+
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(filename, ERR_IO);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(memory, ERR_MEM);
+	M_REQUIRE_NON_NULL(mem_capacity_in_bytes);
+
+	*memory = NULL;
+
+	int fd = open(filename, O_RDONLY);
+	M_REQUIRE(fd >= 0, ERR_IO, "cannot open %s", filename);
+
+	struct stat file_stat;
+	if(fstat(fd, &file_stat) != 0){
+		close(fd);
+		return ERR_IO;
+	}
+
+	*mem_capacity_in_bytes = (size_t) file_stat.st_size;
+
+	if(*mem_capacity_in_bytes == 0 || (*mem_capacity_in_bytes) % PAGE_SIZE != 0){
+		close(fd);
+		M_EXIT(ERR_BAD_PARAMETER, "mem_capacity_in_bytes must be a non-zero multiple of PAGE_SIZE (%zu)",
+			*mem_capacity_in_bytes);
+	}
+
+	void* mapped = mmap(NULL, *mem_capacity_in_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	//the mapping keeps its own reference on the file
+	close(fd);
+
+	if(mapped == MAP_FAILED){
+		return ERR_MEM;
+	}
+
+	*memory = mapped;
+	return ERR_NONE;
+}
+
+int mem_release_mmap(void* memory, size_t mem_capacity_in_bytes){
+
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(memory, ERR_MEM);
+
+	M_REQUIRE(munmap(memory, mem_capacity_in_bytes) == 0, ERR_MEM,
+		"cannot unmap %zu bytes", mem_capacity_in_bytes);
+
+	return ERR_NONE;
+}
+
 //helper function in order to use 
 //each time we need to transfer data from binary file into 
 //memory as translation pages 
@@ -46,6 +46,34 @@ typedef enum addr_fmt addr_fmt_t;
 int mem_init_from_dumpfile(const char* filename, void** memory, size_t* mem_capacity_in_bytes);
 
 
+/**
+ * @brief Map the whole memory space from a provided (binary) dump file,
+ * without copying it. The mapping is private: pages are only read from the
+ * file when first touched, and writes (e.g. cache_write()) are copy-on-write,
+ * so the dump file is never modified.
+ * A memory created this way must be released with mem_release_mmap(), not free().
+ *
+ * @param filename the name of the memory dump file to map
+ * @param memory (modified) pointer to the begining of the memory
+ * @param mem_capacity_in_bytes (modified) total size of the mapped memory
+ * @return error code, *p_memory shall be NULL in case of error
+ *
+ */
+
+int mem_init_from_dumpfile_mmap(const char* filename, void** memory, size_t* mem_capacity_in_bytes);
+
+/**
+ * @brief Release a memory space created by mem_init_from_dumpfile_mmap().
+ *
+ * @param memory pointer to the begining of the memory
+ * @param mem_capacity_in_bytes total size of the memory, as returned at creation
+ * @return error code
+ *
+ */
+
+int mem_release_mmap(void* memory, size_t mem_capacity_in_bytes);
+
+
 /**
  * @brief Create and initialize the whole memory space from a provided
  * (metadata text) file containing an description of the memory.
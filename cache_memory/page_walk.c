@@ -1,6 +1,9 @@
 #include "page_walk.h"
 #include "addr_mng.h"
 #include "error.h"
+#include <string.h> // for memset()
+#include <stdbool.h>
+#include <inttypes.h> // for PRIx32
 
 
 //in order to get to correct place in memory
@@ -10,12 +13,26 @@ static inline pte_t read_page_entry(const pte_t * start,pte_t page_start,
 uint16_t index){
 	 M_REQUIRE_NON_NULL(start);
 	
-	 uint16_t i = (page_start/sizeof(pte_t)) +   index ;
+	 //page tables may lie anywhere in memory (see CR3_PGD())
+	 const size_t i = (size_t) (page_start/sizeof(pte_t)) +   index ;
 
 	 return start[i]; 
 	
 }
 
+int page_walk_check_cr3(uint32_t cr3, size_t mem_size){
+	M_REQUIRE((size_t) CR3_PGD(cr3) + PAGE_SIZE <= mem_size, ERR_ADDR,
+	          "PGD at 0x%" PRIx32 " out of %zu bytes of memory", (uint32_t) CR3_PGD(cr3), mem_size);
+	return ERR_NONE;
+}
+
+//physical address within a huge page, from its PUD (1 GiB) or PMD (2 MiB) entry
+static inline int huge_page_addr(pte_t entry, page_size_t size, const virt_addr_t* vaddr, phy_addr_t* paddr){
+	const uint32_t pages_in = (size == PAGE_1G) ? ((uint32_t) vaddr->pmd_entry << PTE_ENTRY) | vaddr->pte_entry
+		: vaddr->pte_entry;
+	return init_phy_addr(paddr, (entry & PTE_ADDR_MASK) + (pages_in << PAGE_OFFSET), vaddr->page_offset);
+}
+
 //as indicated in instructions we are walking 
 //through translation pages in order to get physical address
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr){
@@ -34,11 +51,144 @@ int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr
 	addressPUD = read_page_entry(mem_space, 0, vaddr->pgd_entry);
 	
 	addressPMD = read_page_entry(mem_space, addressPUD , vaddr->pud_entry);
+	if(addressPMD & PTE_HUGE){
+		return huge_page_addr(addressPMD, PAGE_1G, vaddr, paddr);
+	}
 	
 	addressPT = read_page_entry(mem_space, addressPMD , vaddr->pmd_entry);
+	if(addressPT & PTE_HUGE){
+		return huge_page_addr(addressPT, PAGE_2M, vaddr, paddr);
+	}
 	
 	tempPhyAdd = read_page_entry(mem_space, addressPT , vaddr->pte_entry );
 	
 	return init_phy_addr(paddr, tempPhyAdd, vaddr->page_offset);
 		
 }
+
+// ======================================================================
+int page_walk_cache_flush(page_walk_cache_t* pwc){
+	M_REQUIRE_NON_NULL(pwc);
+	memset(pwc, 0, sizeof(*pwc));
+	return ERR_NONE;
+}
+
+int page_walk_cache_invalidate(page_walk_cache_t* pwc){
+	M_REQUIRE_NON_NULL(pwc);
+	memset(pwc->pgd, 0, sizeof(pwc->pgd));
+	memset(pwc->pud, 0, sizeof(pwc->pud));
+	memset(pwc->pmd, 0, sizeof(pwc->pmd));
+	return ERR_NONE;
+}
+
+static inline void pwc_invalidate_asid(pwc_entry_t* entries, size_t nb_entries, uint16_t asid){
+	for(size_t i = 0; i < nb_entries; ++i){
+		if(entries[i].asid == asid){
+			entries[i].v = 0;
+		}
+	}
+}
+
+int page_walk_cache_invalidate_asid(page_walk_cache_t* pwc, uint16_t asid){
+	M_REQUIRE_NON_NULL(pwc);
+	pwc_invalidate_asid(pwc->pgd, PWC_PGD_ENTRIES, asid);
+	pwc_invalidate_asid(pwc->pud, PWC_PUD_ENTRIES, asid);
+	pwc_invalidate_asid(pwc->pmd, PWC_PMD_ENTRIES, asid);
+	return ERR_NONE;
+}
+
+//entry of a level cache for a key, hit or not;
+//the ASID is hashed into the index, as in the TLBs
+static inline pwc_entry_t* pwc_entry(pwc_entry_t* entries, size_t nb_entries, uint64_t key, uint16_t asid){
+	return &entries[(key ^ ASID_HASH(asid)) % nb_entries];
+}
+
+static inline bool pwc_hit(page_walk_cache_t* pwc, pwc_level_t level, const pwc_entry_t* entry, uint64_t key){
+	const bool hit = entry->v == 1 && entry->tag == key;
+	pwc->hits[level] += hit;
+	pwc->misses[level] += !hit;
+	return hit;
+}
+
+static inline void pwc_fill(pwc_entry_t* entry, uint64_t key, pte_t next, uint16_t asid){
+	entry->tag = key;
+	entry->next = next;
+	entry->asid = asid;
+	entry->v = 1;
+}
+
+int page_walk_cached(const void* mem_space, uint32_t cr3, const virt_addr_t* vaddr, phy_addr_t* paddr,
+                     page_walk_cache_t* pwc, page_size_t* page_size){
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(vaddr, ERR_BAD_PARAMETER);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(paddr, ERR_BAD_PARAMETER);
+
+	page_size_t size_found = PAGE_4K;
+	if(page_size == NULL){
+		page_size = &size_found;
+	}
+	*page_size = PAGE_4K;
+	if(pwc == NULL){
+		//same walk as page_walk(), telling the size of the page
+		const pte_t addressPUD = read_page_entry(mem_space, CR3_PGD(cr3), vaddr->pgd_entry);
+		const pte_t addressPMD = read_page_entry(mem_space, addressPUD, vaddr->pud_entry);
+		if(addressPMD & PTE_HUGE){
+			*page_size = PAGE_1G;
+			return huge_page_addr(addressPMD, PAGE_1G, vaddr, paddr);
+		}
+		const pte_t addressPT = read_page_entry(mem_space, addressPMD, vaddr->pmd_entry);
+		if(addressPT & PTE_HUGE){
+			*page_size = PAGE_2M;
+			return huge_page_addr(addressPT, PAGE_2M, vaddr, paddr);
+		}
+		return init_phy_addr(paddr, read_page_entry(mem_space, addressPT, vaddr->pte_entry), vaddr->page_offset);
+	}
+
+	//the keys are the ASID then the virtual page number bits above each level
+	const uint64_t pgd_key = ((uint64_t) CR3_ASID(cr3) << PGD_ENTRY) | vaddr->pgd_entry;
+	const uint64_t pud_key = (pgd_key << PUD_ENTRY) | vaddr->pud_entry;
+	const uint64_t pmd_key = (pud_key << PMD_ENTRY) | vaddr->pmd_entry;
+	const uint16_t asid = CR3_ASID(cr3);
+	pwc_entry_t* const pmd_cached = pwc_entry(pwc->pmd, PWC_PMD_ENTRIES, pmd_key, asid);
+	++pwc->walks;
+
+	pte_t addressPT = 0;
+	if(pwc_hit(pwc, PWC_PMD, pmd_cached, pmd_key)){
+		addressPT = pmd_cached->next;
+	}else{
+		pwc_entry_t* const pud_cached = pwc_entry(pwc->pud, PWC_PUD_ENTRIES, pud_key, asid);
+		pte_t addressPMD = 0;
+		if(pwc_hit(pwc, PWC_PUD, pud_cached, pud_key)){
+			addressPMD = pud_cached->next;
+		}else{
+			pwc_entry_t* const pgd_cached = pwc_entry(pwc->pgd, PWC_PGD_ENTRIES, pgd_key, asid);
+			pte_t addressPUD = 0;
+			if(pwc_hit(pwc, PWC_PGD, pgd_cached, pgd_key)){
+				addressPUD = pgd_cached->next;
+			}else{
+				addressPUD = read_page_entry(mem_space, CR3_PGD(cr3), vaddr->pgd_entry);
+				++pwc->loads;
+				pwc_fill(pgd_cached, pgd_key, addressPUD, asid);
+			}
+			addressPMD = read_page_entry(mem_space, addressPUD, vaddr->pud_entry);
+			++pwc->loads;
+			//huge pages are left to the TLBs: only tables are cached
+			if(addressPMD & PTE_HUGE){
+				*page_size = PAGE_1G;
+				return huge_page_addr(addressPMD, PAGE_1G, vaddr, paddr);
+			}
+			pwc_fill(pud_cached, pud_key, addressPMD, asid);
+		}
+		addressPT = read_page_entry(mem_space, addressPMD, vaddr->pmd_entry);
+		++pwc->loads;
+		if(addressPT & PTE_HUGE){
+			*page_size = PAGE_2M;
+			return huge_page_addr(addressPT, PAGE_2M, vaddr, paddr);
+		}
+		pwc_fill(pmd_cached, pmd_key, addressPT, asid);
+	}
+
+	const uint32_t tempPhyAdd = read_page_entry(mem_space, addressPT, vaddr->pte_entry);
+	++pwc->loads;
+	return init_phy_addr(paddr, tempPhyAdd, vaddr->page_offset);
+}
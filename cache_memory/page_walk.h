@@ -9,9 +9,13 @@
  */
 
 #include "addr.h"
+#include <stdint.h>
+#include <stddef.h> // for size_t
 
 /**
- * @brief Page walker: virtual address to physical address conversion.
+ * @brief Page walker: virtual address to physical address conversion,
+ * in the address space of CR3 0 (see addr.h).
+ * The walk stops at a PUD or PMD entry with PTE_HUGE set (see addr.h).
  *
  * @param mem_space starting address of our simulated memory space
  * @param vaddr virtual address to be converted
@@ -19,3 +23,85 @@
  * @return error code
  */
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr);
+
+//=========================================================================
+/**
+ * @brief Check that the PGD of an address space lies in memory, before walking it.
+ *
+ * @param cr3 root of the address space (see addr.h)
+ * @param mem_size size in bytes of our simulated memory space
+ * @return error code, ERR_ADDR if the PGD is (partly) out of memory
+ */
+int page_walk_check_cr3(uint32_t cr3, size_t mem_size);
+
+// paging-structure caches: entries of the upper levels, direct-mapped and
+// tagged with the ASID and the virtual page number bits above their level
+#define PWC_PGD_ENTRIES 4  // addresses of PUDs, one per 512 GiB region
+#define PWC_PUD_ENTRIES 4  // addresses of PMDs, one per 1 GiB region
+#define PWC_PMD_ENTRIES 32 // addresses of page tables, one per 2 MiB region
+
+typedef enum{ PWC_PGD, PWC_PUD, PWC_PMD, PWC_LEVELS }pwc_level_t;
+
+typedef struct{
+	uint64_t tag;
+	pte_t next; // address of the table of the next level
+	uint16_t asid;
+	uint8_t v;
+}pwc_entry_t;
+
+/**
+ * Looked up from the deepest level: on a hit, the walk starts from the
+ * table it gives, the levels above are not looked up.
+ */
+typedef struct{
+	pwc_entry_t pgd[PWC_PGD_ENTRIES];
+	pwc_entry_t pud[PWC_PUD_ENTRIES];
+	pwc_entry_t pmd[PWC_PMD_ENTRIES];
+	uint64_t hits[PWC_LEVELS];
+	uint64_t misses[PWC_LEVELS];
+	uint64_t walks;
+	uint64_t loads; // page table entries read from memory
+}page_walk_cache_t;
+
+//=========================================================================
+/**
+ * @brief Invalidate all the entries of paging-structure caches and reset their
+ * statistics (to be done whenever the page tables they cached change).
+ * @param pwc the caches
+ * @return error code
+ */
+int page_walk_cache_flush(page_walk_cache_t* pwc);
+
+//=========================================================================
+/**
+ * @brief Invalidate all the entries of paging-structure caches, keeping their
+ * statistics (as a context switch without ASIDs does).
+ * @param pwc the caches
+ * @return error code
+ */
+int page_walk_cache_invalidate(page_walk_cache_t* pwc);
+
+//=========================================================================
+/**
+ * @brief Invalidate the entries of paging-structure caches of one address space,
+ * keeping their statistics (as any TLB invalidation in it does, see INVLPG).
+ * @param pwc the caches
+ * @param asid the ASID of the address space
+ * @return error code
+ */
+int page_walk_cache_invalidate_asid(page_walk_cache_t* pwc, uint16_t asid);
+
+//=========================================================================
+/**
+ * @brief Same as page_walk() in any address space, skipping the levels whose
+ * entry is cached. Entries mapping huge pages are not cached.
+ * @param mem_space starting address of our simulated memory space
+ * @param cr3 root of the address space of vaddr (see addr.h)
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param pwc (modified) paging-structure caches of mem_space, NULL to walk through every level
+ * @param page_size (SET) size of the page mapping vaddr, may be NULL
+ * @return error code
+ */
+int page_walk_cached(const void* mem_space, uint32_t cr3, const virt_addr_t* vaddr, phy_addr_t* paddr,
+                     page_walk_cache_t* pwc, page_size_t* page_size);
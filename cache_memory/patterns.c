@@ -0,0 +1,214 @@
+/**
+ * @file patterns.c
+ * @brief synthetic memory spaces and access patterns, for benchmarks
+ */
+
+#include "patterns.h"
+#include "addr.h"
+#include "addr_mng.h"
+#include "cache.h"
+#include "error.h"
+#include <stdlib.h>
+#include <math.h>
+
+#define FIRST_PAGE_TABLE 3 // after the PGD, the PUD and the PMD
+#define MIXED_CODE_FRACTION 8 // of the footprint
+#define MIXED_PERIOD 5 // accesses, the first ones being instructions
+#define MIXED_FETCHES 3
+#define MIXED_WRITE_ONE_IN 3 // data accesses
+
+static const char* const PATTERN_NAMES[NB_PATTERNS] = {
+	"sequential", "strided", "uniform", "zipf", "pointer_chase", "mixed"
+};
+
+const char* pattern_name(pattern_t pattern){
+	return (pattern < NB_PATTERNS) ? PATTERN_NAMES[pattern] : "?";
+}
+
+//deterministic pseudo-random numbers (xorshift)
+static uint32_t next_random(uint32_t* state){
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+//random permutation of 0 to size - 1 (Fisher-Yates), or a single cycle through them (Sattolo)
+static void shuffle(uint32_t* values, size_t size, uint32_t* state, bool cycle){
+	for(size_t i = 0; i < size; ++i){
+		values[i] = (uint32_t) i;
+	}
+	for(size_t i = size; i > 1; --i){
+		const size_t j = next_random(state) % (cycle ? i - 1 : i);
+		const uint32_t value = values[i - 1];
+		values[i - 1] = values[j];
+		values[j] = value;
+	}
+}
+
+// ======================================================================
+int pattern_memory_init(void** mem_space, size_t* mem_size, size_t nb_pages, page_size_t page_size, uint32_t seed){
+	M_REQUIRE_NON_NULL(mem_space);
+	M_REQUIRE_NON_NULL(mem_size);
+	M_REQUIRE(nb_pages > 0 && nb_pages <= PATTERN_MAX_PAGES, ERR_BAD_PARAMETER,
+		"%zu pages cannot be mapped", nb_pages);
+	M_REQUIRE(page_size == PAGE_4K || (page_size == PAGE_2M && nb_pages % PD_ENTRIES == 0), ERR_BAD_PARAMETER,
+		"%zu pages cannot be mapped by pages of size %d", nb_pages, page_size);
+
+	//4 kiB pages need page tables; 2 MiB ones are mapped by the PMD itself,
+	//and must be aligned: the data starts at the second 2 MiB
+	const size_t pages_per_mapping = (size_t) 1 << PAGE_SIZE_SHIFT(page_size);
+	const size_t nb_mappings = nb_pages / pages_per_mapping;
+	const size_t nb_page_tables = (page_size == PAGE_4K) ? (nb_pages + PD_ENTRIES - 1) / PD_ENTRIES : 0;
+	const size_t first_data_page = (page_size == PAGE_4K) ? FIRST_PAGE_TABLE + nb_page_tables : PD_ENTRIES;
+	uint32_t* const physical_pages = calloc(nb_mappings, sizeof(uint32_t));
+	pte_t* const memory = calloc(first_data_page + nb_pages, PAGE_SIZE);
+	if(physical_pages == NULL || memory == NULL){
+		free(physical_pages);
+		free(memory);
+		return ERR_MEM;
+	}
+	uint32_t state = seed;
+	shuffle(physical_pages, nb_mappings, &state, false);
+
+	const size_t entries_per_page = PAGE_SIZE / sizeof(pte_t);
+	memory[0] = 1 * PAGE_SIZE; // PGD -> PUD
+	memory[entries_per_page] = 2 * PAGE_SIZE; // PUD -> PMD
+	for(size_t table = 0; table < nb_page_tables; ++table){
+		memory[2 * entries_per_page + table] = (pte_t) ((FIRST_PAGE_TABLE + table) * PAGE_SIZE);
+	}
+	const size_t first_mapping_entry = (page_size == PAGE_4K) ? FIRST_PAGE_TABLE * entries_per_page : 2 * entries_per_page;
+	const pte_t flags = (page_size == PAGE_4K) ? 0 : PTE_HUGE;
+	for(size_t mapping = 0; mapping < nb_mappings; ++mapping){
+		memory[first_mapping_entry + mapping] =
+			(pte_t) ((first_data_page + physical_pages[mapping] * pages_per_mapping) * PAGE_SIZE) | flags;
+	}
+	//data words are their own physical address, so that reads can be checked
+	for(size_t word = first_data_page * entries_per_page; word < (first_data_page + nb_pages) * entries_per_page; ++word){
+		memory[word] = (pte_t) (word * sizeof(pte_t));
+	}
+
+	free(physical_pages);
+	*mem_space = memory;
+	*mem_size = (first_data_page + nb_pages) * PAGE_SIZE;
+	return ERR_NONE;
+}
+
+// ======================================================================
+//popularity ranks to pages, inverting the cumulated Zipfian distribution
+static int generate_zipf(command_t* commands, size_t nb_commands, size_t nb_pages, uint32_t* state){
+	double* const cumulated = calloc(nb_pages, sizeof(double));
+	uint32_t* const pages = calloc(nb_pages, sizeof(uint32_t));
+	if(cumulated == NULL || pages == NULL){
+		free(cumulated);
+		free(pages);
+		return ERR_MEM;
+	}
+	double sum = 0;
+	for(size_t rank = 0; rank < nb_pages; ++rank){
+		sum += 1.0 / pow((double) (rank + 1), PATTERN_ZIPF_EXPONENT);
+		cumulated[rank] = sum;
+	}
+	//the most popular pages are not next to each other
+	shuffle(pages, nb_pages, state, false);
+
+	int err = ERR_NONE;
+	for(size_t i = 0; err == ERR_NONE && i < nb_commands; ++i){
+		const double target = sum * ((double) next_random(state) / (double) UINT32_MAX);
+		size_t low = 0;
+		size_t high = nb_pages - 1;
+		while(low < high){
+			const size_t middle = (low + high) / 2;
+			if(cumulated[middle] < target) low = middle + 1;
+			else high = middle;
+		}
+		const uint64_t offset = (next_random(state) % (PAGE_SIZE / sizeof(word_t))) * sizeof(word_t);
+		err = init_virt_addr64(&commands[i].vaddr, (uint64_t) pages[low] * PAGE_SIZE + offset);
+	}
+	free(cumulated);
+	free(pages);
+	return err;
+}
+
+static int generate_pointer_chase(command_t* commands, size_t nb_commands, size_t nb_pages, uint32_t* state){
+	const size_t nb_lines = nb_pages * (PAGE_SIZE / L1_ICACHE_LINE);
+	uint32_t* const next = calloc(nb_lines, sizeof(uint32_t));
+	if(next == NULL){
+		return ERR_MEM;
+	}
+	shuffle(next, nb_lines, state, true);
+	uint32_t line = 0;
+	int err = ERR_NONE;
+	for(size_t i = 0; err == ERR_NONE && i < nb_commands; ++i){
+		line = next[line];
+		err = init_virt_addr64(&commands[i].vaddr, (uint64_t) line * L1_ICACHE_LINE);
+	}
+	free(next);
+	return err;
+}
+
+static int generate_mixed(command_t* commands, size_t nb_commands, size_t nb_pages, uint32_t* state){
+	const uint64_t code_words = nb_pages * PAGE_SIZE / sizeof(word_t) / MIXED_CODE_FRACTION;
+	const uint64_t data_words = nb_pages * PAGE_SIZE / sizeof(word_t) - code_words;
+	uint64_t pc = 0;
+	size_t fetches = 0;
+	size_t data_accesses = 0;
+	for(size_t i = 0; i < nb_commands; ++i){
+		uint64_t word = 0;
+		if(i % MIXED_PERIOD < MIXED_FETCHES){
+			if(++fetches % PATTERN_MIXED_BLOCK == 0){
+				pc = next_random(state) % code_words;
+			}
+			word = pc;
+			pc = (pc + 1) % code_words;
+			commands[i].type = INSTRUCTION;
+		}else{
+			word = code_words + next_random(state) % data_words;
+			if(++data_accesses % MIXED_WRITE_ONE_IN == 0){
+				commands[i].order = WRITE;
+				commands[i].write_data = next_random(state);
+			}
+		}
+		M_EXIT_IF_ERR(init_virt_addr64(&commands[i].vaddr, word * sizeof(word_t)), "mixed address");
+	}
+	return ERR_NONE;
+}
+
+int pattern_generate(command_t* commands, size_t nb_commands, pattern_t pattern, size_t nb_pages, uint32_t seed){
+	M_REQUIRE_NON_NULL(commands);
+	M_REQUIRE(pattern < NB_PATTERNS, ERR_BAD_PARAMETER, "unknown pattern %d", pattern);
+	M_REQUIRE(nb_pages > 0 && nb_pages <= PATTERN_MAX_PAGES, ERR_BAD_PARAMETER,
+		"%zu pages cannot be mapped", nb_pages);
+
+	for(size_t i = 0; i < nb_commands; ++i){
+		commands[i].order = READ;
+		commands[i].type = DATA;
+		commands[i].data_size = sizeof(word_t);
+		commands[i].write_data = 0;
+	}
+
+	const uint64_t footprint = nb_pages * PAGE_SIZE;
+	uint32_t state = seed;
+	switch(pattern){
+	case PATTERN_ZIPF:
+		return generate_zipf(commands, nb_commands, nb_pages, &state);
+	case PATTERN_POINTER_CHASE:
+		return generate_pointer_chase(commands, nb_commands, nb_pages, &state);
+	case PATTERN_MIXED:
+		return generate_mixed(commands, nb_commands, nb_pages, &state);
+	default:
+		break;
+	}
+	for(size_t i = 0; i < nb_commands; ++i){
+		uint64_t vaddr64 = 0;
+		if(pattern == PATTERN_SEQUENTIAL){
+			vaddr64 = (i * sizeof(word_t)) % footprint;
+		}else if(pattern == PATTERN_STRIDED){
+			vaddr64 = (i * PATTERN_STRIDE) % footprint;
+		}else{
+			vaddr64 = (next_random(&state) % (footprint / sizeof(word_t))) * sizeof(word_t);
+		}
+		M_EXIT_IF_ERR(init_virt_addr64(&commands[i].vaddr, vaddr64), "generated address");
+	}
+	return ERR_NONE;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * @file patterns.h
+ * @brief synthetic memory spaces and access patterns, for benchmarks
+ *
+ * A synthetic memory space maps the virtual pages 0 to nb_pages - 1 (through
+ * a single PGD, PUD and PMD, then as many page tables as needed) onto shuffled
+ * physical pages, so that every address generated below translates through
+ * page_walk(). Virtual addresses are then simply byte offsets in the first
+ * nb_pages pages. With 2 MiB pages, the PMD maps shuffled 2 MiB physical
+ * pages directly.
+ */
+
+#include "commands.h"
+#include "addr.h"
+#include <stddef.h> // for size_t
+#include <stdint.h>
+
+// page tables must lie in the first 256 kiB of memory (see page_walk.c)
+#define PATTERN_MAX_PAGES (32 * PD_ENTRIES)
+
+#define PATTERN_STRIDE        272 // bytes: 17 lines, every set of the caches in turn
+#define PATTERN_ZIPF_EXPONENT 0.99 // of the page popularity
+#define PATTERN_MIXED_BLOCK   8 // instructions fetched in sequence before a jump
+
+typedef enum{
+	PATTERN_SEQUENTIAL, // every word in turn
+	PATTERN_STRIDED, // one word every PATTERN_STRIDE bytes
+	PATTERN_UNIFORM, // any word
+	PATTERN_ZIPF, // any word of a page picked by its Zipfian popularity
+	PATTERN_POINTER_CHASE, // every line once, in the order of a random cycle
+	PATTERN_MIXED, // instruction fetches in the first eighth, reads and writes of data elsewhere
+	NB_PATTERNS // not a pattern, their number
+}pattern_t;
+
+//=========================================================================
+/**
+ * @brief Name of a pattern, to print it.
+ * @param pattern the pattern
+ * @return its name, "?" if unknown
+ */
+const char* pattern_name(pattern_t pattern);
+
+//=========================================================================
+/**
+ * @brief Create a synthetic memory space, to be freed with free().
+ * @param mem_space (modified) the memory space
+ * @param mem_size (modified) its size in bytes
+ * @param nb_pages number of virtual (4 kiB) pages mapped, at most PATTERN_MAX_PAGES
+ * @param page_size PAGE_4K, or PAGE_2M if nb_pages is a multiple of PD_ENTRIES
+ * @param seed of the shuffling of the physical pages
+ * @return error code
+ */
+int pattern_memory_init(void** mem_space, size_t* mem_size, size_t nb_pages, page_size_t page_size, uint32_t seed);
+
+//=========================================================================
+/**
+ * @brief Generate the commands of a pattern over a synthetic memory space:
+ * word accesses, reads only except for PATTERN_MIXED.
+ * @param commands (modified) where to generate them
+ * @param nb_commands how many to generate
+ * @param pattern the pattern
+ * @param nb_pages number of virtual pages mapped by the memory space
+ * @param seed of the random choices
+ * @return error code
+ */
+int pattern_generate(command_t* commands, size_t nb_commands, pattern_t pattern, size_t nb_pages, uint32_t seed);
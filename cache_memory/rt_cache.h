@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+ * @file rt_cache.h
+ * @brief definitions associated to caches whose geometry is chosen at run time
+ *
+ * The fixed-size entries of cache.h can only describe the default geometry.
+ * Here the geometry comes from a cache_desc_t and the arrays are laid out
+ * from it when the cache is allocated.
+ *
+ * Tags are kept apart from the data (structure of arrays): lookups only read
+ * the packed tag words of a set, RT_CACHE_TAG_ALIGN bytes aligned so that a
+ * set of up to 16 ways is one host cache line, instead of walking entries
+ * where tags are interleaved with their lines.
+ */
+
+#include "cache.h"
+#include <stdint.h>
+#include <stddef.h> // for size_t
+
+#define RT_CACHE_MAX_WAYS  128u   // ways are indexed with uint8_t, HIT_WAY_MISS excluded
+#define RT_CACHE_MAX_LINES 32768u // lines are indexed with uint16_t, HIT_INDEX_MISS excluded
+#define RT_CACHE_TAG_ALIGN 64u    // host cache line
+
+// a tag word is RT_CACHE_VALID | tag for a valid entry, 0 for an invalid one
+// (tags have at most 30 bits, as a line holds at least one word)
+#define RT_CACHE_VALID 0x80000000u
+
+// re-reference prediction values of SRRIP and BRRIP (2 bits): 0 for a line
+// expected to be reused soon, RT_CACHE_RRPV_DISTANT for one to evict first
+#define RT_CACHE_RRPV_LONG    2u
+#define RT_CACHE_RRPV_DISTANT 3u
+#define RT_CACHE_BRRIP_LONG_ONE_IN 32u // BRRIP inserts one line in 32 as "long"
+#define RT_CACHE_RANDOM_SEED 0x2545F491u
+
+// tree-PLRU: bit n (1 <= n < ways) of the mask of a set is node n of a binary
+// tree whose leaves are the ways (children of n: 2n and 2n + 1), set when the
+// next line to evict is on the right of n. 3 bits for 4 ways, 7 for 8 ways...
+#define RT_CACHE_PLRU_MAX_WAYS 64u
+
+typedef struct{
+	cache_desc_t desc;
+	uint32_t* tags; // desc.lines * desc.ways tag words, set after set
+	uint8_t* ages; // desc.lines * desc.ways ages (LRU: from 0 to ways - 1, RRIP: re-reference prediction values)
+	word_t* data; // desc.lines * desc.ways lines of desc.words_per_line words
+	uint64_t* plru; // desc.lines tree-PLRU bitmasks (see RT_CACHE_PLRU_MAX_WAYS)
+	uint32_t random; // state of the generator used by RANDOM and BRRIP, reset on flush
+}rt_cache_t;
+
+// --------------------------------------------------
+#define rt_cache_slot(CACHE, LINE_INDEX, WAY) \
+        ((size_t)(LINE_INDEX) * (CACHE)->desc.ways + (WAY))
+
+// --------------------------------------------------
+#define rt_cache_valid(CACHE, LINE_INDEX, WAY) \
+        (((CACHE)->tags[rt_cache_slot(CACHE, LINE_INDEX, WAY)] & RT_CACHE_VALID) != 0)
+
+// --------------------------------------------------
+#define rt_cache_age(CACHE, LINE_INDEX, WAY) \
+        (CACHE)->ages[rt_cache_slot(CACHE, LINE_INDEX, WAY)]
+
+// --------------------------------------------------
+#define rt_cache_tag(CACHE, LINE_INDEX, WAY) \
+        ((CACHE)->tags[rt_cache_slot(CACHE, LINE_INDEX, WAY)] & ~RT_CACHE_VALID)
+
+// --------------------------------------------------
+#define rt_cache_line(CACHE, LINE_INDEX, WAY) \
+        ((CACHE)->data + rt_cache_slot(CACHE, LINE_INDEX, WAY) * (CACHE)->desc.words_per_line)
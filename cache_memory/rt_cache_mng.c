@@ -0,0 +1,658 @@
+/**
+ * @file rt_cache_mng.c
+ * @brief management of caches whose geometry is chosen at run time
+ */
+
+#include "rt_cache_mng.h"
+#include "rt_cache.h"
+#include "cache_mng.h"
+#include "cache.h"
+#include "util.h"
+#include "error.h"
+#include "addr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h> // for PRIx macros
+#include <limits.h> // for UCHAR_MAX
+
+//tags are compared with SSE2 (or AVX2, when built with -mavx2) where available,
+//one way at a time otherwise or when built with -DRT_CACHE_NO_SIMD
+#if !defined(RT_CACHE_NO_SIMD) && defined(__SSE2__)
+#include <immintrin.h>
+#define RT_CACHE_SIMD_WAYS 4 // tags compared by one SSE2 instruction
+#if defined(__AVX2__)
+#define RT_CACHE_AVX2_WAYS 8 // tags compared by one AVX2 instruction
+#endif
+#endif
+
+#define RT_CACHE_MAX_WORDS_PER_LINE 64 // 256 bytes per line
+
+//log_2 of a power of two, -1 if value is not one
+static int log2_exact(uint32_t value){
+	if(value == 0 || (value & (value - 1)) != 0){
+		return -1;
+	}
+	int bits = 0;
+	while(value > 1){
+		value >>= 1;
+		++bits;
+	}
+	return bits;
+}
+
+int cache_desc_init(cache_desc_t* desc, uint16_t ways, uint16_t lines, uint16_t words_per_line){
+	M_REQUIRE_NON_NULL(desc);
+
+	const int way_bits = log2_exact(ways);
+	const int index_bits = log2_exact(lines);
+	const int word_bits = log2_exact(words_per_line);
+	M_REQUIRE(way_bits >= 0 && ways <= RT_CACHE_MAX_WAYS, ERR_BAD_PARAMETER,
+		"number of ways (%" PRIu16 ") must be a power of two up to %u", ways, RT_CACHE_MAX_WAYS);
+	M_REQUIRE(index_bits >= 0 && lines <= RT_CACHE_MAX_LINES, ERR_BAD_PARAMETER,
+		"number of lines (%" PRIu16 ") must be a power of two up to %u", lines, RT_CACHE_MAX_LINES);
+	M_REQUIRE(word_bits >= 0 && words_per_line <= RT_CACHE_MAX_WORDS_PER_LINE, ERR_BAD_PARAMETER,
+		"words per line (%" PRIu16 ") must be a power of two up to %d", words_per_line, RT_CACHE_MAX_WORDS_PER_LINE);
+
+	zero_init_ptr(desc);
+	desc->ways = ways;
+	desc->lines = lines;
+	desc->words_per_line = words_per_line;
+	desc->offset_bits = (uint8_t)(2 + word_bits);
+	desc->index_bits = (uint8_t) index_bits;
+	desc->tag_remaining_bits = (uint8_t)(desc->offset_bits + desc->index_bits);
+	desc->tag_bits = (uint8_t)(32 - desc->tag_remaining_bits);
+
+	return ERR_NONE;
+}
+
+//allocating zeroes on RT_CACHE_TAG_ALIGN bytes
+static void* aligned_calloc(size_t size){
+	//aligned_alloc() wants a multiple of the alignment
+	size = (size + RT_CACHE_TAG_ALIGN - 1) / RT_CACHE_TAG_ALIGN * RT_CACHE_TAG_ALIGN;
+	void* const array = aligned_alloc(RT_CACHE_TAG_ALIGN, size);
+	if(array != NULL){
+		memset(array, 0, size);
+	}
+	return array;
+}
+
+int rt_cache_init(rt_cache_t* cache, const cache_desc_t* desc){
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(desc);
+
+	zero_init_ptr(cache);
+	//derived fields are recomputed: only the geometry is trusted
+	M_EXIT_IF_ERR(cache_desc_init(&cache->desc, desc->ways, desc->lines, desc->words_per_line),
+		"checking cache geometry");
+
+	const size_t entries = (size_t) cache->desc.lines * cache->desc.ways;
+	cache->tags = aligned_calloc(entries * sizeof(uint32_t));
+	cache->ages = calloc(entries, sizeof(uint8_t));
+	cache->data = aligned_calloc(entries * cache->desc.words_per_line * sizeof(word_t));
+	cache->plru = calloc(cache->desc.lines, sizeof(uint64_t));
+	if(cache->tags == NULL || cache->ages == NULL || cache->data == NULL || cache->plru == NULL){
+		rt_cache_free(cache);
+		return ERR_MEM;
+	}
+	cache->random = RT_CACHE_RANDOM_SEED;
+
+	return ERR_NONE;
+}
+
+int rt_cache_free(rt_cache_t* cache){
+	M_REQUIRE_NON_NULL(cache);
+
+	free(cache->tags);
+	free(cache->ages);
+	free(cache->data);
+	free(cache->plru);
+	cache->tags = NULL;
+	cache->ages = NULL;
+	cache->data = NULL;
+	cache->plru = NULL;
+	return ERR_NONE;
+}
+
+int rt_cache_flush(rt_cache_t* cache){
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(cache->tags);
+
+	const size_t entries = (size_t) cache->desc.lines * cache->desc.ways;
+	memset(cache->tags, 0, entries * sizeof(uint32_t));
+	memset(cache->ages, 0, entries * sizeof(uint8_t));
+	memset(cache->data, 0, entries * cache->desc.words_per_line * sizeof(word_t));
+	memset(cache->plru, 0, cache->desc.lines * sizeof(uint64_t));
+	//same evictions from one run to the next
+	cache->random = RT_CACHE_RANDOM_SEED;
+	return ERR_NONE;
+}
+
+static inline uint16_t line_index(const cache_desc_t* desc, uint32_t phy_addr){
+	return (uint16_t)((phy_addr >> desc->offset_bits) & (desc->lines - 1u));
+}
+
+static inline uint32_t line_tag(const cache_desc_t* desc, uint32_t phy_addr){
+	return phy_addr >> desc->tag_remaining_bits;
+}
+
+//one set of a cache, addressed with its ways and words per line given explicitly:
+//they are constants when called from the fast path, so that loops get unrolled.
+//Helpers take the arrays of the set by value: ages are bytes, and writing them
+//would otherwise force the compiler to reload the pointers of the cache
+typedef struct{
+	uint32_t* tags;
+	uint8_t* ages;
+	word_t* data;
+	uint64_t* plru;
+	uint32_t* random; // of the whole cache
+}rt_set_t;
+
+static inline rt_set_t set_at(rt_cache_t* cache, uint16_t index, uint16_t ways, uint16_t words){
+	const size_t slot = (size_t) index * ways;
+	return (rt_set_t){ cache->tags + slot, cache->ages + slot, cache->data + slot * words,
+		cache->plru + index, &cache->random };
+}
+
+#define set_line(SET, WAY, WORDS) ((SET).data + (size_t)(WAY) * (WORDS))
+
+//is the pair of caches of the default (Kaby Lake) geometry?
+#define is_default_geometry(L1, L2) \
+	((L1)->desc.ways == L1_ICACHE_WAYS && (L2)->desc.ways == L2_CACHE_WAYS \
+	&& (L1)->desc.words_per_line == L1_ICACHE_WORDS_PER_LINE)
+
+//only the packed tag words of the set are read
+static inline uint8_t lookup(const uint32_t* tags, uint32_t tag, uint16_t ways){
+	const uint32_t wanted = RT_CACHE_VALID | tag;
+
+#ifdef RT_CACHE_SIMD_WAYS
+	//ways are a power of two: from RT_CACHE_SIMD_WAYS on, a set is made of
+	//whole vectors, aligned as tags are RT_CACHE_TAG_ALIGN aligned
+#ifdef RT_CACHE_AVX2_WAYS
+	if(ways >= RT_CACHE_AVX2_WAYS){
+		const __m256i key = _mm256_set1_epi32((int) wanted);
+		for(uint16_t first = 0; first < ways; first += RT_CACHE_AVX2_WAYS){
+			const __m256i found = _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i*)(tags + first)), key);
+			const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(found));
+			if(mask != 0){
+				return (uint8_t)(first + __builtin_ctz((unsigned int) mask));
+			}
+		}
+		return HIT_WAY_MISS;
+	}
+#endif
+	if(ways >= RT_CACHE_SIMD_WAYS){
+		const __m128i key = _mm_set1_epi32((int) wanted);
+		for(uint16_t first = 0; first < ways; first += RT_CACHE_SIMD_WAYS){
+			const __m128i found = _mm_cmpeq_epi32(_mm_load_si128((const __m128i*)(tags + first)), key);
+			const int mask = _mm_movemask_ps(_mm_castsi128_ps(found));
+			if(mask != 0){
+				return (uint8_t)(first + __builtin_ctz((unsigned int) mask));
+			}
+		}
+		return HIT_WAY_MISS;
+	}
+#endif
+
+	foreach_way(way, ways){
+		if(tags[way] == wanted){
+			return way;
+		}
+	}
+	return HIT_WAY_MISS;
+}
+
+int rt_cache_hit(const rt_cache_t* cache,
+                 const phy_addr_t* paddr,
+                 const uint32_t** p_line,
+                 uint8_t* hit_way,
+                 uint16_t* hit_index){
+
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(cache->tags);
+	M_REQUIRE_NON_NULL(paddr);
+	M_REQUIRE_NON_NULL(p_line);
+	M_REQUIRE_NON_NULL(hit_way);
+	M_REQUIRE_NON_NULL(hit_index);
+
+	const uint32_t phy_addr = convert_paddr(paddr);
+	const uint16_t index = line_index(&cache->desc, phy_addr);
+	const uint32_t tag = line_tag(&cache->desc, phy_addr);
+	const uint32_t* const tags = cache->tags + (size_t) index * cache->desc.ways;
+	uint8_t way = HIT_WAY_MISS;
+
+	if(cache->desc.ways == L1_ICACHE_WAYS){
+		way = lookup(tags, tag, L1_ICACHE_WAYS);
+	}else if(cache->desc.ways == L2_CACHE_WAYS){
+		way = lookup(tags, tag, L2_CACHE_WAYS);
+	}else{
+		way = lookup(tags, tag, cache->desc.ways);
+	}
+
+	if(way == HIT_WAY_MISS){
+		*hit_way = HIT_WAY_MISS;
+		*hit_index = HIT_INDEX_MISS;
+	}else{
+		*hit_way = way;
+		*hit_index = index;
+		*p_line = rt_cache_line(cache, index, way);
+	}
+	return ERR_NONE;
+}
+
+int rt_cache_insert(rt_cache_t* cache,
+                    uint16_t cache_line_index,
+                    uint8_t cache_way,
+                    uint32_t tag,
+                    const word_t* line){
+
+	M_REQUIRE_NON_NULL(cache);
+	M_REQUIRE_NON_NULL(cache->tags);
+	M_REQUIRE_NON_NULL(line);
+	M_REQUIRE(cache_line_index < cache->desc.lines, ERR_BAD_PARAMETER, "Wrong index for insertion in cache %" PRIu16, cache_line_index);
+	M_REQUIRE(cache_way < cache->desc.ways, ERR_BAD_PARAMETER, "Wrong cache_way for insertion in cache %" PRIu8, cache_way);
+
+	M_REQUIRE(tag >> cache->desc.tag_bits == 0, ERR_BAD_PARAMETER, "Tag 0x%" PRIx32 " too large for cache", tag);
+
+	cache->tags[rt_cache_slot(cache, cache_line_index, cache_way)] = RT_CACHE_VALID | tag;
+	memcpy(rt_cache_line(cache, cache_line_index, cache_way), line, cache->desc.words_per_line * sizeof(word_t));
+
+	return ERR_NONE;
+}
+
+//same as LRU_age_increase() of lru.h
+static inline void lru_age_increase(uint8_t* ages, uint8_t way_index, uint16_t ways){
+	foreach_way(way, ways){
+		if(ages[way] != ways - 1){
+			ages[way]++;
+		}
+	}
+	ages[way_index] = 0;
+}
+
+//same as LRU_age_update() of lru.h
+static inline void lru_age_update(uint8_t* ages, uint8_t way_index, uint16_t ways){
+	const uint8_t age = ages[way_index];
+	foreach_way(way, ways){
+		if(ages[way] < age){
+			ages[way]++;
+		}
+	}
+	ages[way_index] = 0;
+}
+
+//deterministic pseudo-random numbers (xorshift)
+static inline uint32_t next_random(uint32_t* state){
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static bool is_policy(cache_replace_t replace){
+	switch(replace){
+	case LRU:
+	case PLRU:
+	case SRRIP:
+	case BRRIP:
+	case RANDOM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//tree-PLRU: the nodes from the root to a way all point away from it;
+//the whole mask is computed first, so that it is stored once
+static inline void plru_touch(uint64_t* plru, uint8_t way, uint16_t ways){
+	uint64_t path = 0;
+	uint64_t away = 0;
+	unsigned int node = 1;
+	for(int level = __builtin_ctz(ways) - 1; level >= 0; --level){
+		const unsigned int right = (way >> level) & 1u;
+		path |= UINT64_C(1) << node;
+		away |= (uint64_t)(right ^ 1u) << node;
+		node = 2 * node + right;
+	}
+	*plru = (*plru & ~path) | away;
+}
+
+//tree-PLRU: following the nodes from the root
+static inline uint8_t plru_victim(uint64_t plru, uint16_t ways){
+	unsigned int node = 1;
+	while(node < ways){
+		node = 2 * node + (unsigned int)((plru >> node) & 1u);
+	}
+	return (uint8_t)(node - ways);
+}
+
+//a hit on a way
+static inline void policy_hit(rt_set_t set, uint8_t way, uint16_t ways, cache_replace_t replace){
+	switch(replace){
+	case LRU:
+		lru_age_update(set.ages, way, ways);
+		break;
+	case PLRU:
+		plru_touch(set.plru, way, ways);
+		break;
+	case SRRIP:
+	case BRRIP:
+		//reused: predicted to be reused again soon
+		set.ages[way] = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+//a line just inserted on a way, free or evicted
+static inline void policy_fill(rt_set_t set, uint8_t way, bool evicted, uint16_t ways, cache_replace_t replace){
+	switch(replace){
+	case LRU:
+		if(evicted){
+			lru_age_update(set.ages, way, ways);
+		}else{
+			lru_age_increase(set.ages, way, ways);
+		}
+		break;
+	case PLRU:
+		plru_touch(set.plru, way, ways);
+		break;
+	case SRRIP:
+		set.ages[way] = RT_CACHE_RRPV_LONG;
+		break;
+	case BRRIP:
+		set.ages[way] = (next_random(set.random) % RT_CACHE_BRRIP_LONG_ONE_IN == 0)
+			? RT_CACHE_RRPV_LONG : RT_CACHE_RRPV_DISTANT;
+		break;
+	default:
+		break;
+	}
+}
+
+//the way to evict from a full set
+static inline uint8_t policy_victim(rt_set_t set, uint16_t ways, cache_replace_t replace){
+	uint8_t eviction_way = 0;
+	uint8_t max_age = 0;
+
+	switch(replace){
+	case RANDOM:
+		return (uint8_t)(next_random(set.random) & (ways - 1u));
+	case PLRU:
+		return plru_victim(*set.plru, ways);
+	case SRRIP:
+	case BRRIP:
+		//the first way predicted the most distant; if none is predicted
+		//RT_CACHE_RRPV_DISTANT, the whole set ages until one is
+		foreach_way(way, ways){
+			if(max_age < set.ages[way]){
+				max_age = set.ages[way];
+				eviction_way = way;
+			}
+		}
+		if(max_age < RT_CACHE_RRPV_DISTANT){
+			foreach_way(way, ways){
+				set.ages[way] += RT_CACHE_RRPV_DISTANT - max_age;
+			}
+		}
+		return eviction_way;
+	default:
+		//least recently used
+		foreach_way(way, ways){
+			if(max_age < set.ages[way]){
+				max_age = set.ages[way];
+				eviction_way = way;
+			}
+		}
+		return eviction_way;
+	}
+}
+
+static inline void set_entry(rt_set_t set, uint8_t way, uint32_t tag, const word_t* line, uint16_t words){
+	set.tags[way] = RT_CACHE_VALID | tag;
+	memcpy(set_line(set, way, words), line, words * sizeof(word_t));
+}
+
+//inserting a line on the first free way of its set, or on the one the policy evicts:
+//in that case the evicted line is copied to evicted_tag/evicted_line and true is returned
+static inline bool place_line(rt_set_t set, uint32_t tag, const word_t* line,
+                              uint32_t* evicted_tag, word_t* evicted_line, uint16_t ways, uint16_t words,
+                              cache_replace_t replace){
+
+	foreach_way(way, ways){
+		if(!(set.tags[way] & RT_CACHE_VALID)){
+			set_entry(set, way, tag, line, words);
+			policy_fill(set, way, false, ways, replace);
+			return false;
+		}
+	}
+
+	const uint8_t eviction_way = policy_victim(set, ways, replace);
+	*evicted_tag = set.tags[eviction_way] & ~RT_CACHE_VALID;
+	memcpy(evicted_line, set_line(set, eviction_way, words), words * sizeof(word_t));
+	set_entry(set, eviction_way, tag, line, words);
+	policy_fill(set, eviction_way, true, ways, replace);
+	return true;
+}
+
+//inserting a line in level 1; a line evicted from level 1 goes to level 2,
+//a line evicted from level 2 is dropped (memory is always up to date)
+static inline void promote_line(rt_cache_t* l1_cache, rt_cache_t* l2_cache, uint32_t phy_addr, const word_t* line,
+                                uint16_t l1_ways, uint16_t l2_ways, uint16_t words, cache_replace_t replace){
+	const uint16_t l1_index = line_index(&l1_cache->desc, phy_addr);
+	uint32_t evicted_tag = 0;
+	word_t evicted_line[RT_CACHE_MAX_WORDS_PER_LINE];
+
+	if(place_line(set_at(l1_cache, l1_index, l1_ways, words), line_tag(&l1_cache->desc, phy_addr), line,
+		&evicted_tag, evicted_line, l1_ways, words, replace)){
+		//the evicted line is placed from its address, whatever both geometries are
+		const uint32_t evicted_addr = (evicted_tag << l1_cache->desc.tag_remaining_bits)
+			| ((uint32_t) l1_index << l1_cache->desc.offset_bits);
+		uint32_t dropped_tag = 0;
+		word_t dropped_line[RT_CACHE_MAX_WORDS_PER_LINE];
+		place_line(set_at(l2_cache, line_index(&l2_cache->desc, evicted_addr), l2_ways, words),
+			line_tag(&l2_cache->desc, evicted_addr), evicted_line, &dropped_tag, dropped_line, l2_ways, words, replace);
+	}
+}
+
+//reading a word once all the arguments are checked
+static inline void read_word(const word_t* central_mem, uint32_t phy_addr, rt_cache_t* l1_cache, rt_cache_t* l2_cache,
+                             word_t* word, uint16_t l1_ways, uint16_t l2_ways, uint16_t words, cache_replace_t replace){
+	const uint16_t word_select = (phy_addr / sizeof(word_t)) & (words - 1u);
+
+	rt_set_t set = set_at(l1_cache, line_index(&l1_cache->desc, phy_addr), l1_ways, words);
+	uint8_t way = lookup(set.tags, line_tag(&l1_cache->desc, phy_addr), l1_ways);
+	//data is on level 1
+	if(way != HIT_WAY_MISS){
+		*word = set_line(set, way, words)[word_select];
+		policy_hit(set, way, l1_ways, replace);
+		return;
+	}
+
+	word_t line[RT_CACHE_MAX_WORDS_PER_LINE];
+	set = set_at(l2_cache, line_index(&l2_cache->desc, phy_addr), l2_ways, words);
+	way = lookup(set.tags, line_tag(&l2_cache->desc, phy_addr), l2_ways);
+	if(way != HIT_WAY_MISS){
+		//found in level 2: the line moves to level 1
+		memcpy(line, set_line(set, way, words), words * sizeof(word_t));
+		set.tags[way] = 0;
+	}else{
+		//not found in either caches: the line comes from memory
+		memcpy(line, central_mem + (phy_addr / sizeof(word_t) & ~(uint32_t)(words - 1u)), words * sizeof(word_t));
+	}
+
+	*word = line[word_select];
+	promote_line(l1_cache, l2_cache, phy_addr, line, l1_ways, l2_ways, words, replace);
+}
+
+//writing a word once all the arguments are checked
+static inline void write_word(word_t* central_mem, uint32_t phy_addr, rt_cache_t* l1_cache, rt_cache_t* l2_cache,
+                              word_t word, uint16_t l1_ways, uint16_t l2_ways, uint16_t words, cache_replace_t replace){
+	const uint16_t word_select = (phy_addr / sizeof(word_t)) & (words - 1u);
+
+	//write-through: memory always gets the word
+	central_mem[phy_addr / sizeof(word_t)] = word;
+
+	rt_set_t set = set_at(l1_cache, line_index(&l1_cache->desc, phy_addr), l1_ways, words);
+	uint8_t way = lookup(set.tags, line_tag(&l1_cache->desc, phy_addr), l1_ways);
+	//data is on level 1: modified in place
+	if(way != HIT_WAY_MISS){
+		set_line(set, way, words)[word_select] = word;
+		policy_hit(set, way, l1_ways, replace);
+		return;
+	}
+
+	word_t line[RT_CACHE_MAX_WORDS_PER_LINE];
+	set = set_at(l2_cache, line_index(&l2_cache->desc, phy_addr), l2_ways, words);
+	way = lookup(set.tags, line_tag(&l2_cache->desc, phy_addr), l2_ways);
+	if(way != HIT_WAY_MISS){
+		//found on level 2: the modified line moves to level 1
+		memcpy(line, set_line(set, way, words), words * sizeof(word_t));
+		policy_hit(set, way, l2_ways, replace);
+		set.tags[way] = 0;
+	}else{
+		//not found in either caches: the line comes from memory (already written)
+		memcpy(line, central_mem + (phy_addr / sizeof(word_t) & ~(uint32_t)(words - 1u)), words * sizeof(word_t));
+	}
+
+	line[word_select] = word;
+	promote_line(l1_cache, l2_cache, phy_addr, line, l1_ways, l2_ways, words, replace);
+}
+
+//checks shared by reads and writes
+#define check_access(mem_space, paddr, l1_cache, l2_cache, word, replace) \
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM); \
+	M_REQUIRE_NON_NULL(paddr); \
+	M_REQUIRE_NON_NULL(l1_cache); \
+	M_REQUIRE_NON_NULL(l2_cache); \
+	M_REQUIRE_NON_NULL(l1_cache->tags); \
+	M_REQUIRE_NON_NULL(l2_cache->tags); \
+	M_REQUIRE_NON_NULL(word); \
+	M_REQUIRE(is_policy(replace), ERR_BAD_PARAMETER, "Wrong replacement policy %d", replace); \
+	M_REQUIRE(replace != PLRU || (l1_cache->desc.ways <= RT_CACHE_PLRU_MAX_WAYS && l2_cache->desc.ways <= RT_CACHE_PLRU_MAX_WAYS), \
+		ERR_BAD_PARAMETER, "tree-PLRU is limited to %u ways", RT_CACHE_PLRU_MAX_WAYS); \
+	M_REQUIRE(paddr->page_offset % sizeof(word_t) == 0, ERR_BAD_PARAMETER, "Physical address 0x%08" PRIx32 " not aligned with words", convert_paddr(paddr)); \
+	M_REQUIRE(l1_cache->desc.words_per_line == l2_cache->desc.words_per_line, ERR_BAD_PARAMETER, \
+		"L1 (%" PRIu16 " words) and L2 (%" PRIu16 " words) must have the same line size", \
+		l1_cache->desc.words_per_line, l2_cache->desc.words_per_line)
+
+int rt_cache_read(const void* mem_space,
+                  phy_addr_t* paddr,
+                  mem_access_t access,
+                  rt_cache_t* l1_cache,
+                  rt_cache_t* l2_cache,
+                  uint32_t* word,
+                  cache_replace_t replace){
+
+	check_access(mem_space, paddr, l1_cache, l2_cache, word, replace);
+	M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "Wrong access demand %d", access);
+
+	if(is_default_geometry(l1_cache, l2_cache)){
+		read_word(mem_space, convert_paddr(paddr), l1_cache, l2_cache, word,
+			L1_ICACHE_WAYS, L2_CACHE_WAYS, L1_ICACHE_WORDS_PER_LINE, replace);
+	}else{
+		read_word(mem_space, convert_paddr(paddr), l1_cache, l2_cache, word,
+			l1_cache->desc.ways, l2_cache->desc.ways, l1_cache->desc.words_per_line, replace);
+	}
+	return ERR_NONE;
+}
+
+int rt_cache_read_byte(const void* mem_space,
+                       phy_addr_t* paddr,
+                       mem_access_t access,
+                       rt_cache_t* l1_cache,
+                       rt_cache_t* l2_cache,
+                       uint8_t* byte,
+                       cache_replace_t replace){
+
+	M_REQUIRE_NON_NULL(paddr);
+	M_REQUIRE_NON_NULL(byte);
+	//other controls are made in rt_cache_read
+	const uint8_t byte_select = convert_paddr(paddr) % sizeof(word_t);
+
+	//reading the whole word the byte belongs to
+	phy_addr_t word_paddr = *paddr;
+	word_paddr.page_offset -= byte_select;
+
+	word_t word = 0;
+	M_EXIT_IF_ERR(rt_cache_read(mem_space, &word_paddr, access, l1_cache, l2_cache, &word, replace),
+		"reading word");
+
+	*byte = (word >> (BYTE_WIDTH * byte_select)) & UCHAR_MAX;
+	return ERR_NONE;
+}
+
+int rt_cache_write(void* mem_space,
+                   phy_addr_t* paddr,
+                   rt_cache_t* l1_cache,
+                   rt_cache_t* l2_cache,
+                   const uint32_t* word,
+                   cache_replace_t replace){
+
+	check_access(mem_space, paddr, l1_cache, l2_cache, word, replace);
+
+	if(is_default_geometry(l1_cache, l2_cache)){
+		write_word(mem_space, convert_paddr(paddr), l1_cache, l2_cache, *word,
+			L1_ICACHE_WAYS, L2_CACHE_WAYS, L1_ICACHE_WORDS_PER_LINE, replace);
+	}else{
+		write_word(mem_space, convert_paddr(paddr), l1_cache, l2_cache, *word,
+			l1_cache->desc.ways, l2_cache->desc.ways, l1_cache->desc.words_per_line, replace);
+	}
+	return ERR_NONE;
+}
+
+int rt_cache_write_byte(void* mem_space,
+                        phy_addr_t* paddr,
+                        rt_cache_t* l1_cache,
+                        rt_cache_t* l2_cache,
+                        uint8_t byte,
+                        cache_replace_t replace){
+
+	M_REQUIRE_NON_NULL(paddr);
+	//other controls are made in rt_cache_read and rt_cache_write
+	const uint8_t byte_select = convert_paddr(paddr) % sizeof(word_t);
+
+	//reading then writing back the whole word the byte belongs to
+	phy_addr_t word_paddr = *paddr;
+	word_paddr.page_offset -= byte_select;
+
+	word_t word = 0;
+	M_EXIT_IF_ERR(rt_cache_read(mem_space, &word_paddr, DATA, l1_cache, l2_cache, &word, replace),
+		"reading word");
+
+	word &= ~((word_t) UCHAR_MAX << (BYTE_WIDTH * byte_select));
+	word |= (word_t) byte << (BYTE_WIDTH * byte_select);
+	return rt_cache_write(mem_space, &word_paddr, l1_cache, l2_cache, &word, replace);
+}
+
+//=========================================================================
+// see rt_cache_mng.h
+int rt_cache_dump(FILE* output, const rt_cache_t* cache)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cache->tags);
+
+    fputs("WAY/LINE: V: AGE: TAG: WORDS\n", output);
+    for(uint16_t index = 0; index < cache->desc.lines; index++) {
+        foreach_way(way, cache->desc.ways) {
+            fprintf(output, "%02" PRIx8 "/%04" PRIx16 ": ", way, index);
+            if(rt_cache_valid(cache, index, way)) {
+                fprintf(output, "V: 1, AGE: %1" PRIx8 ", TAG: 0x%03" PRIx32 ", values: ( ",
+                        rt_cache_age(cache, index, way),
+                        rt_cache_tag(cache, index, way));
+                for(uint16_t i = 0; i < cache->desc.words_per_line; i++)
+                    fprintf(output, "0x%08" PRIx32 " ", rt_cache_line(cache, index, way)[i]);
+                fputs(")\n", output);
+            } else {
+                fputs("V: 0, AGE: -, TAG: -----, values: ( ", output);
+                for(uint16_t i = 0; i < cache->desc.words_per_line; i++)
+                    fputs("---------- ", output);
+                fputs(")\n", output);
+            }
+        }
+    }
+    putc('\n', output);
+
+    return ERR_NONE;
+}
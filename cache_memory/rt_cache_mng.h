@@ -0,0 +1,178 @@
+#pragma once
+
+/**
+ * @file rt_cache_mng.h
+ * @brief management of caches whose geometry is chosen at run time
+ *
+ * Same behaviour as cache_mng.h (L2 exclusive of L1, write-through,
+ * write-allocate), on caches described by a cache_desc_t. L1 and L2 must
+ * have the same line size. The default geometry is looked up through
+ * specialised loops, so it costs no more than with the fixed entries
+ * (see rt_cache.h for the layout).
+ *
+ * Any cache_replace_t policy may be used. A cache must keep the same one
+ * from one flush to the next: the ages of its lines mean different things
+ * to LRU and to RRIP.
+ */
+
+#include "mem_access.h"
+#include "addr.h"
+#include "cache.h"
+#include "cache_mng.h"
+#include "rt_cache.h"
+#include <stdio.h> // for FILE
+
+//=========================================================================
+/**
+ * @brief Compute a cache descriptor from its geometry.
+ * @param desc (modified) the descriptor
+ * @param ways number of ways, a power of two up to RT_CACHE_MAX_WAYS
+ * @param lines number of lines (sets), a power of two up to RT_CACHE_MAX_LINES
+ * @param words_per_line number of words per line, a power of two
+ *        (a line cannot be larger than a page)
+ * @return error code
+ */
+int cache_desc_init(cache_desc_t* desc, uint16_t ways, uint16_t lines, uint16_t words_per_line);
+
+//=========================================================================
+/**
+ * @brief Allocate an empty (all invalid) cache laid out from a descriptor.
+ * @param cache (modified) the cache
+ * @param desc its geometry
+ * @return error code
+ */
+int rt_cache_init(rt_cache_t* cache, const cache_desc_t* desc);
+
+//=========================================================================
+/**
+ * @brief Free the arrays of a cache.
+ * @param cache the cache
+ * @return error code
+ */
+int rt_cache_free(rt_cache_t* cache);
+
+//=========================================================================
+/**
+ * @brief Clean a cache (invalidate, reset...).
+ * @param cache the cache
+ * @return error code
+ */
+int rt_cache_flush(rt_cache_t* cache);
+
+//=========================================================================
+/**
+ * @brief Check if a instruction/data is present in a cache.
+ * Nothing is modified in the cache.
+ * @param cache the cache to look into
+ * @param paddr the physical address to look for
+ * @param p_line (modified) pointer to the line on hit
+ * @param hit_way (modified) the way on hit, HIT_WAY_MISS otherwise
+ * @param hit_index (modified) the line on hit, HIT_INDEX_MISS otherwise
+ * @return error code
+ */
+int rt_cache_hit(const rt_cache_t* cache,
+                 const phy_addr_t* paddr,
+                 const uint32_t** p_line,
+                 uint8_t* hit_way,
+                 uint16_t* hit_index);
+
+//=========================================================================
+/**
+ * @brief Insert a valid line into a cache (age is left unchanged).
+ * @param cache the cache
+ * @param cache_line_index the number of the line to overwrite
+ * @param cache_way the number of the way where to insert
+ * @param tag the tag of the line
+ * @param line the desc.words_per_line words of the line
+ * @return error code
+ */
+int rt_cache_insert(rt_cache_t* cache,
+                    uint16_t cache_line_index,
+                    uint8_t cache_way,
+                    uint32_t tag,
+                    const word_t* line);
+
+//=========================================================================
+/**
+ * @brief Ask cache for a word of data (see cache_read()).
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address, aligned on a word
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param l1_cache the L1 cache matching access
+ * @param l2_cache the L2 cache
+ * @param word (modified) the word read
+ * @param replace replacement policy (any cache_replace_t)
+ * @return error code
+ */
+int rt_cache_read(const void* mem_space,
+                  phy_addr_t* paddr,
+                  mem_access_t access,
+                  rt_cache_t* l1_cache,
+                  rt_cache_t* l2_cache,
+                  uint32_t* word,
+                  cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Ask cache for a byte of data. Endianess: LITTLE.
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param l1_cache the L1 cache matching access
+ * @param l2_cache the L2 cache
+ * @param byte (modified) the byte read
+ * @param replace replacement policy
+ * @return error code
+ */
+int rt_cache_read_byte(const void* mem_space,
+                       phy_addr_t* paddr,
+                       mem_access_t access,
+                       rt_cache_t* l1_cache,
+                       rt_cache_t* l2_cache,
+                       uint8_t* byte,
+                       cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Change a word of data in the cache (see cache_write()).
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address, aligned on a word
+ * @param l1_cache the L1 data cache
+ * @param l2_cache the L2 cache
+ * @param word the word to write
+ * @param replace replacement policy
+ * @return error code
+ */
+int rt_cache_write(void* mem_space,
+                   phy_addr_t* paddr,
+                   rt_cache_t* l1_cache,
+                   rt_cache_t* l2_cache,
+                   const uint32_t* word,
+                   cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Write to cache a byte of data. Endianess: LITTLE.
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address
+ * @param l1_cache the L1 data cache
+ * @param l2_cache the L2 cache
+ * @param byte the byte to write
+ * @param replace replacement policy
+ * @return error code
+ */
+int rt_cache_write_byte(void* mem_space,
+                        phy_addr_t* paddr,
+                        rt_cache_t* l1_cache,
+                        rt_cache_t* l2_cache,
+                        uint8_t byte,
+                        cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Print the contents of a cache to a stream, as cache_dump() does.
+ * @param output the stream to print to
+ * @param cache the cache to dump
+ * @return error code
+ */
+int rt_cache_dump(FILE* output, const rt_cache_t* cache);
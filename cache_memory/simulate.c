@@ -0,0 +1,696 @@
+/**
+ * @file simulate.c
+ * @brief Replay a trace through the TLB hierarchy, then the cache hierarchy
+ *
+ * Commands are read batch by batch, translated by the L1 ITLB/DTLB and L2 TLB
+ * (tlb_search_batch(), the misses of L2 TLB walking through paging-structure
+ * caches) and sent to the L1 I/D and L2 caches
+ * (cache_access_batch()). Nothing is printed per command: only the totals,
+ * once the whole trace has been simulated, optionally followed by the
+ * statistics of every level (stats.h) as CSV or JSON.
+ *
+ * Built with -DHEATMAP, the per-set and per-page heatmap (heatmap.h) can be
+ * written to a file too: as CSV if its name ends with ".csv", binary otherwise.
+ *
+ * Context switches (SWITCH commands) change the CR3, hence the address space
+ * and the ASID tagging the TLB entries (see addr.h). With --flush, they also
+ * invalidate the TLBs and paging-structure caches, as without ASIDs: comparing
+ * both runs tells what the tagging saves.
+ *
+ * Invalidations (INVALIDATE commands) only invalidate the TLB entries of their
+ * pages in the running address space, all of them for 0 pages, and the
+ * paging-structure caches of that address space (as INVLPG does).
+ *
+ * With --cores N, every command runs on the core of its trace record: each
+ * core has private TLBs, paging-structure caches and L1 caches, its own CR3,
+ * and its own host thread, all sharing the L2 cache (and the memory) on a
+ * bus which keeps the L1 caches coherent (MESI, see coherence.h). The main
+ * thread hands every core its commands of a trace batch, then waits for all
+ * of them before the next one: cores never run more than a batch apart.
+ * Within a batch, the order in which they reach the bus depends on the host,
+ * and so may the misses, the coherence counters and the data read when cores
+ * share lines. Switches and invalidations only concern their core.
+ * Built with -DHEATMAP, the cores take turns on the main thread instead.
+ *
+ * The caches write through to memory, or with --write-back only write their
+ * dirty lines back when evicted from the L2 cache (see cache_write_t), then
+ * all the remaining ones once the whole trace has been simulated. The lines
+ * written to memory either way are counted by the statistics (memory_writes).
+ *
+ * The caches evict their least recently used lines, or with --policy those
+ * another replacement policy chooses (see cache_replace_t): lru, plru, srrip,
+ * brrip or random.
+ */
+
+#define _POSIX_C_SOURCE 200809L // for pthread_barrier_t
+
+#include "error.h"
+#include "commands.h"
+#include "memory.h"
+#include "tlb_hrchy.h"
+#include "tlb_hrchy_mng.h"
+#include "cache.h"
+#include "cache_mng.h"
+#include "stats.h"
+#include "heatmap.h"
+#include "page_walk.h"
+#include "coherence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h> // for PRIu64
+#include <pthread.h>
+
+#define SIMULATE_MAX_CORES (UINT8_MAX + 1) // numbered by a byte in traces
+
+typedef struct {
+    uint64_t commands;
+    uint64_t fetches; // instructions
+    uint64_t reads; // data
+    uint64_t writes;
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+    uint64_t switches; // context switches, not counted as commands
+    uint64_t invalidations; // not counted as commands either
+    word_t checksum; // of everything read, to compare runs
+} totals_t;
+
+// ======================================================================
+// everything a batch needs, allocated once
+typedef struct {
+    virt_addr_t* vaddrs;
+    mem_access_t* types;
+    phy_addr_t* paddrs;
+    int* hits;
+    cache_access_t* accesses;
+} batch_t;
+
+static void batch_free(batch_t* batch)
+{
+    free(batch->vaddrs);
+    free(batch->types);
+    free(batch->paddrs);
+    free(batch->hits);
+    free(batch->accesses);
+}
+
+static int batch_alloc(batch_t* batch, size_t capacity)
+{
+    batch->vaddrs = calloc(capacity, sizeof(virt_addr_t));
+    batch->types = calloc(capacity, sizeof(mem_access_t));
+    batch->paddrs = calloc(capacity, sizeof(phy_addr_t));
+    batch->hits = calloc(capacity, sizeof(int));
+    batch->accesses = calloc(capacity, sizeof(cache_access_t));
+    if (batch->vaddrs == NULL || batch->types == NULL || batch->paddrs == NULL
+        || batch->hits == NULL || batch->accesses == NULL) {
+        batch_free(batch);
+        memset(batch, 0, sizeof(batch_t));
+        return ERR_MEM;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+typedef struct {
+    l1_itlb_entry_t l1_itlb[L1_ITLB_LINES];
+    l1_dtlb_entry_t l1_dtlb[L1_DTLB_LINES];
+    l2_tlb_entry_t l2_tlb[L2_TLB_LINES];
+    page_walk_cache_t pwc;
+    void* l1_icache;
+    void* l1_dcache;
+    void* l2_cache;
+    coherence_t* coherence; // of the cores sharing the L2 cache, NULL for a single core
+    size_t core; // among them
+    cache_replace_t replace; // of the L1 and L2 caches
+    cache_write_t write_policy; // of the L1 and L2 caches
+    uint32_t cr3; // of the address space running
+    bool flush_on_switch; // instead of relying on ASIDs
+} hierarchy_t;
+
+// translating then accessing one batch of commands
+static int simulate_batch(void* mem_space, hierarchy_t* hrchy, batch_t* batch,
+                          const command_t* commands, size_t nb_commands,
+                          size_t prefetch_distance, totals_t* totals, sim_stats_t* stats)
+{
+    for (size_t i = 0; i < nb_commands; ++i) {
+        batch->vaddrs[i] = commands[i].vaddr;
+        batch->types[i] = commands[i].type;
+    }
+
+    M_EXIT_IF_ERR(tlb_search_batch(mem_space, hrchy->cr3, batch->vaddrs, batch->types, batch->paddrs, batch->hits,
+                                   nb_commands, hrchy->l1_itlb, hrchy->l1_dtlb, hrchy->l2_tlb, &hrchy->pwc, stats),
+                  "translating batch");
+
+    for (size_t i = 0; i < nb_commands; ++i) {
+        cache_access_t* const access = &batch->accesses[i];
+        access->paddr = batch->paddrs[i];
+        access->data = commands[i].write_data;
+        access->order = commands[i].order;
+        access->type = commands[i].type;
+        access->data_size = (uint8_t) commands[i].data_size;
+        totals->tlb_hits += (uint64_t) batch->hits[i];
+    }
+
+    M_EXIT_IF_ERR(cache_access_batch(mem_space, batch->accesses, nb_commands, hrchy->l1_icache, hrchy->l1_dcache,
+                                     hrchy->l2_cache, hrchy->coherence, hrchy->core, hrchy->replace, hrchy->write_policy,
+                                     prefetch_distance, stats),
+                  "accessing caches");
+
+    for (size_t i = 0; i < nb_commands; ++i) {
+        const cache_access_t* const access = &batch->accesses[i];
+        if (access->order == WRITE) {
+            ++totals->writes;
+        } else {
+            totals->fetches += (access->type == INSTRUCTION);
+            totals->reads += (access->type == DATA);
+            totals->checksum = totals->checksum * 31 + access->data;
+        }
+    }
+    totals->commands += nb_commands;
+    totals->tlb_misses = totals->commands - totals->tlb_hits;
+
+    return ERR_NONE;
+}
+
+static int context_switch(hierarchy_t* hrchy, uint32_t cr3, size_t mem_size, totals_t* totals)
+{
+    M_EXIT_IF_ERR(page_walk_check_cr3(cr3, mem_size), "checking CR3");
+    if (hrchy->flush_on_switch) {
+        M_EXIT_IF_ERR(tlb_flush(hrchy->l1_itlb, L1_ITLB), "flushing L1 ITLB");
+        M_EXIT_IF_ERR(tlb_flush(hrchy->l1_dtlb, L1_DTLB), "flushing L1 DTLB");
+        M_EXIT_IF_ERR(tlb_flush(hrchy->l2_tlb, L2_TLB), "flushing L2 TLB");
+        M_EXIT_IF_ERR(page_walk_cache_invalidate(&hrchy->pwc), "invalidating PWC");
+    }
+    hrchy->cr3 = cr3;
+    ++totals->switches;
+    return ERR_NONE;
+}
+
+static int invalidate(hierarchy_t* hrchy, const command_t* command, totals_t* totals)
+{
+    const uint16_t asid = CR3_ASID(hrchy->cr3);
+    if (command->write_data == 0) {
+        M_EXIT_IF_ERR(tlb_invalidate_asid(asid, hrchy->l1_itlb, hrchy->l1_dtlb, hrchy->l2_tlb), "invalidating ASID");
+    } else {
+        M_EXIT_IF_ERR(tlb_invalidate_range(&command->vaddr, command->write_data, asid,
+                                           hrchy->l1_itlb, hrchy->l1_dtlb, hrchy->l2_tlb), "invalidating pages");
+    }
+    M_EXIT_IF_ERR(page_walk_cache_invalidate_asid(&hrchy->pwc, asid), "invalidating PWC");
+    ++totals->invalidations;
+    return ERR_NONE;
+}
+
+// the commands between context switches or invalidations are simulated as batches of their own
+static int simulate_commands(void* mem_space, size_t mem_size, hierarchy_t* hrchy, batch_t* batch,
+                             const command_t* commands, size_t nb_commands,
+                             size_t prefetch_distance, totals_t* totals, sim_stats_t* stats)
+{
+    size_t start = 0;
+    for (size_t i = 0; i <= nb_commands; ++i) {
+        if (i < nb_commands && commands[i].order != SWITCH && commands[i].order != INVALIDATE) {
+            continue;
+        }
+        if (i > start) {
+            M_EXIT_IF_ERR(simulate_batch(mem_space, hrchy, batch, commands + start, i - start,
+                                         prefetch_distance, totals, stats), "simulating batch");
+        }
+        if (i < nb_commands && commands[i].order == SWITCH) {
+            M_EXIT_IF_ERR(context_switch(hrchy, commands[i].write_data, mem_size, totals), "switching context");
+        } else if (i < nb_commands) {
+            M_EXIT_IF_ERR(invalidate(hrchy, &commands[i], totals), "invalidating");
+        }
+        start = i + 1;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+struct machine;
+
+typedef struct {
+    hierarchy_t hrchy;
+    batch_t batch;
+    command_t* buffer; // commands of this core out of a trace batch, with several cores
+    const command_t* commands; // to simulate next
+    size_t nb_commands;
+    totals_t totals;
+    sim_stats_t stats;
+    int err; // of the last commands
+    struct machine* machine;
+} core_t;
+
+typedef struct machine {
+    void* mem_space;
+    size_t mem_size;
+    core_t* cores;
+    size_t nb_cores;
+    size_t prefetch_distance;
+    bool with_stats;
+    cache_replace_t replace;
+    cache_write_t write_policy;
+    uint64_t written_back; // dirty lines, once the whole trace has been simulated
+    void* l2_cache;
+    coherence_t coherence; // with several cores
+    bool threaded; // one host thread per core, started by the barriers
+    pthread_barrier_t start; // of the commands of every core
+    pthread_barrier_t done;
+    bool started; // every thread, otherwise those started stop at once
+    bool stop; // seen by the threads at the start barrier, to end
+    pthread_t* threads;
+} machine_t;
+
+static void run_core(core_t* core)
+{
+    const machine_t* const machine = core->machine;
+    core->err = simulate_commands(machine->mem_space, machine->mem_size, &core->hrchy, &core->batch,
+                                  core->commands, core->nb_commands, machine->prefetch_distance, &core->totals,
+                                  machine->with_stats ? &core->stats : NULL);
+}
+
+static void* core_thread(void* arg)
+{
+    core_t* const core = arg;
+    machine_t* const machine = core->machine;
+    // until every thread is started (see machine_init())
+    pthread_mutex_lock(&machine->coherence.bus);
+    const bool started = machine->started;
+    pthread_mutex_unlock(&machine->coherence.bus);
+    while (started) {
+        pthread_barrier_wait(&machine->start);
+        if (machine->stop) {
+            break;
+        }
+        run_core(core);
+        pthread_barrier_wait(&machine->done);
+    }
+    return NULL;
+}
+
+static int core_init(core_t* core, machine_t* machine, bool flush_on_switch)
+{
+    core->machine = machine;
+    hierarchy_t* const hrchy = &core->hrchy;
+    tlb_flush(hrchy->l1_itlb, L1_ITLB);
+    tlb_flush(hrchy->l1_dtlb, L1_DTLB);
+    tlb_flush(hrchy->l2_tlb, L2_TLB);
+    page_walk_cache_flush(&hrchy->pwc);
+    hrchy->cr3 = 0;
+    hrchy->flush_on_switch = flush_on_switch;
+    hrchy->l2_cache = machine->l2_cache;
+    hrchy->coherence = (machine->nb_cores > 1) ? &machine->coherence : NULL;
+    hrchy->core = (size_t) (core - machine->cores);
+    hrchy->replace = machine->replace;
+    hrchy->write_policy = machine->write_policy;
+    hrchy->l1_icache = calloc(1, L1_ICACHE_SIZE);
+    hrchy->l1_dcache = calloc(1, L1_DCACHE_SIZE);
+    // a single core simulates the batches of the trace as they are
+    core->buffer = (machine->nb_cores > 1) ? calloc(PROGRAM_STREAM_BATCH, sizeof(command_t)) : NULL;
+    if (hrchy->l1_icache == NULL || hrchy->l1_dcache == NULL || (machine->nb_cores > 1 && core->buffer == NULL)) {
+        return ERR_MEM;
+    }
+    if (hrchy->coherence != NULL) {
+        M_EXIT_IF_ERR(coherence_attach(hrchy->coherence, hrchy->core, hrchy->l1_icache, hrchy->l1_dcache),
+                      "attaching caches");
+    }
+    M_EXIT_IF_ERR(batch_alloc(&core->batch, PROGRAM_STREAM_BATCH), "allocating batch");
+    // statistics are only recorded when printed
+    return machine->with_stats ? stats_init(&core->stats) : ERR_NONE;
+}
+
+// also of a core not (fully) initialized, allocated by calloc()
+static void core_free(core_t* core, bool with_stats)
+{
+    free(core->hrchy.l1_icache);
+    free(core->hrchy.l1_dcache);
+    free(core->buffer);
+    batch_free(&core->batch);
+    if (with_stats) {
+        stats_free(&core->stats);
+    }
+}
+
+static void machine_free(machine_t* machine)
+{
+    if (machine->threads != NULL) {
+        machine->stop = true;
+        pthread_barrier_wait(&machine->start);
+        for (size_t c = 0; c < machine->nb_cores; ++c) {
+            pthread_join(machine->threads[c], NULL);
+        }
+        free(machine->threads);
+        pthread_barrier_destroy(&machine->start);
+        pthread_barrier_destroy(&machine->done);
+    }
+    for (size_t c = 0; machine->cores != NULL && c < machine->nb_cores; ++c) {
+        core_free(&machine->cores[c], machine->with_stats);
+    }
+    free(machine->cores);
+    free(machine->l2_cache);
+    coherence_free(&machine->coherence);
+}
+
+static int machine_init(machine_t* machine, void* mem_space, size_t mem_size, size_t nb_cores,
+                        bool flush_on_switch, cache_replace_t replace, cache_write_t write_policy,
+                        size_t prefetch_distance, bool with_stats)
+{
+    memset(machine, 0, sizeof(machine_t));
+    machine->mem_space = mem_space;
+    machine->mem_size = mem_size;
+    machine->nb_cores = nb_cores;
+    machine->prefetch_distance = prefetch_distance;
+    machine->with_stats = with_stats;
+    machine->replace = replace;
+    machine->write_policy = write_policy;
+#ifdef HEATMAP
+    // the heatmap counters are not thread-safe
+    machine->threaded = false;
+#else
+    machine->threaded = (nb_cores > 1);
+#endif
+    machine->l2_cache = calloc(1, L2_CACHE_SIZE);
+    machine->cores = calloc(nb_cores, sizeof(core_t));
+    if (machine->l2_cache == NULL || machine->cores == NULL
+        || (nb_cores > 1 && coherence_init(&machine->coherence, nb_cores) != ERR_NONE)) {
+        machine->nb_cores = 0;
+        machine_free(machine);
+        return ERR_MEM;
+    }
+
+    int err = ERR_NONE;
+    for (size_t c = 0; err == ERR_NONE && c < nb_cores; ++c) {
+        err = core_init(&machine->cores[c], machine, flush_on_switch);
+    }
+    if (err == ERR_NONE && machine->threaded) {
+        // the threads hold on the bus, so that they all stop if one cannot be started
+        pthread_mutex_lock(&machine->coherence.bus);
+        machine->threads = calloc(nb_cores, sizeof(pthread_t));
+        size_t started = 0;
+        while (machine->threads != NULL && started < nb_cores
+               && pthread_create(&machine->threads[started], NULL, core_thread, &machine->cores[started]) == 0) {
+            ++started;
+        }
+        if (started == nb_cores) {
+            pthread_barrier_init(&machine->start, NULL, (unsigned) nb_cores + 1);
+            pthread_barrier_init(&machine->done, NULL, (unsigned) nb_cores + 1);
+            machine->started = true;
+        } else {
+            err = ERR_MEM;
+        }
+        pthread_mutex_unlock(&machine->coherence.bus);
+        for (size_t c = 0; err != ERR_NONE && c < started; ++c) {
+            pthread_join(machine->threads[c], NULL);
+        }
+        if (err != ERR_NONE) {
+            free(machine->threads);
+            machine->threads = NULL;
+        }
+    }
+    if (err != ERR_NONE) {
+        machine_free(machine);
+    }
+    return err;
+}
+
+// handing every core its commands out of a trace batch, then running all of them
+static int simulate_cores(machine_t* machine, const command_t* commands, size_t nb_commands)
+{
+    core_t* const cores = machine->cores;
+    if (machine->nb_cores == 1) {
+        cores[0].commands = commands;
+        cores[0].nb_commands = nb_commands;
+    } else {
+        for (size_t c = 0; c < machine->nb_cores; ++c) {
+            cores[c].commands = cores[c].buffer;
+            cores[c].nb_commands = 0;
+        }
+    }
+    for (size_t i = 0; i < nb_commands; ++i) {
+        const uint8_t c = commands[i].core;
+        M_REQUIRE(c < machine->nb_cores, ERR_BAD_PARAMETER, "command of core %u on %zu cores", c, machine->nb_cores);
+        if (machine->nb_cores > 1) {
+            cores[c].buffer[cores[c].nb_commands++] = commands[i];
+        }
+    }
+
+    if (machine->threaded) {
+        pthread_barrier_wait(&machine->start);
+        pthread_barrier_wait(&machine->done);
+    } else {
+        for (size_t c = 0; c < machine->nb_cores; ++c) {
+            run_core(&cores[c]);
+        }
+    }
+    for (size_t c = 0; c < machine->nb_cores; ++c) {
+        M_EXIT_IF_ERR(cores[c].err, "simulating core");
+    }
+    return ERR_NONE;
+}
+
+static int simulate(const char* trace_filename, machine_t* machine)
+{
+    program_stream_t stream;
+    M_EXIT_IF_ERR(program_stream_open(trace_filename, &stream, PROGRAM_STREAM_BATCH), "opening trace");
+
+    int err = ERR_NONE;
+    const command_t* commands = NULL;
+    size_t nb_commands = 0;
+    while ((err = program_stream_next(&stream, &commands, &nb_commands)) == ERR_NONE && nb_commands > 0) {
+        err = simulate_cores(machine, commands, nb_commands);
+        if (err != ERR_NONE) {
+            break;
+        }
+    }
+
+    program_stream_close(&stream);
+    return err;
+}
+
+// the dirty lines left in the caches of every core, then in the shared L2 cache
+static int write_back_caches(machine_t* machine)
+{
+    for (size_t c = 0; c < machine->nb_cores; ++c) {
+        const hierarchy_t* const hrchy = &machine->cores[c].hrchy;
+        M_EXIT_IF_ERR(cache_write_back(machine->mem_space, hrchy->l1_icache, L1_ICACHE, &machine->written_back),
+                      "writing back L1 ICACHE");
+        M_EXIT_IF_ERR(cache_write_back(machine->mem_space, hrchy->l1_dcache, L1_DCACHE, &machine->written_back),
+                      "writing back L1 DCACHE");
+    }
+    return cache_write_back(machine->mem_space, machine->l2_cache, L2_CACHE, &machine->written_back);
+}
+
+#ifdef HEATMAP
+static int write_heatmap(const char* filename)
+{
+    FILE* output = fopen(filename, "wb");
+    if (output == NULL) {
+        return ERR_IO;
+    }
+    const size_t length = strlen(filename);
+    const int err = (length >= 4 && !strcmp(filename + length - 4, ".csv"))
+                    ? heatmap_print_csv(output) : heatmap_write_bin(output);
+    return (fclose(output) != 0 && err == ERR_NONE) ? ERR_IO : err;
+}
+#endif
+
+// ======================================================================
+// the totals of every core, read checksums chained in core order
+static void sum_totals(const machine_t* machine, totals_t* totals, page_walk_cache_t* pwc)
+{
+    memset(totals, 0, sizeof(totals_t));
+    memset(pwc, 0, sizeof(page_walk_cache_t));
+    for (size_t c = 0; c < machine->nb_cores; ++c) {
+        const totals_t* const core = &machine->cores[c].totals;
+        const page_walk_cache_t* const core_pwc = &machine->cores[c].hrchy.pwc;
+        totals->commands += core->commands;
+        totals->fetches += core->fetches;
+        totals->reads += core->reads;
+        totals->writes += core->writes;
+        totals->tlb_hits += core->tlb_hits;
+        totals->tlb_misses += core->tlb_misses;
+        totals->switches += core->switches;
+        totals->invalidations += core->invalidations;
+        totals->checksum = (machine->nb_cores > 1) ? totals->checksum * 31 + core->checksum : core->checksum;
+        for (size_t level = 0; level < PWC_LEVELS; ++level) {
+            pwc->hits[level] += core_pwc->hits[level];
+            pwc->misses[level] += core_pwc->misses[level];
+        }
+        pwc->walks += core_pwc->walks;
+        pwc->loads += core_pwc->loads;
+    }
+}
+
+static void print_totals(FILE* output, const machine_t* machine)
+{
+    totals_t totals_sum;
+    page_walk_cache_t pwc_sum;
+    sum_totals(machine, &totals_sum, &pwc_sum);
+    const totals_t* const totals = &totals_sum;
+    const page_walk_cache_t* const pwc = &pwc_sum;
+    fprintf(output, "commands:            %" PRIu64 "\n", totals->commands);
+    fprintf(output, "instruction fetches: %" PRIu64 "\n", totals->fetches);
+    fprintf(output, "data reads:          %" PRIu64 "\n", totals->reads);
+    fprintf(output, "data writes:         %" PRIu64 "\n", totals->writes);
+    fprintf(output, "TLB hits:            %" PRIu64 "\n", totals->tlb_hits);
+    fprintf(output, "TLB misses:          %" PRIu64 "\n", totals->tlb_misses);
+    fprintf(output, "context switches:    %" PRIu64 " (%s)\n", totals->switches,
+            machine->cores[0].hrchy.flush_on_switch ? "flushing TLBs" : "ASID-tagged TLBs");
+    fprintf(output, "invalidations:       %" PRIu64 "\n", totals->invalidations);
+    fprintf(output, "page walks:          %" PRIu64 " (%" PRIu64 " entries read)\n", pwc->walks, pwc->loads);
+    fprintf(output, "PWC PMD/PUD/PGD:     %" PRIu64 "/%" PRIu64 "/%" PRIu64 " hits, %" PRIu64 "/%" PRIu64 "/%" PRIu64 " misses\n",
+            pwc->hits[PWC_PMD], pwc->hits[PWC_PUD], pwc->hits[PWC_PGD],
+            pwc->misses[PWC_PMD], pwc->misses[PWC_PUD], pwc->misses[PWC_PGD]);
+    if (machine->write_policy == WRITE_BACK) {
+        fprintf(output, "write-back:          %" PRIu64 " dirty lines left at the end\n", machine->written_back);
+    }
+    fprintf(output, "read checksum:       0x%08" PRIx32 "\n", totals->checksum);
+    if (machine->nb_cores == 1) {
+        return;
+    }
+    coherence_stats_t coherence = { 0, 0, 0 };
+    for (size_t c = 0; c < machine->nb_cores; ++c) {
+        coherence.invalidations += machine->coherence.stats[c].invalidations;
+        coherence.upgrades += machine->coherence.stats[c].upgrades;
+        coherence.transfers += machine->coherence.stats[c].transfers;
+    }
+    fprintf(output, "coherence:           %" PRIu64 " invalidations, %" PRIu64 " upgrades, %" PRIu64 " cache-to-cache transfers\n",
+            coherence.invalidations, coherence.upgrades, coherence.transfers);
+    for (size_t c = 0; c < machine->nb_cores; ++c) {
+        const totals_t* const core = &machine->cores[c].totals;
+        const coherence_stats_t* const core_coherence = &machine->coherence.stats[c];
+        fprintf(output, "core %3zu:            %" PRIu64 " commands, %" PRIu64 " TLB misses, %" PRIu64 " invalidations, %"
+                PRIu64 " upgrades, %" PRIu64 " transfers, read checksum 0x%08" PRIx32 "\n",
+                c, core->commands, core->tlb_misses, core_coherence->invalidations, core_coherence->upgrades,
+                core_coherence->transfers, core->checksum);
+    }
+}
+
+// the statistics of every core, their kinds of misses being those of their core
+static int print_stats(FILE* output, const machine_t* machine, const char* format)
+{
+    sim_stats_t stats;
+    memset(&stats, 0, sizeof(sim_stats_t));
+    for (size_t c = 0; c < machine->nb_cores; ++c) {
+        M_EXIT_IF_ERR(stats_merge(&stats, &machine->cores[c].stats), "merging statistics");
+    }
+    stats.memory_writes += machine->written_back;
+    return !strcmp(format, "csv") ? stats_print_csv(output, &stats) : stats_print_json(output, &stats);
+}
+
+// names of the replacement policies given with --policy
+static const struct {
+    const char* name;
+    cache_replace_t replace;
+} POLICIES[] = {
+    { "lru", LRU },
+    { "plru", PLRU },
+    { "srrip", SRRIP },
+    { "brrip", BRRIP },
+    { "random", RANDOM }
+};
+#define NB_POLICIES (sizeof(POLICIES) / sizeof(POLICIES[0]))
+
+static bool policy_parse(const char* name, cache_replace_t* replace)
+{
+    for (size_t i = 0; i < NB_POLICIES; ++i) {
+        if (!strcmp(name, POLICIES[i].name)) {
+            *replace = POLICIES[i].replace;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    const char* const program_name = argv[0];
+    bool flush_on_switch = false;
+    cache_replace_t replace = LRU;
+    cache_write_t write_policy = WRITE_THROUGH;
+    size_t nb_cores = 1;
+    bool bad_option = false;
+    while (argc > 1 && !strncmp(argv[1], "--", 2) && !bad_option) {
+        if (!strcmp(argv[1], "--flush")) {
+            flush_on_switch = true;
+        } else if (!strcmp(argv[1], "--write-back")) {
+            write_policy = WRITE_BACK;
+        } else if (!strcmp(argv[1], "--cores") && argc > 2) {
+            nb_cores = strtoul(argv[2], NULL, 10);
+            --argc;
+            ++argv;
+        } else if (!strcmp(argv[1], "--policy") && argc > 2) {
+            bad_option = !policy_parse(argv[2], &replace);
+            --argc;
+            ++argv;
+        } else {
+            bad_option = true;
+        }
+        --argc;
+        ++argv;
+    }
+    const char* const format = (argc > 4) ? argv[4] : NULL;
+    if (bad_option || nb_cores == 0 || nb_cores > SIMULATE_MAX_CORES || argc < 3
+        || (format != NULL && strcmp(format, "csv") && strcmp(format, "json"))) {
+        fprintf(stderr, "usage:    %s [--flush] [--cores nb_cores] [--write-back] [--policy policy] trace_filename"
+                " memory_dump [prefetch_distance [csv|json]]\n",
+                program_name);
+        fprintf(stderr, "example:  %s commands.bin memory_dump.bin %d csv\n", program_name,
+                CACHE_BATCH_PREFETCH_DISTANCE);
+        fprintf(stderr, "at most %d cores, numbered in the trace\n", SIMULATE_MAX_CORES);
+        fprintf(stderr, "policies:");
+        for (size_t i = 0; i < NB_POLICIES; ++i) {
+            fprintf(stderr, " %s", POLICIES[i].name);
+        }
+        fputc('\n', stderr);
+#ifdef HEATMAP
+        fprintf(stderr, "the format may be followed by a heatmap file (\".csv\" or binary)\n");
+#endif
+        return 1;
+    }
+    const size_t prefetch_distance = (argc > 3) ? strtoul(argv[3], NULL, 10) : 0;
+
+    // a private mapping: writes of the trace never reach the dump file
+    void* mem_space = NULL;
+    size_t mem_size = 0;
+    if (mem_init_from_dumpfile_mmap(argv[2], &mem_space, &mem_size) != ERR_NONE) {
+        fprintf(stderr, "Cannot read memory dump from \"%s\".\n", argv[2]);
+        return 2;
+    }
+
+    machine_t machine;
+    int err = machine_init(&machine, mem_space, mem_size, nb_cores, flush_on_switch, replace, write_policy,
+                           prefetch_distance, format != NULL);
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Cannot set up %zu cores: %s\n", nb_cores, ERR_MESSAGES[err - ERR_NONE]);
+        mem_release_mmap(mem_space, mem_size);
+        return 3;
+    }
+    err = simulate(argv[1], &machine);
+    if (err == ERR_NONE && write_policy == WRITE_BACK) {
+        err = write_back_caches(&machine);
+    }
+
+    if (err == ERR_NONE) {
+        print_totals(stdout, &machine);
+        if (format != NULL) {
+            err = print_stats(stdout, &machine, format);
+        }
+#ifdef HEATMAP
+        if (argc > 5 && write_heatmap(argv[5]) != ERR_NONE) {
+            fprintf(stderr, "Cannot write heatmap to \"%s\".\n", argv[5]);
+            err = ERR_IO;
+        }
+        heatmap_free();
+#endif
+    } else {
+        uint64_t nb_simulated = 0;
+        for (size_t c = 0; c < machine.nb_cores; ++c) {
+            nb_simulated += machine.cores[c].totals.commands;
+        }
+        fprintf(stderr, "Simulation of \"%s\" failed after %" PRIu64 " commands: %s\n",
+                argv[1], nb_simulated, ERR_MESSAGES[err - ERR_NONE]);
+    }
+
+    machine_free(&machine);
+    mem_release_mmap(mem_space, mem_size);
+    return (err == ERR_NONE) ? EXIT_SUCCESS : 3;
+}
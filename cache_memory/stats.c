@@ -0,0 +1,274 @@
+/**
+ * @file stats.c
+ * @brief hit, miss and eviction counters of the TLB and cache hierarchies
+ */
+
+#include "stats.h"
+#include "tlb_hrchy.h"
+#include "cache.h"
+#include "error.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h> // for PRIu64
+
+#define STATS_NONE ((uint32_t) -1)
+#define STATS_SEEN_INITIAL_BITS 12
+#define FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull // 2^64 / golden ratio
+
+static const char* const LEVEL_NAMES[STATS_LEVELS] = {
+	"l1_itlb", "l1_dtlb", "l2_tlb", "l1_icache", "l1_dcache", "l2_cache"
+};
+
+static const uint32_t LEVEL_ENTRIES[STATS_LEVELS] = {
+	L1_ITLB_LINES * L1_ITLB_WAYS, L1_DTLB_LINES * L1_DTLB_WAYS, L2_TLB_LINES * L2_TLB_WAYS,
+	L1_ICACHE_LINES * L1_ICACHE_WAYS, L1_DCACHE_LINES * L1_DCACHE_WAYS, L2_CACHE_LINES * L2_CACHE_WAYS
+};
+
+static inline size_t home_slot(uint64_t key, size_t bits){
+	return (size_t)((key * FIBONACCI_MULTIPLIER) >> (64 - bits));
+}
+
+// ======================================================================
+//set of the keys ever referenced (open addressing, never shrinks)
+
+//adding a key, true if it was not in the set yet
+static bool seen_insert(uint64_t* seen, size_t bits, uint64_t key){
+	const size_t mask = ((size_t) 1 << bits) - 1;
+	size_t slot = home_slot(key, bits);
+	while(seen[slot] != 0){
+		if(seen[slot] == key + 1){
+			return false;
+		}
+		slot = (slot + 1) & mask;
+	}
+	seen[slot] = key + 1;
+	return true;
+}
+
+//doubling the set once half full
+static int seen_grow(stats_shadow_t* shadow){
+	const size_t bits = shadow->seen_bits + 1;
+	uint64_t* const seen = calloc((size_t) 1 << bits, sizeof(uint64_t));
+	if(seen == NULL){
+		return ERR_MEM;
+	}
+	for(size_t slot = 0; slot < ((size_t) 1 << shadow->seen_bits); ++slot){
+		if(shadow->seen[slot] != 0){
+			(void) seen_insert(seen, bits, shadow->seen[slot] - 1);
+		}
+	}
+	free(shadow->seen);
+	shadow->seen = seen;
+	shadow->seen_bits = bits;
+	return ERR_NONE;
+}
+
+// ======================================================================
+//fully associative LRU shadow: the hash finds the entry of a key, the lists keep their order
+
+static uint32_t shadow_find(const stats_shadow_t* shadow, uint64_t key, size_t* p_slot){
+	const size_t mask = ((size_t) 1 << shadow->slot_bits) - 1;
+	size_t slot = home_slot(key, shadow->slot_bits);
+	while(shadow->slots[slot] != STATS_NONE && shadow->keys[shadow->slots[slot]] != key){
+		slot = (slot + 1) & mask;
+	}
+	*p_slot = slot;
+	return shadow->slots[slot];
+}
+
+//removing the slot of a key, shifting back the following ones (no tombstones)
+static void shadow_unhash(stats_shadow_t* shadow, size_t hole){
+	const size_t mask = ((size_t) 1 << shadow->slot_bits) - 1;
+	for(size_t slot = (hole + 1) & mask; shadow->slots[slot] != STATS_NONE; slot = (slot + 1) & mask){
+		const size_t home = home_slot(shadow->keys[shadow->slots[slot]], shadow->slot_bits);
+		//the entry may move back to the hole if its home is not in (hole, slot]
+		if(((slot - home) & mask) >= ((slot - hole) & mask)){
+			shadow->slots[hole] = shadow->slots[slot];
+			hole = slot;
+		}
+	}
+	shadow->slots[hole] = STATS_NONE;
+}
+
+static void shadow_unlink(stats_shadow_t* shadow, uint32_t entry){
+	const uint32_t previous = shadow->previous[entry];
+	const uint32_t next = shadow->next[entry];
+	if(previous == STATS_NONE) shadow->head = next;
+	else shadow->next[previous] = next;
+	if(next == STATS_NONE) shadow->tail = previous;
+	else shadow->previous[next] = previous;
+}
+
+static void shadow_push_back(stats_shadow_t* shadow, uint32_t entry){
+	shadow->previous[entry] = shadow->tail;
+	shadow->next[entry] = STATS_NONE;
+	if(shadow->tail == STATS_NONE) shadow->head = entry;
+	else shadow->next[shadow->tail] = entry;
+	shadow->tail = entry;
+}
+
+//referencing a key, true if the shadow hits
+static bool shadow_access(stats_shadow_t* shadow, uint64_t key){
+	size_t slot = 0;
+	uint32_t entry = shadow_find(shadow, key, &slot);
+	if(entry != STATS_NONE){
+		shadow_unlink(shadow, entry);
+		shadow_push_back(shadow, entry);
+		return true;
+	}
+
+	if(shadow->size < shadow->capacity){
+		entry = shadow->size++;
+	}else{
+		//the least recently used entry leaves
+		entry = shadow->head;
+		size_t evicted_slot = 0;
+		(void) shadow_find(shadow, shadow->keys[entry], &evicted_slot);
+		shadow_unhash(shadow, evicted_slot);
+		shadow_unlink(shadow, entry);
+		(void) shadow_find(shadow, key, &slot);
+	}
+	shadow->keys[entry] = key;
+	shadow->slots[slot] = entry;
+	shadow_push_back(shadow, entry);
+	return false;
+}
+
+static void shadow_free(stats_shadow_t* shadow){
+	free(shadow->keys);
+	free(shadow->previous);
+	free(shadow->next);
+	free(shadow->slots);
+	free(shadow->seen);
+	zero_init_ptr(shadow);
+}
+
+static int shadow_init(stats_shadow_t* shadow, uint32_t capacity){
+	zero_init_ptr(shadow);
+	shadow->capacity = capacity;
+	shadow->head = STATS_NONE;
+	shadow->tail = STATS_NONE;
+	//at least twice as many slots as entries
+	shadow->slot_bits = 1;
+	while(((uint32_t) 1 << shadow->slot_bits) < 2 * capacity){
+		++shadow->slot_bits;
+	}
+	shadow->seen_bits = STATS_SEEN_INITIAL_BITS;
+
+	shadow->keys = calloc(capacity, sizeof(uint64_t));
+	shadow->previous = calloc(capacity, sizeof(uint32_t));
+	shadow->next = calloc(capacity, sizeof(uint32_t));
+	shadow->slots = malloc(((size_t) 1 << shadow->slot_bits) * sizeof(uint32_t));
+	shadow->seen = calloc((size_t) 1 << shadow->seen_bits, sizeof(uint64_t));
+	if(shadow->keys == NULL || shadow->previous == NULL || shadow->next == NULL
+		|| shadow->slots == NULL || shadow->seen == NULL){
+		shadow_free(shadow);
+		return ERR_MEM;
+	}
+	memset(shadow->slots, 0xFF, ((size_t) 1 << shadow->slot_bits) * sizeof(uint32_t));
+	return ERR_NONE;
+}
+
+// ======================================================================
+int stats_init(sim_stats_t* stats){
+	M_REQUIRE_NON_NULL(stats);
+
+	zero_init_ptr(stats);
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		const int err = shadow_init(&stats->shadows[level], LEVEL_ENTRIES[level]);
+		if(err != ERR_NONE){
+			stats_free(stats);
+			return err;
+		}
+	}
+	return ERR_NONE;
+}
+
+int stats_free(sim_stats_t* stats){
+	M_REQUIRE_NON_NULL(stats);
+
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		shadow_free(&stats->shadows[level]);
+	}
+	return ERR_NONE;
+}
+
+void stats_access(sim_stats_t* stats, stats_level_t level, uint64_t key, bool hit){
+	stats_shadow_t* const shadow = &stats->shadows[level];
+	level_stats_t* const counters = &stats->levels[level];
+
+	const bool shadow_hit = shadow_access(shadow, key);
+	//once the set cannot grow, keys are no longer told apart: misses are never compulsory
+	bool first = false;
+	if(shadow->seen != NULL && (2 * (shadow->nb_seen + 1) <= ((size_t) 1 << shadow->seen_bits)
+		|| seen_grow(shadow) == ERR_NONE)){
+		first = seen_insert(shadow->seen, shadow->seen_bits, key);
+		shadow->nb_seen += first;
+	}
+
+	if(hit){
+		++counters->hits;
+		return;
+	}
+	++counters->misses;
+	if(first){
+		++counters->compulsory;
+	}else if(shadow_hit){
+		++counters->conflict;
+	}else{
+		++counters->capacity;
+	}
+}
+
+int stats_merge(sim_stats_t* total, const sim_stats_t* stats){
+	M_REQUIRE_NON_NULL(total);
+	M_REQUIRE_NON_NULL(stats);
+
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		level_stats_t* const sum = &total->levels[level];
+		const level_stats_t* const counters = &stats->levels[level];
+		sum->hits += counters->hits;
+		sum->misses += counters->misses;
+		sum->compulsory += counters->compulsory;
+		sum->capacity += counters->capacity;
+		sum->conflict += counters->conflict;
+		sum->evictions += counters->evictions;
+	}
+	total->victims += stats->victims;
+	total->memory_writes += stats->memory_writes;
+	return ERR_NONE;
+}
+
+// ======================================================================
+int stats_print_csv(FILE* output, const sim_stats_t* stats){
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(output, ERR_IO);
+	M_REQUIRE_NON_NULL(stats);
+
+	fputs("level,hits,misses,compulsory,capacity,conflict,evictions\n", output);
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		const level_stats_t* const counters = &stats->levels[level];
+		fprintf(output, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+			LEVEL_NAMES[level], counters->hits, counters->misses, counters->compulsory,
+			counters->capacity, counters->conflict, counters->evictions);
+	}
+	fprintf(output, "victims,%" PRIu64 "\nmemory_writes,%" PRIu64 "\n", stats->victims, stats->memory_writes);
+	return ERR_NONE;
+}
+
+int stats_print_json(FILE* output, const sim_stats_t* stats){
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(output, ERR_IO);
+	M_REQUIRE_NON_NULL(stats);
+
+	fputs("{\n", output);
+	for(size_t level = 0; level < STATS_LEVELS; ++level){
+		const level_stats_t* const counters = &stats->levels[level];
+		fprintf(output, "  \"%s\": { \"hits\": %" PRIu64 ", \"misses\": %" PRIu64 ", \"compulsory\": %" PRIu64
+			", \"capacity\": %" PRIu64 ", \"conflict\": %" PRIu64 ", \"evictions\": %" PRIu64 " },\n",
+			LEVEL_NAMES[level], counters->hits, counters->misses, counters->compulsory,
+			counters->capacity, counters->conflict, counters->evictions);
+	}
+	fprintf(output, "  \"victims\": %" PRIu64 ",\n  \"memory_writes\": %" PRIu64 "\n}\n",
+		stats->victims, stats->memory_writes);
+	return ERR_NONE;
+}
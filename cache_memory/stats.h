@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+ * @file stats.h
+ * @brief hit, miss and eviction counters of the TLB and cache hierarchies
+ *
+ * A miss is classified as
+ *   - compulsory: first reference to the page (TLBs) or line (caches) at that level;
+ *   - capacity: a fully associative LRU level of as many entries would miss too;
+ *   - conflict: the others.
+ * The fully associative shadows are hashed, so that recording an access
+ * costs O(1) whatever the size of the level.
+ */
+
+#include <stdint.h>
+#include <stddef.h> // for size_t
+#include <stdbool.h>
+#include <stdio.h> // for FILE
+
+typedef enum{
+	STATS_L1_ITLB, STATS_L1_DTLB, STATS_L2_TLB,
+	STATS_L1_ICACHE, STATS_L1_DCACHE, STATS_L2_CACHE,
+	STATS_LEVELS // not a level, their number
+}stats_level_t;
+
+typedef struct{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t compulsory; // misses, by kind
+	uint64_t capacity;
+	uint64_t conflict;
+	uint64_t evictions; // valid entries replaced
+}level_stats_t;
+
+/**
+ * Fully associative LRU level of the same number of entries, and every key
+ * (page or line number) ever referenced.
+ */
+typedef struct{
+	uint32_t capacity; // number of entries
+	uint32_t size; // entries in use
+	uint64_t* keys; // of the entries
+	uint32_t* previous; // LRU order of the entries, from head (least recent) to tail
+	uint32_t* next;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t* slots; // hash of the keys to the entries, STATS_NONE for a free slot
+	uint32_t slot_bits;
+	uint64_t* seen; // set of the keys ever referenced, key + 1 (0 for a free slot)
+	size_t seen_bits;
+	size_t nb_seen;
+}stats_shadow_t;
+
+typedef struct{
+	level_stats_t levels[STATS_LEVELS];
+	uint64_t victims; // lines evicted from a level 1 cache into level 2
+	uint64_t memory_writes; // lines written to memory: through on every write, or back (see cache_write_t)
+	stats_shadow_t shadows[STATS_LEVELS];
+}sim_stats_t;
+
+//=========================================================================
+/**
+ * @brief Initialize all the counters to 0, each level being as large
+ * as the default TLBs (tlb_hrchy.h) and caches (cache.h).
+ * @param stats (modified) the statistics
+ * @return error code
+ */
+int stats_init(sim_stats_t* stats);
+
+//=========================================================================
+/**
+ * @brief Free the shadows of the statistics.
+ * @param stats the statistics
+ * @return error code
+ */
+int stats_free(sim_stats_t* stats);
+
+//=========================================================================
+/**
+ * @brief Record a reference to a level.
+ * @param stats the statistics
+ * @param level the level referenced
+ * @param key page of an address space (TLBs, see TLB_PAGE_KEY()) or physical line number (caches)
+ * @param hit whether the level hit
+ */
+void stats_access(sim_stats_t* stats, stats_level_t level, uint64_t key, bool hit);
+
+//=========================================================================
+/**
+ * @brief Add the counters of statistics to others, e.g. those of every core
+ * to the totals; the shadows of the totals are left as they are, so misses
+ * keep the kind of their own statistics.
+ * @param total (modified) the statistics to add to
+ * @param stats the statistics added
+ * @return error code
+ */
+int stats_merge(sim_stats_t* total, const sim_stats_t* stats);
+
+//=========================================================================
+/**
+ * @brief Print the counters as CSV, one line per level, then the totals.
+ * @param output the stream to print to
+ * @param stats the statistics
+ * @return error code
+ */
+int stats_print_csv(FILE* output, const sim_stats_t* stats);
+
+//=========================================================================
+/**
+ * @brief Print the counters as a JSON object.
+ * @param output the stream to print to
+ * @param stats the statistics
+ * @return error code
+ */
+int stats_print_json(FILE* output, const sim_stats_t* stats);
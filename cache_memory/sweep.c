@@ -0,0 +1,330 @@
+/**
+ * @file sweep.c
+ * @brief Simulation of one trace on several cache configurations concurrently
+ */
+
+//for pthreads with -std=c11
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // for strcasecmp()
+#include <inttypes.h> // for PRIu64
+#include <stdatomic.h>
+#include <pthread.h>
+#include "sweep.h"
+#include "cache_mng.h"
+#include "rt_cache_mng.h"
+#include "commands.h"
+#include "memory.h"
+#include "page_walk.h"
+#include "addr_mng.h"
+#include "error.h"
+#include "util.h"
+
+#define SWEEP_INITIAL_SIZE 1024
+
+//everything a worker thread needs
+typedef struct{
+	const sweep_trace_t* trace;
+	const char* dump_filename;
+	const sweep_config_t* configs;
+	sweep_result_t* results;
+	size_t nb_configs;
+	atomic_size_t next_config;
+}sweep_job_t;
+
+int sweep_trace_load(const char* filename, const void* mem_space, size_t mem_size, sweep_trace_t* trace){
+
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM);
+	M_REQUIRE_NON_NULL(trace);
+
+	zero_init_ptr(trace);
+
+	program_stream_t stream;
+	M_EXIT_IF_ERR(program_stream_open(filename, &stream, PROGRAM_STREAM_BATCH), "opening trace");
+
+	const command_t* batch = NULL;
+	size_t nb_lines = 0;
+	int err = ERR_NONE;
+	uint32_t cr3 = 0; // of the address space running
+
+	do{
+		err = program_stream_next(&stream, &batch, &nb_lines);
+
+		if(err == ERR_NONE && trace->nb_accesses + nb_lines > trace->allocated){
+			size_t allocated = (trace->allocated == 0) ? SWEEP_INITIAL_SIZE : trace->allocated;
+			while(allocated < trace->nb_accesses + nb_lines){
+				allocated *= 2;
+			}
+			sweep_access_t* const accesses = realloc(trace->accesses, allocated * sizeof(sweep_access_t));
+			if(accesses == NULL){
+				err = ERR_MEM;
+			}else{
+				trace->accesses = accesses;
+				trace->allocated = allocated;
+			}
+		}
+
+		for(size_t i = 0; i < nb_lines && err == ERR_NONE; ++i){
+			//caches are physical: context switches only change the translations
+			//and invalidations do not change them
+			if(batch[i].order == SWITCH){
+				cr3 = batch[i].write_data;
+				err = page_walk_check_cr3(cr3, mem_size);
+				continue;
+			}
+			if(batch[i].order == INVALIDATE){
+				continue;
+			}
+			phy_addr_t paddr;
+			err = page_walk_cached(mem_space, cr3, &batch[i].vaddr, &paddr, NULL, NULL);
+			if(err != ERR_NONE){
+				break;
+			}
+
+			sweep_access_t* const access = &trace->accesses[trace->nb_accesses];
+			access->paddr = convert_paddr((&paddr));
+			access->write_data = batch[i].write_data;
+			access->order = (uint8_t) batch[i].order;
+			access->type = (uint8_t) batch[i].type;
+			access->data_size = (uint8_t) batch[i].data_size;
+			++trace->nb_accesses;
+		}
+	}while(err == ERR_NONE && nb_lines > 0);
+
+	program_stream_close(&stream);
+
+	if(err != ERR_NONE){
+		sweep_trace_free(trace);
+	}
+	return err;
+}
+
+int sweep_trace_free(sweep_trace_t* trace){
+	M_REQUIRE_NON_NULL(trace);
+
+	free(trace->accesses);
+	trace->accesses = NULL;
+	trace->nb_accesses = 0;
+	trace->allocated = 0;
+
+	return ERR_NONE;
+}
+
+//names of the replacement policies in configuration descriptions
+static const struct{
+	const char* name;
+	cache_replace_t replace;
+}POLICIES[] = {
+	{ "lru", LRU },
+	{ "plru", PLRU },
+	{ "srrip", SRRIP },
+	{ "brrip", BRRIP },
+	{ "random", RANDOM }
+};
+#define NB_POLICIES (sizeof(POLICIES) / sizeof(POLICIES[0]))
+
+//reading one geometry field of a configuration description
+static int config_field_parse(const char* field, size_t len, unsigned int geometry[5]){
+	unsigned int first = 0;
+	unsigned int second = 0;
+	int used = 0;
+
+	if(sscanf(field, "l1=%ux%u%n", &first, &second, &used) == 2 && (size_t) used == len){
+		geometry[0] = first;
+		geometry[1] = second;
+	}else if(sscanf(field, "l2=%ux%u%n", &first, &second, &used) == 2 && (size_t) used == len){
+		geometry[2] = first;
+		geometry[3] = second;
+	}else if(sscanf(field, "line=%u%n", &first, &used) == 1 && (size_t) used == len
+		&& first % sizeof(word_t) == 0){
+		geometry[4] = first / sizeof(word_t);
+	}else{
+		M_EXIT(ERR_BAD_PARAMETER, "bad configuration field %.*s", (int) len, field);
+	}
+
+	return ERR_NONE;
+}
+
+int sweep_config_parse(const char* description, sweep_config_t* config){
+	M_REQUIRE_NON_NULL(description);
+	M_REQUIRE_NON_NULL(config);
+
+	zero_init_ptr(config);
+	strncpy(config->name, description, SWEEP_NAME_LENGTH - 1);
+
+	size_t len = strcspn(description, ":");
+	size_t policy = 0;
+	while(policy < NB_POLICIES && !(len == strlen(POLICIES[policy].name)
+		&& !strncasecmp(description, POLICIES[policy].name, len))){
+		++policy;
+	}
+	M_REQUIRE(policy < NB_POLICIES, ERR_POLICY, "unknown replacement policy in %s", description);
+	config->replace = POLICIES[policy].replace;
+
+	//L1 ways, L1 lines, L2 ways, L2 lines, words per line
+	unsigned int geometry[5] = { L1_ICACHE_WAYS, L1_ICACHE_LINES, L2_CACHE_WAYS, L2_CACHE_LINES, L1_ICACHE_WORDS_PER_LINE };
+	const char* field = description;
+	while(field[len] == ':'){
+		field += len + 1;
+		len = strcspn(field, ":");
+		M_EXIT_IF_ERR(config_field_parse(field, len, geometry), "reading configuration");
+	}
+
+	for(size_t i = 0; i < sizeof(geometry) / sizeof(geometry[0]); ++i){
+		M_REQUIRE(geometry[i] <= UINT16_MAX, ERR_BAD_PARAMETER, "%u is too large in %s", geometry[i], description);
+	}
+	M_EXIT_IF_ERR(cache_desc_init(&config->l1, (uint16_t) geometry[0], (uint16_t) geometry[1], (uint16_t) geometry[4]),
+		"L1 geometry");
+	M_EXIT_IF_ERR(cache_desc_init(&config->l2, (uint16_t) geometry[2], (uint16_t) geometry[3], (uint16_t) geometry[4]),
+		"L2 geometry");
+
+	return ERR_NONE;
+}
+
+//simulating the whole trace on one configuration
+static int simulate(const sweep_trace_t* trace, const char* dump_filename,
+                    const sweep_config_t* config, sweep_result_t* result){
+
+	void* mem_space = NULL;
+	size_t mem_size = 0;
+	//a private mapping: writes of this configuration are seen by no other
+	M_EXIT_IF_ERR(mem_init_from_dumpfile_mmap(dump_filename, &mem_space, &mem_size), "mapping memory");
+
+	rt_cache_t l1_icache, l1_dcache, l2_cache;
+	zero_init_var(l1_icache);
+	zero_init_var(l1_dcache);
+	zero_init_var(l2_cache);
+
+	int err = rt_cache_init(&l1_icache, &config->l1);
+	if(err == ERR_NONE){
+		err = rt_cache_init(&l1_dcache, &config->l1);
+	}
+	if(err == ERR_NONE){
+		err = rt_cache_init(&l2_cache, &config->l2);
+	}
+
+	for(size_t i = 0; i < trace->nb_accesses && err == ERR_NONE; ++i){
+		const sweep_access_t* const access = &trace->accesses[i];
+		rt_cache_t* const l1_cache = (access->type == INSTRUCTION) ? &l1_icache : &l1_dcache;
+
+		phy_addr_t paddr;
+		paddr.phy_page_num = access->paddr >> PAGE_OFFSET;
+		paddr.page_offset = access->paddr % PAGE_SIZE;
+
+		//probing both levels first to know where the access will hit
+		const uint32_t* p_line = NULL;
+		uint8_t hit_way = HIT_WAY_MISS;
+		uint16_t hit_index = HIT_INDEX_MISS;
+
+		err = rt_cache_hit(l1_cache, &paddr, &p_line, &hit_way, &hit_index);
+		if(err == ERR_NONE && hit_way != HIT_WAY_MISS){
+			++result->l1_hits;
+		}else if(err == ERR_NONE){
+			err = rt_cache_hit(&l2_cache, &paddr, &p_line, &hit_way, &hit_index);
+			if(hit_way != HIT_WAY_MISS){
+				++result->l2_hits;
+			}else{
+				++result->misses;
+			}
+		}
+		if(err != ERR_NONE){
+			break;
+		}
+
+		if(access->order == WRITE && access->data_size == sizeof(word_t)){
+			err = rt_cache_write(mem_space, &paddr, l1_cache, &l2_cache, &access->write_data, config->replace);
+		}else if(access->order == WRITE){
+			err = rt_cache_write_byte(mem_space, &paddr, l1_cache, &l2_cache, (uint8_t) access->write_data, config->replace);
+		}else if(access->data_size == sizeof(word_t)){
+			word_t word = 0;
+			err = rt_cache_read(mem_space, &paddr, access->type, l1_cache, &l2_cache, &word, config->replace);
+		}else{
+			uint8_t byte = 0;
+			err = rt_cache_read_byte(mem_space, &paddr, access->type, l1_cache, &l2_cache, &byte, config->replace);
+		}
+		++result->accesses;
+	}
+
+	rt_cache_free(&l1_icache);
+	rt_cache_free(&l1_dcache);
+	rt_cache_free(&l2_cache);
+	mem_release_mmap(mem_space, mem_size);
+
+	return err;
+}
+
+//worker thread: takes configurations until there is none left
+static void* sweep_worker(void* arg){
+	sweep_job_t* const job = arg;
+
+	for(size_t i = atomic_fetch_add(&job->next_config, 1); i < job->nb_configs;
+		i = atomic_fetch_add(&job->next_config, 1)){
+
+		zero_init_var(job->results[i]);
+		job->results[i].err = simulate(job->trace, job->dump_filename, &job->configs[i], &job->results[i]);
+	}
+	return NULL;
+}
+
+int sweep_run(const sweep_trace_t* trace, const char* dump_filename,
+              const sweep_config_t* configs, sweep_result_t* results,
+              size_t nb_configs, size_t nb_threads){
+
+	M_REQUIRE_NON_NULL(trace);
+	M_REQUIRE_NON_NULL(dump_filename);
+	M_REQUIRE_NON_NULL(configs);
+	M_REQUIRE_NON_NULL(results);
+	M_REQUIRE(nb_threads > 0 && nb_threads <= SWEEP_MAX_THREADS, ERR_BAD_PARAMETER,
+		"number of threads must be between 1 and %d", SWEEP_MAX_THREADS);
+
+	sweep_job_t job = {
+		.trace = trace,
+		.dump_filename = dump_filename,
+		.configs = configs,
+		.results = results,
+		.nb_configs = nb_configs
+	};
+	atomic_init(&job.next_config, 0);
+
+	if(nb_threads > nb_configs){
+		nb_threads = nb_configs;
+	}
+
+	pthread_t workers[SWEEP_MAX_THREADS];
+	size_t started = 0;
+	while(started < nb_threads && pthread_create(&workers[started], NULL, sweep_worker, &job) == 0){
+		++started;
+	}
+	//with no thread at all, the calling thread does the job
+	if(started == 0 && nb_configs > 0){
+		sweep_worker(&job);
+	}
+
+	for(size_t i = 0; i < started; ++i){
+		pthread_join(workers[i], NULL);
+	}
+
+	return ERR_NONE;
+}
+
+int sweep_print(FILE* output, const sweep_config_t* configs,
+                const sweep_result_t* results, size_t nb_configs){
+
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(output, ERR_IO);
+	M_REQUIRE_NON_NULL(configs);
+	M_REQUIRE_NON_NULL(results);
+
+	fputs("config,l1_ways,l1_lines,l2_ways,l2_lines,line_bytes,accesses,l1_hits,l2_hits,misses,error\n", output);
+	for(size_t i = 0; i < nb_configs; ++i){
+		fprintf(output, "%s,%u,%u,%u,%u,%zu,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%s\n",
+			configs[i].name, configs[i].l1.ways, configs[i].l1.lines, configs[i].l2.ways, configs[i].l2.lines,
+			configs[i].l1.words_per_line * sizeof(word_t), results[i].accesses, results[i].l1_hits, results[i].l2_hits,
+			results[i].misses, (results[i].err == ERR_NONE) ? "" : ERR_MESSAGES[results[i].err - ERR_NONE]);
+	}
+
+	return ERR_NONE;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/**
+ * @file sweep.h
+ * @brief Simulation of one trace on several cache configurations concurrently
+ *
+ * The trace is translated once into physical accesses, shared read-only by
+ * all the worker threads. Each worker simulates one configuration at a time
+ * on its own L1/L2 caches and its own private copy of the memory.
+ */
+
+#include "cache_mng.h"
+#include "rt_cache.h"
+#include "commands.h"
+#include "mem_access.h"
+#include <stdio.h> // for FILE
+#include <stdint.h>
+
+#define SWEEP_NAME_LENGTH 64
+#define SWEEP_MAX_THREADS 256
+
+/**
+ * @brief One memory access of a trace, already translated.
+ */
+typedef struct{
+	uint32_t paddr; // physical address
+	word_t write_data;
+	uint8_t order; // command_word_t
+	uint8_t type; // mem_access_t
+	uint8_t data_size;
+}sweep_access_t;
+
+typedef struct{
+	sweep_access_t* accesses;
+	size_t nb_accesses;
+	size_t allocated;
+}sweep_trace_t;
+
+/**
+ * @brief One cache configuration to simulate.
+ */
+typedef struct{
+	char name[SWEEP_NAME_LENGTH];
+	cache_replace_t replace;
+	cache_desc_t l1; // geometry of both L1 caches
+	cache_desc_t l2;
+}sweep_config_t;
+
+/**
+ * @brief What a configuration did on the whole trace.
+ */
+typedef struct{
+	uint64_t accesses;
+	uint64_t l1_hits;
+	uint64_t l2_hits;
+	uint64_t misses;
+	int err; // ERR_NONE if the whole trace was simulated
+}sweep_result_t;
+
+//=========================================================================
+/**
+ * @brief Read a trace (text or binary) and translate all its virtual addresses.
+ * @param filename the name of the trace file
+ * @param mem_space the memory holding the page tables
+ * @param mem_size its size in bytes, in which every CR3 of the trace must point
+ * @param trace (modified) the translated trace
+ * @return error code
+ */
+int sweep_trace_load(const char* filename, const void* mem_space, size_t mem_size, sweep_trace_t* trace);
+
+//=========================================================================
+/**
+ * @brief Free the content of a translated trace.
+ * @param trace the trace to free
+ * @return error code
+ */
+int sweep_trace_free(sweep_trace_t* trace);
+
+//=========================================================================
+/**
+ * @brief Read a configuration from its textual description.
+ * The description is the replacement policy ("lru", "plru", "srrip", "brrip"
+ * or "random") optionally followed by
+ * geometry fields, each introduced by ':'
+ *   - l1=WAYSxLINES (both L1 caches), l2=WAYSxLINES
+ *   - line=BYTES (line size of all caches)
+ * e.g. "lru:l1=8x64:l2=16x1024". Missing fields keep the default geometry.
+ * @param description the text to read from
+ * @param config (modified) the configuration
+ * @return error code
+ */
+int sweep_config_parse(const char* description, sweep_config_t* config);
+
+//=========================================================================
+/**
+ * @brief Simulate a trace on several configurations, on a pool of threads.
+ * @param trace the translated trace
+ * @param dump_filename the memory dump each configuration starts from
+ * @param configs the configurations to simulate
+ * @param results (modified) one result per configuration
+ * @param nb_configs number of configurations
+ * @param nb_threads number of worker threads (at most SWEEP_MAX_THREADS)
+ * @return error code; per-configuration errors are reported in results
+ */
+int sweep_run(const sweep_trace_t* trace, const char* dump_filename,
+              const sweep_config_t* configs, sweep_result_t* results,
+              size_t nb_configs, size_t nb_threads);
+
+//=========================================================================
+/**
+ * @brief Print sweep results as CSV, one line per configuration, with its geometry.
+ * @param output the stream to print to
+ * @param configs the simulated configurations
+ * @param results their results
+ * @param nb_configs number of configurations
+ * @return error code
+ */
+int sweep_print(FILE* output, const sweep_config_t* configs,
+                const sweep_result_t* results, size_t nb_configs);
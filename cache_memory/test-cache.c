@@ -0,0 +1,291 @@
+/**
+ * @file test-cache.c
+ * @brief test code for the cache hierarchy of several cores kept coherent (MESI)
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "util.h"
+#include "addr_mng.h"
+#include "cache.h"
+#include "cache_mng.h"
+#include "coherence.h"
+
+// ------------------------------------------------------------
+// Preliminary stuff
+
+#define MEM_SIZE (64 * PAGE_SIZE)
+#define NB_CORES 2
+#define LINE_X 0x1000u // in set 0 of level 1, whose other lines are every 1 kiB
+#define LINE_Y 0x2010u
+#define L1_SET_STRIDE (L1_ICACHE_LINES * L1_ICACHE_LINE)
+
+// two cores sharing a level 2 cache and a memory whose words are 0xAAAA
+typedef struct {
+    uint32_t* mem_space;
+    void* l1_icache[NB_CORES];
+    void* l1_dcache[NB_CORES];
+    void* l2_cache;
+    coherence_t coherence;
+    cache_replace_t replace;
+} machine_t;
+
+static void machine_init(machine_t* machine)
+{
+    machine->mem_space = calloc(MEM_SIZE / sizeof(word_t), sizeof(word_t));
+    ck_assert_ptr_nonnull(machine->mem_space);
+    for (size_t i = 0; i < MEM_SIZE / sizeof(word_t); ++i) {
+        machine->mem_space[i] = 0xAAAA;
+    }
+    machine->replace = LRU;
+    machine->l2_cache = calloc(1, L2_CACHE_SIZE);
+    ck_assert_ptr_nonnull(machine->l2_cache);
+    ck_assert_err_none(coherence_init(&machine->coherence, NB_CORES));
+    for (size_t core = 0; core < NB_CORES; ++core) {
+        machine->l1_icache[core] = calloc(1, L1_ICACHE_SIZE);
+        machine->l1_dcache[core] = calloc(1, L1_DCACHE_SIZE);
+        ck_assert_ptr_nonnull(machine->l1_icache[core]);
+        ck_assert_ptr_nonnull(machine->l1_dcache[core]);
+        ck_assert_err_none(coherence_attach(&machine->coherence, core, machine->l1_icache[core],
+                                            machine->l1_dcache[core]));
+    }
+}
+
+static void machine_free(machine_t* machine)
+{
+    for (size_t core = 0; core < NB_CORES; ++core) {
+        free(machine->l1_icache[core]);
+        free(machine->l1_dcache[core]);
+    }
+    (void)coherence_free(&machine->coherence);
+    free(machine->l2_cache);
+    free(machine->mem_space);
+}
+
+// one word access of a core, returning the word read
+static word_t access_type(machine_t* machine, size_t core, command_word_t order, mem_access_t type, uint32_t phy_addr,
+                          word_t data, cache_write_t write_policy)
+{
+    cache_access_t access;
+    zero_init_var(access);
+    ck_assert_err_none(init_phy_addr(&access.paddr, phy_addr - phy_addr % PAGE_SIZE, phy_addr % PAGE_SIZE));
+    access.data = data;
+    access.order = order;
+    access.type = type;
+    access.data_size = sizeof(word_t);
+    ck_assert_err_none(cache_access_batch(machine->mem_space, &access, 1, machine->l1_icache[core],
+                                          machine->l1_dcache[core], machine->l2_cache, &machine->coherence, core,
+                                          machine->replace, write_policy, 0, NULL));
+    return access.data;
+}
+
+static word_t access_word(machine_t* machine, size_t core, command_word_t order, uint32_t phy_addr, word_t data,
+                          cache_write_t write_policy)
+{
+    return access_type(machine, core, order, DATA, phy_addr, data, write_policy);
+}
+
+static void check_states(machine_t* machine, uint32_t phy_addr, mesi_state_t state_0, mesi_state_t state_1)
+{
+    ck_assert_int_eq(coherence_state(machine->l1_dcache[0], phy_addr), state_0);
+    ck_assert_int_eq(coherence_state(machine->l1_dcache[1], phy_addr), state_1);
+}
+
+static void check_counters(const machine_t* machine, size_t core, uint64_t invalidations, uint64_t upgrades,
+                           uint64_t transfers)
+{
+    ck_assert_uint_eq(machine->coherence.stats[core].invalidations, invalidations);
+    ck_assert_uint_eq(machine->coherence.stats[core].upgrades, upgrades);
+    ck_assert_uint_eq(machine->coherence.stats[core].transfers, transfers);
+}
+
+// reading as many other lines of its set as level 1 has ways evicts a line into level 2
+static void evict(machine_t* machine, size_t core, uint32_t phy_addr, cache_write_t write_policy)
+{
+    for (uint32_t way = 1; way <= L1_DCACHE_WAYS; ++way) {
+        (void)access_word(machine, core, READ, phy_addr + way * L1_SET_STRIDE, 0, write_policy);
+    }
+    ck_assert_int_eq(coherence_state(machine->l1_dcache[core], phy_addr), MESI_INVALID);
+}
+
+static size_t l2_copies(const machine_t* machine, uint32_t phy_addr)
+{
+    const void* const cache = machine->l2_cache;
+    const uint16_t index = (phy_addr / L2_CACHE_LINE) % L2_CACHE_LINES;
+    size_t copies = 0;
+    foreach_way(way, L2_CACHE_WAYS) {
+        copies += cache_valid(const l2_cache_entry_t, L2_CACHE_WAYS, index, way) == 1
+                  && cache_tag(const l2_cache_entry_t, L2_CACHE_WAYS, index, way) == phy_addr >> L2_CACHE_TAG_REMAINING_BITS;
+    }
+    return copies;
+}
+
+// ------------------------------------------------------------
+// level 2 holds at most one copy of a line, even evicted by every core
+
+START_TEST(cache_shared_eviction_test)
+{
+    const cache_write_t policies[] = { WRITE_THROUGH, WRITE_BACK };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        machine_t machine;
+        machine_init(&machine);
+
+        ck_assert_uint_eq(access_word(&machine, 0, READ, LINE_X, 0, policies[p]), 0xAAAA);
+        ck_assert_uint_eq(access_word(&machine, 1, READ, LINE_X, 0, policies[p]), 0xAAAA);
+        ck_assert_int_eq(coherence_state(machine.l1_dcache[0], LINE_X), MESI_SHARED);
+        evict(&machine, 0, LINE_X, policies[p]);
+        evict(&machine, 1, LINE_X, policies[p]);
+        ck_assert_uint_eq(l2_copies(&machine, LINE_X), 1);
+
+        // taken back Exclusive, then written without invalidating level 2
+        ck_assert_uint_eq(access_word(&machine, 0, READ, LINE_X, 0, policies[p]), 0xAAAA);
+        ck_assert_int_eq(coherence_state(machine.l1_dcache[0], LINE_X), MESI_EXCLUSIVE);
+        ck_assert_uint_eq(l2_copies(&machine, LINE_X), 0);
+        (void)access_word(&machine, 0, WRITE, LINE_X, 0xBBBB, policies[p]);
+        ck_assert_uint_eq(access_word(&machine, 1, READ, LINE_X, 0, policies[p]), 0xBBBB);
+
+        machine_free(&machine);
+    }
+}
+END_TEST
+
+// ------------------------------------------------------------
+// the states of a line read and written in turn by both cores
+
+START_TEST(cache_mesi_test)
+{
+    const cache_write_t policies[] = { WRITE_THROUGH, WRITE_BACK };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        machine_t machine;
+        machine_init(&machine);
+
+        // read misses: Exclusive alone, then Shared by both
+        ck_assert_uint_eq(access_word(&machine, 0, READ, LINE_X, 0, policies[p]), 0xAAAA);
+        check_states(&machine, LINE_X, MESI_EXCLUSIVE, MESI_INVALID);
+        check_counters(&machine, 0, 0, 0, 0);
+        ck_assert_uint_eq(access_word(&machine, 1, READ, LINE_X, 0, policies[p]), 0xAAAA);
+        check_states(&machine, LINE_X, MESI_SHARED, MESI_SHARED);
+        check_counters(&machine, 1, 0, 0, 1);
+
+        // a write hitting a Shared line upgrades it, invalidating the other copy
+        (void)access_word(&machine, 0, WRITE, LINE_X, 0xBBBB, policies[p]);
+        check_states(&machine, LINE_X, MESI_MODIFIED, MESI_INVALID);
+        check_counters(&machine, 0, 1, 1, 0);
+
+        // a read miss takes a Modified copy from the other cache, both Shared
+        ck_assert_uint_eq(access_word(&machine, 1, READ, LINE_X, 0, policies[p]), 0xBBBB);
+        check_states(&machine, LINE_X, MESI_SHARED, MESI_SHARED);
+        check_counters(&machine, 1, 0, 0, 2);
+
+        // an upgrade again, then a write hitting the Modified line changes nothing more
+        (void)access_word(&machine, 1, WRITE, LINE_X, 0xCCCC, policies[p]);
+        (void)access_word(&machine, 1, WRITE, LINE_X + sizeof(word_t), 0xDDDD, policies[p]);
+        check_states(&machine, LINE_X, MESI_INVALID, MESI_MODIFIED);
+        check_counters(&machine, 1, 1, 1, 2);
+
+        // a write miss takes the line from the Modified copy, then invalidates it
+        (void)access_word(&machine, 0, WRITE, LINE_X, 0xEEEE, policies[p]);
+        check_states(&machine, LINE_X, MESI_MODIFIED, MESI_INVALID);
+        check_counters(&machine, 0, 2, 1, 1);
+        ck_assert_uint_eq(access_word(&machine, 0, READ, LINE_X + sizeof(word_t), 0, policies[p]), 0xDDDD);
+        ck_assert_uint_eq(access_word(&machine, 1, READ, LINE_X, 0, policies[p]), 0xEEEE);
+        check_states(&machine, LINE_X, MESI_SHARED, MESI_SHARED);
+
+        // an Exclusive line is written without any other core knowing
+        ck_assert_uint_eq(access_word(&machine, 1, READ, LINE_Y, 0, policies[p]), 0xAAAA);
+        check_states(&machine, LINE_Y, MESI_INVALID, MESI_EXCLUSIVE);
+        (void)access_word(&machine, 1, WRITE, LINE_Y, 0xFFFF, policies[p]);
+        check_states(&machine, LINE_Y, MESI_INVALID, MESI_MODIFIED);
+        check_counters(&machine, 1, 1, 1, 3);
+
+        machine_free(&machine);
+    }
+}
+END_TEST
+
+// ------------------------------------------------------------
+// instruction caches only read, but their copies are invalidated by writes
+
+START_TEST(cache_mesi_instruction_test)
+{
+    const cache_write_t policies[] = { WRITE_THROUGH, WRITE_BACK };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        machine_t machine;
+        machine_init(&machine);
+
+        ck_assert_uint_eq(access_type(&machine, 0, READ, INSTRUCTION, LINE_X, 0, policies[p]), 0xAAAA);
+        ck_assert_uint_eq(access_type(&machine, 1, READ, INSTRUCTION, LINE_X, 0, policies[p]), 0xAAAA);
+        ck_assert_int_eq(coherence_state(machine.l1_icache[0], LINE_X), MESI_SHARED);
+        ck_assert_int_eq(coherence_state(machine.l1_icache[1], LINE_X), MESI_SHARED);
+
+        // the copy of the writing core too
+        (void)access_word(&machine, 0, WRITE, LINE_X, 0xBBBB, policies[p]);
+        check_states(&machine, LINE_X, MESI_MODIFIED, MESI_INVALID);
+        ck_assert_int_eq(coherence_state(machine.l1_icache[0], LINE_X), MESI_INVALID);
+        ck_assert_int_eq(coherence_state(machine.l1_icache[1], LINE_X), MESI_INVALID);
+        ck_assert_uint_eq(machine.coherence.stats[0].invalidations, 2);
+
+        ck_assert_uint_eq(access_type(&machine, 1, READ, INSTRUCTION, LINE_X, 0, policies[p]), 0xBBBB);
+        ck_assert_int_eq(coherence_state(machine.l1_icache[1], LINE_X), MESI_SHARED);
+        check_states(&machine, LINE_X, MESI_SHARED, MESI_INVALID);
+
+        machine_free(&machine);
+    }
+}
+END_TEST
+
+// ------------------------------------------------------------
+// a full set of level 1 evicts its least recently used line, the one tree-PLRU points to,
+// or the first one SRRIP predicts to be reused the latest
+
+START_TEST(cache_replacement_test)
+{
+    const cache_replace_t policies[] = { LRU, PLRU, SRRIP };
+    // after lines 0 to 3 of the set, then line 0 again, LRU evicts line 1; the root of
+    // the PLRU tree points to ways 2 and 3 (away from 0), then its node to way 2 (away from 3);
+    // SRRIP predicts line 0 to be reused soon, and the others as they were inserted
+    const uint32_t evicted[] = { 1, 2, 1 };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        machine_t machine;
+        machine_init(&machine);
+        machine.replace = policies[p];
+
+        for (uint32_t line = 0; line < L1_DCACHE_WAYS; ++line) {
+            (void)access_word(&machine, 0, READ, LINE_X + line * L1_SET_STRIDE, 0, WRITE_THROUGH);
+        }
+        (void)access_word(&machine, 0, READ, LINE_X, 0, WRITE_THROUGH);
+        (void)access_word(&machine, 0, READ, LINE_X + L1_DCACHE_WAYS * L1_SET_STRIDE, 0, WRITE_THROUGH);
+
+        for (uint32_t line = 0; line <= L1_DCACHE_WAYS; ++line) {
+            ck_assert_int_eq(coherence_state(machine.l1_dcache[0], LINE_X + line * L1_SET_STRIDE),
+                             (line == evicted[p]) ? MESI_INVALID : MESI_EXCLUSIVE);
+        }
+        ck_assert_uint_eq(l2_copies(&machine, LINE_X + evicted[p] * L1_SET_STRIDE), 1);
+
+        machine_free(&machine);
+    }
+}
+END_TEST
+
+// ======================================================================
+Suite* cache_test_suite()
+{
+    Suite* s = suite_create("Coherent Cache Hierarchy Tests");
+
+    Add_Case(s, tc1, "level 2 copies");
+    tcase_add_test(tc1, cache_shared_eviction_test);
+
+    Add_Case(s, tc2, "MESI states");
+    tcase_add_test(tc2, cache_mesi_test);
+    tcase_add_test(tc2, cache_mesi_instruction_test);
+
+    Add_Case(s, tc3, "replacement policies");
+    tcase_add_test(tc3, cache_replacement_test);
+
+    return s;
+}
+
+TEST_SUITE(cache_test_suite)
@@ -27,9 +27,10 @@ static void error(const char* pgm, const char* msg)
     assert(msg != NULL);
     fputs("ERROR: ", stderr);
     fputs(msg, stderr);
-    fprintf(stderr, "\nusage:    %s (dump|desc) filename (p|o|u|n) spacer "\
+    fprintf(stderr, "\nusage:    %s (dump|mmap|desc) filename (p|o|u|n) spacer "\
             "[list of VA to print]\n", pgm);
     fprintf(stderr, "examples: %s dump memory_dump.bin o , 0xff000\n", pgm);
+    fprintf(stderr, "          %s mmap memory_dump.bin o , 0xff000\n", pgm);
     fprintf(stderr, "          %s desc memory_description.txt o , 0xff000 0xfe000\n", pgm);
 }
 
@@ -41,8 +42,11 @@ int main(int argc, char *argv[])
         return 1;
     }
     int dump = 1;
+    int mapped = 0;
     if (strcmp(argv[1], "dump")) {
-        if (strcmp(argv[1], "desc")) {
+        if (!strcmp(argv[1], "mmap")) {
+            mapped = 1;
+        } else if (strcmp(argv[1], "desc")) {
             error(argv[0], "unknown command.");
             return 1;
         }
@@ -54,6 +58,8 @@ int main(int argc, char *argv[])
     int err = ERR_NONE;
     if (dump)
         err = mem_init_from_dumpfile(argv[2], &mem_space, &mem_size);
+    else if (mapped)
+        err = mem_init_from_dumpfile_mmap(argv[2], &mem_space, &mem_size);
     else
         err = mem_init_from_description(argv[2], &mem_space, &mem_size);
 
@@ -91,7 +97,8 @@ int main(int argc, char *argv[])
             const int error = init_virt_addr64(&vaddr, vaddr64);
             if (error != ERR_NONE) {
                 puts("Mauvaise adresse ==> Abandon");
-                free(mem_space);
+                if (mapped) mem_release_mmap(mem_space, mem_size);
+                else free(mem_space);
                 return 2;
             }
 
@@ -104,6 +111,7 @@ int main(int argc, char *argv[])
         return 3;
     }
 
-    free(mem_space);
+    if (mapped) mem_release_mmap(mem_space, mem_size);
+    else free(mem_space);
     return 0;
 }
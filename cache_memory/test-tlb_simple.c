@@ -19,6 +19,10 @@
 #include "list.h"
 #include "tlb.h"
 #include "tlb_mng.h"
+#include "tlb_hash.h"
+#include "index_list.h"
+
+#include <string.h>
 
 #include <inttypes.h> // for PRIx macros
 
@@ -29,6 +33,8 @@ int main(int argc, char* argv[])
         fprintf(stderr, "\t- one (txt) to read commands from;\n");
         fprintf(stderr, "\t- one (bin) to memory content from;\n");
         fprintf(stderr, "\t- one to write output to.\n");
+        fprintf(stderr, "optionally followed by \"hash\" to look tags up through a tlb_hash_t\n");
+        fprintf(stderr, "and/or \"index\" to keep the LRU order in an index_list_t.\n");
         return 1;
     }
 
@@ -74,6 +80,30 @@ int main(int argc, char* argv[])
         .push_back      = push_back
     };
 
+    // same hits, misses and evictions, with an array-backed list...
+    index_list_t lru;
+    init_index_list(&lru);
+    for (int i = 4; i < argc; ++i) {
+        if (!strcmp(argv[i], "index")) {
+            for (uint16_t line_index = 0; line_index < TLB_LINES; line_index++) {
+                (void)index_push_back(&lru, line_index);
+            }
+            replacement_policy.lru = &lru;
+        }
+    }
+
+    // ...and/or without walking the list
+    tlb_hash_t hash;
+    for (int i = 4; i < argc; ++i) {
+        if (!strcmp(argv[i], "hash")) {
+            if (tlb_hash_init(&hash, (replacement_policy.lru == NULL) ? &ll : NULL) != ERR_NONE) {
+                fprintf(stderr, "Cannot initialize the TLB hash.");
+                return 5;
+            }
+            replacement_policy.hash = &hash;
+        }
+    }
+
     phy_addr_t paddr;
     zero_init_var(paddr);
 
@@ -99,7 +129,8 @@ int main(int argc, char* argv[])
                         tlb[tlb_line_index].phy_page_num
                        );
             }
-            print_list(f_out, &ll);
+            if (replacement_policy.lru != NULL) print_index_list(f_out, &lru);
+            else print_list(f_out, &ll);
         } else {
             fprintf(f_out, "error with tlb_search(): %s\n", ERR_MESSAGES[err - ERR_NONE]);
         }
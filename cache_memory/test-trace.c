@@ -0,0 +1,344 @@
+/**
+ * @file test-trace.c
+ * @brief test code for reading programs from text and binary traces
+ */
+
+#define _POSIX_C_SOURCE 200809L // for mkstemp()
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "util.h"
+#include "addr_mng.h"
+#include "commands.h"
+#include "trace_bin.h"
+
+// ------------------------------------------------------------
+// Preliminary stuff
+
+#define TRACE_TEMPLATE "test-trace-XXXXXX"
+
+// writing a trace made of the given content to a new file, named from TRACE_TEMPLATE
+static void write_trace(const char* content, char* filename)
+{
+    const int fd = mkstemp(filename);
+    ck_assert_int_ge(fd, 0);
+    FILE* file = fdopen(fd, "w");
+    ck_assert_ptr_nonnull(file);
+    ck_assert_int_ge(fputs(content, file), 0);
+    ck_assert_int_eq(fclose(file), 0);
+}
+
+// reading a program from a trace made of the given content
+static int read_trace(const char* content, program_t* program)
+{
+    char filename[] = TRACE_TEMPLATE;
+    write_trace(content, filename);
+
+    const int err = program_read(filename, program);
+    (void)remove(filename);
+    return err;
+}
+
+static void check_command(const command_t* command, uint8_t core, command_word_t order, mem_access_t type,
+                          size_t data_size, word_t write_data, uint64_t vaddr)
+{
+    ck_assert_uint_eq(command->core, core);
+    ck_assert_int_eq(command->order, order);
+    ck_assert_int_eq(command->type, type);
+    ck_assert_uint_eq(command->data_size, data_size);
+    ck_assert_uint_eq(command->write_data, write_data);
+    ck_assert_uint_eq(virt_addr_t_to_uint64_t(&command->vaddr), vaddr);
+}
+
+static command_t make_command(uint8_t core, command_word_t order, mem_access_t type, size_t data_size,
+                              word_t write_data, uint64_t vaddr)
+{
+    command_t command;
+    zero_init_var(command);
+    command.core = core;
+    command.order = order;
+    command.type = type;
+    command.data_size = data_size;
+    command.write_data = write_data;
+    ck_assert_err_none(init_virt_addr64(&command.vaddr, vaddr));
+    return command;
+}
+
+// the largest differences of virtual addresses (48 bits) and data, on every core
+static const command_t* bin_commands(size_t* nb_commands)
+{
+    static command_t commands[8];
+    const uint64_t vaddr_max = (UINT64_C(1) << (VIRT_ADDR - VIRT_ADDR_RES)) - 1;
+    size_t n = 0;
+    commands[n++] = make_command(0, READ, INSTRUCTION, sizeof(word_t), 0, 0);
+    commands[n++] = make_command(0, WRITE, DATA, sizeof(word_t), UINT32_MAX, vaddr_max - 3);
+    commands[n++] = make_command(UINT8_MAX, READ, DATA, sizeof(byte_t), 0, 0);
+    commands[n++] = make_command(UINT8_MAX, SWITCH, DATA, sizeof(word_t), UINT32_MAX, 0);
+    commands[n++] = make_command(1, INVALIDATE, DATA, sizeof(word_t), UINT32_MAX, vaddr_max - PAGE_SIZE + 1);
+    commands[n++] = make_command(UINT8_MAX, WRITE, DATA, sizeof(byte_t), UINT8_MAX, vaddr_max);
+    commands[n++] = make_command(0, INVALIDATE, DATA, sizeof(word_t), 0, 0);
+    commands[n++] = make_command(2, READ, DATA, sizeof(word_t), 0, 0x1000);
+    *nb_commands = n;
+    return commands;
+}
+
+// ------------------------------------------------------------
+// every kind of command, with and without the core prefix
+
+START_TEST(parse_commands_test)
+{
+    program_t program;
+    ck_assert_err_none(read_trace("R I @0x0000000000001004\n"
+                                  "C1 R DW @0x1008\n"
+                                  "C1F W DB 0x7F @0x0000FFFFFFFFFFFF\n"
+                                  "W DW 0xDEADBEEF @0x2000 what follows the address is ignored\n"
+                                  "S 0x00002001\n"
+                                  "CFF S 1000 ignored too\n"
+                                  "V 0x4 @0x0000000000003000\n"
+                                  "C2 V 0 @0x0\n"
+                                  "R\tDB\t@0x5\r\n"
+                                  "R I @0x8", // no newline at the end
+                                  &program));
+
+    ck_assert_uint_eq(program.nb_lines, 10);
+    const command_t* const c = program.listing;
+    check_command(&c[0], 0, READ, INSTRUCTION, sizeof(word_t), 0, 0x1004);
+    check_command(&c[1], 1, READ, DATA, sizeof(word_t), 0, 0x1008);
+    check_command(&c[2], 0x1F, WRITE, DATA, sizeof(byte_t), 0x7F, UINT64_C(0xFFFFFFFFFFFF));
+    check_command(&c[3], 0, WRITE, DATA, sizeof(word_t), 0xDEADBEEF, 0x2000);
+    check_command(&c[4], 0, SWITCH, DATA, sizeof(word_t), 0x2001, 0);
+    check_command(&c[5], 0xFF, SWITCH, DATA, sizeof(word_t), 0x1000, 0);
+    check_command(&c[6], 0, INVALIDATE, DATA, sizeof(word_t), 4, 0x3000);
+    check_command(&c[7], 2, INVALIDATE, DATA, sizeof(word_t), 0, 0);
+    check_command(&c[8], 0, READ, DATA, sizeof(byte_t), 0, 0x5);
+    check_command(&c[9], 0, READ, INSTRUCTION, sizeof(word_t), 0, 0x8);
+
+    ck_assert_err_none(program_free(&program));
+}
+END_TEST
+
+// ------------------------------------------------------------
+// a single malformed line makes the whole trace unreadable
+
+START_TEST(parse_malformed_test)
+{
+    const char* const lines[] = {
+        "X I @0x1000\n",                   // unknown order
+        "R Q @0x1000\n",                   // unknown access type
+        "R DX @0x1000\n",                  // unknown data size
+        "R I 0x1000\n",                    // no @
+        "R I @\n",                         // no address
+        "R I @0x10000000000000000\n",      // more than 64 bits
+        "R DW @0x1002\n",                  // word not aligned
+        "W DW @0x1000\n",                  // no data to write
+        "W DW 0x100000000 @0x1000\n",      // more than a word
+        "C R I @0x1000\n",                 // no core number
+        "C100 R I @0x1000\n",              // core number above a byte
+        "S\n",                             // no CR3
+        "S 0x100000000\n",                 // CR3 of more than 32 bits
+        "V @0x1000\n",                     // no number of pages
+        "V 0x4\n",                         // no address
+        "R I @0x1000\nR I @0x2000\nR I\n", // the last line only
+    };
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+        program_t program;
+        ck_assert_int_ne(read_trace(lines[i], &program), ERR_NONE);
+        (void)program_free(&program);
+    }
+}
+END_TEST
+
+// ------------------------------------------------------------
+// a line must fit in the buffer of the stream
+
+START_TEST(parse_long_line_test)
+{
+    char* const content = malloc(PROGRAM_STREAM_BUFFER + 2);
+    ck_assert_ptr_nonnull(content);
+    memset(content, ' ', PROGRAM_STREAM_BUFFER);
+    strcpy(content + PROGRAM_STREAM_BUFFER, "\n");
+
+    program_t program;
+    ck_assert_int_eq(read_trace(content, &program), ERR_IO);
+    (void)program_free(&program);
+    free(content);
+}
+END_TEST
+
+// ------------------------------------------------------------
+// what program_print() writes reads back the same
+
+START_TEST(parse_print_test)
+{
+    program_t program;
+    ck_assert_err_none(read_trace("C7 W DB 0x7F @0x0000FFFFFFFFFFFF\n"
+                                  "CFF S 0x00001001\n"
+                                  "V 0x10 @0x0000000000003000\n"
+                                  "R I @0x0000000000001004\n",
+                                  &program));
+
+    char* text = NULL;
+    size_t size = 0;
+    FILE* output = open_memstream(&text, &size);
+    ck_assert_ptr_nonnull(output);
+    ck_assert_err_none(program_print(output, &program));
+    ck_assert_int_eq(fclose(output), 0);
+
+    program_t printed;
+    ck_assert_err_none(read_trace(text, &printed));
+    ck_assert_uint_eq(printed.nb_lines, program.nb_lines);
+    for (size_t i = 0; i < program.nb_lines; ++i) {
+        const command_t* const c = &program.listing[i];
+        check_command(&printed.listing[i], c->core, c->order, c->type, c->data_size, c->write_data,
+                      virt_addr_t_to_uint64_t(&c->vaddr));
+    }
+
+    free(text);
+    ck_assert_err_none(program_free(&printed));
+    ck_assert_err_none(program_free(&program));
+}
+END_TEST
+
+// ------------------------------------------------------------
+// a stream keeps failing once a batch did, after the batches read before
+
+START_TEST(stream_error_test)
+{
+    char filename[] = TRACE_TEMPLATE;
+    write_trace("R I @0x1000\n"
+                "R I @0x2000\n"
+                "R DW @0x1002\n" // word not aligned
+                "R I @0x3000\n",
+                filename);
+
+    program_stream_t stream;
+    ck_assert_err_none(program_stream_open(filename, &stream, 2));
+    const command_t* batch = NULL;
+    size_t nb_lines = 0;
+    ck_assert_err_none(program_stream_next(&stream, &batch, &nb_lines));
+    ck_assert_uint_eq(nb_lines, 2);
+    check_command(&batch[1], 0, READ, INSTRUCTION, sizeof(word_t), 0, 0x2000);
+
+    for (int i = 0; i < 3; ++i) {
+        ck_assert_int_eq(program_stream_next(&stream, &batch, &nb_lines), ERR_BAD_PARAMETER);
+        ck_assert_ptr_null(batch);
+        ck_assert_uint_eq(nb_lines, 0);
+    }
+
+    ck_assert_err_none(program_stream_close(&stream));
+    (void)remove(filename);
+}
+END_TEST
+
+// ------------------------------------------------------------
+// every record decodes back to its command, and not from fewer bytes
+
+START_TEST(bin_record_test)
+{
+    size_t nb_commands = 0;
+    const command_t* const commands = bin_commands(&nb_commands);
+    uint64_t encoded_vaddr = 0;
+    uint64_t decoded_vaddr = 0;
+    for (size_t i = 0; i < nb_commands; ++i) {
+        uint8_t buf[TRACE_BIN_MAX_RECORD];
+        size_t size = 0;
+        ck_assert_err_none(trace_bin_encode(buf, &commands[i], &encoded_vaddr, &size));
+        ck_assert_uint_le(size, TRACE_BIN_MAX_RECORD);
+
+        command_t command;
+        size_t used = 0;
+        uint64_t prev_vaddr = decoded_vaddr;
+        ck_assert_int_eq(trace_bin_decode(buf, size - 1, &command, &prev_vaddr, &used), ERR_EOF);
+        ck_assert_uint_eq(prev_vaddr, decoded_vaddr);
+        ck_assert_err_none(trace_bin_decode(buf, size, &command, &decoded_vaddr, &used));
+        ck_assert_uint_eq(used, size);
+        ck_assert_uint_eq(decoded_vaddr, encoded_vaddr);
+        check_command(&command, commands[i].core, commands[i].order, commands[i].type, commands[i].data_size,
+                      commands[i].write_data, virt_addr_t_to_uint64_t(&commands[i].vaddr));
+    }
+}
+END_TEST
+
+// ------------------------------------------------------------
+// the longest varint decoded (10 bytes), and one byte more
+
+START_TEST(bin_varint_test)
+{
+    // UINT64_MAX, that is a difference of 2^63 once zigzag-decoded
+    uint8_t buf[TRACE_BIN_MAX_RECORD] = { TRACE_BIN_DATA, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    command_t command;
+    size_t used = 0;
+    uint64_t prev_vaddr = 0x1000;
+    ck_assert_err_none(trace_bin_decode(buf, 11, &command, &prev_vaddr, &used));
+    ck_assert_uint_eq(used, 11);
+    ck_assert_uint_eq(prev_vaddr, (UINT64_C(1) << 63) + 0x1000);
+    check_command(&command, 0, READ, DATA, sizeof(word_t), 0, 0x1000); // beyond 48 bits is ignored
+
+    buf[10] = 0xFF;
+    buf[11] = 0x01;
+    prev_vaddr = 0;
+    ck_assert_int_eq(trace_bin_decode(buf, 12, &command, &prev_vaddr, &used), ERR_IO);
+}
+END_TEST
+
+// ------------------------------------------------------------
+// a program written as a binary trace reads back the same
+
+START_TEST(bin_round_trip_test)
+{
+    program_t program;
+    ck_assert_err_none(program_init(&program));
+    size_t nb_commands = 0;
+    const command_t* const commands = bin_commands(&nb_commands);
+    for (size_t i = 0; i < nb_commands; ++i) {
+        ck_assert_err_none(program_add_command(&program, &commands[i]));
+    }
+
+    char filename[] = TRACE_TEMPLATE;
+    const int fd = mkstemp(filename);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(close(fd), 0);
+    ck_assert_err_none(program_write_bin(filename, &program));
+
+    program_t read;
+    const int err = program_read(filename, &read);
+    (void)remove(filename);
+    ck_assert_err_none(err);
+    ck_assert_uint_eq(read.nb_lines, nb_commands);
+    for (size_t i = 0; i < nb_commands; ++i) {
+        check_command(&read.listing[i], commands[i].core, commands[i].order, commands[i].type,
+                      commands[i].data_size, commands[i].write_data, virt_addr_t_to_uint64_t(&commands[i].vaddr));
+    }
+
+    ck_assert_err_none(program_free(&read));
+    ck_assert_err_none(program_free(&program));
+}
+END_TEST
+
+// ======================================================================
+Suite* trace_test_suite()
+{
+    Suite* s = suite_create("Trace Reading Tests");
+
+    Add_Case(s, tc1, "text traces");
+    tcase_add_test(tc1, parse_commands_test);
+    tcase_add_test(tc1, parse_malformed_test);
+    tcase_add_test(tc1, parse_long_line_test);
+    tcase_add_test(tc1, parse_print_test);
+    tcase_add_test(tc1, stream_error_test);
+
+    Add_Case(s, tc2, "binary traces");
+    tcase_add_test(tc2, bin_record_test);
+    tcase_add_test(tc2, bin_varint_test);
+    tcase_add_test(tc2, bin_round_trip_test);
+
+    return s;
+}
+
+TEST_SUITE(trace_test_suite)
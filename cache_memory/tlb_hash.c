@@ -0,0 +1,102 @@
+/**
+ * @file tlb_hash.c
+ * @brief open-addressing hash from virtual page numbers to TLB lines
+ */
+
+#include "tlb_hash.h"
+#include "tlb.h"
+#include "list.h"
+#include "error.h"
+#include <string.h>
+
+#define TLB_HASH_MASK (TLB_HASH_SLOTS - 1u)
+#define FIBONACCI_MULTIPLIER 0x9E3779B97F4A7C15ull // 2^64 / golden ratio
+
+//first slot to probe for a tag
+static inline uint32_t home_slot(uint64_t tag){
+	return (uint32_t)((tag * FIBONACCI_MULTIPLIER) >> (64 - TLB_HASH_BITS));
+}
+
+//slot holding a tag, TLB_HASH_SLOTS if there is none
+static inline uint32_t find_slot(const tlb_hash_t* hash, uint64_t tag){
+	for(uint32_t slot = home_slot(tag); hash->lines[slot] != TLB_HASH_EMPTY; slot = (slot + 1) & TLB_HASH_MASK){
+		if(hash->tags[slot] == tag){
+			return slot;
+		}
+	}
+	return TLB_HASH_SLOTS;
+}
+
+int tlb_hash_init(tlb_hash_t* hash, const list_t* ll){
+	M_REQUIRE_NON_NULL(hash);
+
+	memset(hash->nodes, 0, sizeof(hash->nodes));
+	//an array-backed LRU (index_list_t) needs no nodes
+	if(ll != NULL){
+		for_all_nodes(node, ll){
+			M_REQUIRE(node->value < TLB_LINES, ERR_BAD_PARAMETER, "line %" PRIu32 " is not in the TLB", node->value);
+			hash->nodes[node->value] = node;
+		}
+		for(size_t line = 0; line < TLB_LINES; ++line){
+			M_REQUIRE(hash->nodes[line] != NULL, ERR_BAD_PARAMETER, "line %zu is not in the replacement list", line);
+		}
+	}
+
+	return tlb_hash_clear(hash);
+}
+
+int tlb_hash_clear(tlb_hash_t* hash){
+	M_REQUIRE_NON_NULL(hash);
+
+	for(size_t slot = 0; slot < TLB_HASH_SLOTS; ++slot){
+		hash->lines[slot] = TLB_HASH_EMPTY;
+	}
+	return ERR_NONE;
+}
+
+uint16_t tlb_hash_find(const tlb_hash_t* hash, uint64_t tag){
+	if(hash == NULL){
+		return TLB_HASH_EMPTY;
+	}
+	const uint32_t slot = find_slot(hash, tag);
+	return (slot == TLB_HASH_SLOTS) ? TLB_HASH_EMPTY : hash->lines[slot];
+}
+
+int tlb_hash_insert(tlb_hash_t* hash, uint64_t tag, uint16_t line){
+	M_REQUIRE_NON_NULL(hash);
+	M_REQUIRE(line < TLB_LINES, ERR_BAD_PARAMETER, "line %" PRIu16 " is not in the TLB", line);
+
+	//at most TLB_LINES tags for twice as many slots: there always is a free one
+	uint32_t slot = home_slot(tag);
+	while(hash->lines[slot] != TLB_HASH_EMPTY && hash->tags[slot] != tag){
+		slot = (slot + 1) & TLB_HASH_MASK;
+	}
+	hash->tags[slot] = tag;
+	hash->lines[slot] = line;
+	return ERR_NONE;
+}
+
+int tlb_hash_remove(tlb_hash_t* hash, uint64_t tag){
+	M_REQUIRE_NON_NULL(hash);
+
+	uint32_t hole = find_slot(hash, tag);
+	if(hole == TLB_HASH_SLOTS){
+		return ERR_NONE;
+	}
+
+	//shifting back the following tags of the cluster which may not be
+	//probed past the hole anymore, i.e. whose home slot is not in (hole, slot]
+	for(uint32_t slot = (hole + 1) & TLB_HASH_MASK; hash->lines[slot] != TLB_HASH_EMPTY;
+		slot = (slot + 1) & TLB_HASH_MASK){
+
+		const uint32_t home = home_slot(hash->tags[slot]);
+		const int stays = (hole < slot) ? (hole < home && home <= slot) : (hole < home || home <= slot);
+		if(!stays){
+			hash->tags[hole] = hash->tags[slot];
+			hash->lines[hole] = hash->lines[slot];
+			hole = slot;
+		}
+	}
+	hash->lines[hole] = TLB_HASH_EMPTY;
+	return ERR_NONE;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+/**
+ * @file tlb_hash.h
+ * @brief open-addressing hash from virtual page numbers to TLB lines
+ *
+ * Kept alongside the replacement list of the fully-associative TLB (see
+ * replacement_policy_t) so that tlb_hit() finds the line of a tag without
+ * walking the list. Linear probing, deletion by backward shift (no tombstones).
+ */
+
+#include "tlb.h"
+#include "list.h"
+#include <stdint.h>
+
+#define TLB_HASH_BITS  8
+#define TLB_HASH_SLOTS (1u << TLB_HASH_BITS) // at least twice TLB_LINES
+#define TLB_HASH_EMPTY ((uint16_t) -1)
+
+typedef struct{
+	uint64_t tags[TLB_HASH_SLOTS];
+	uint16_t lines[TLB_HASH_SLOTS]; // TLB_HASH_EMPTY for a free slot
+	node_t* nodes[TLB_LINES]; // the node of the replacement list holding each line
+}tlb_hash_t;
+
+//=========================================================================
+/**
+ * @brief Initialize an empty hash for a TLB and its replacement list.
+ * The list must already hold all the TLB lines (and keep its nodes).
+ * @param hash (modified) the hash
+ * @param ll the replacement list, NULL if the TLB uses an index_list_t
+ * @return error code
+ */
+int tlb_hash_init(tlb_hash_t* hash, const list_t* ll);
+
+//=========================================================================
+/**
+ * @brief Forget all the tags (to be done whenever the TLB is flushed).
+ * @param hash the hash
+ * @return error code
+ */
+int tlb_hash_clear(tlb_hash_t* hash);
+
+//=========================================================================
+/**
+ * @brief Find the line of a tag.
+ * @param hash the hash
+ * @param tag the virtual page number
+ * @return the line, TLB_HASH_EMPTY if the tag is not in the hash
+ */
+uint16_t tlb_hash_find(const tlb_hash_t* hash, uint64_t tag);
+
+//=========================================================================
+/**
+ * @brief Record the line of a tag (replacing its previous line, if any).
+ * @param hash the hash
+ * @param tag the virtual page number
+ * @param line its line in the TLB
+ * @return error code
+ */
+int tlb_hash_insert(tlb_hash_t* hash, uint64_t tag, uint16_t line);
+
+//=========================================================================
+/**
+ * @brief Forget a tag (nothing is done if it is not in the hash).
+ * @param hash the hash
+ * @param tag the virtual page number
+ * @return error code
+ */
+int tlb_hash_remove(tlb_hash_t* hash, uint64_t tag);
@@ -30,13 +30,28 @@
 
 /**
  * L1 ITLB, L1 DTLB, and L2 TLB are all direct-mapped.
+ * An entry maps a page of any size (page_size_t): it is indexed and tagged
+ * with the number of its page of that size, and holds the number of the
+ * first physical page (4 kiB) of it. It only matches the addresses of the
+ * address space of its ASID (see addr.h), which is hashed into its line
+ * index so that address spaces using the same pages do not all share lines.
  */
 
+// line of a TLB for a page number (of any size) and an ASID;
+// the low bits of the L1 and L2 line indexes stay equal
+#define TLB_LINE_INDEX(page_num, asid, tlb_lines) (((page_num) ^ ASID_HASH(asid)) % (tlb_lines))
+
+// page (4 kiB) of an address space, told apart from the same page number of
+// the others, e.g. by the statistics of the TLBs (see stats_access())
+#define TLB_PAGE_KEY(virt_page_num, asid) (((uint64_t) (asid) << VIRT_PAGE_NUM) | (virt_page_num))
+
 typedef struct{
 	 
 	uint32_t tag : VIRT_PAGE_NUM - L1_ITLB_LINES_BITS;
 	uint32_t phy_page_num : PHY_PAGE_NUM;
 	uint8_t v : 1; //validation bit
+	uint8_t size : 2; //page_size_t of the mapping
+	uint16_t asid : ASID_BITS; //address space of the mapping
 
 }l1_itlb_entry_t;
 
@@ -47,6 +62,8 @@ typedef struct{
 	uint32_t tag : VIRT_PAGE_NUM - L2_TLB_LINES_BITS ;
 	uint32_t phy_page_num : PHY_PAGE_NUM;
 	uint8_t v : 1; //validation bit
+	uint8_t size : 2; //page_size_t of the mapping
+	uint16_t asid : ASID_BITS; //address space of the mapping
 	
 }l2_tlb_entry_t;
 
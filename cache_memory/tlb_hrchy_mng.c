@@ -29,10 +29,90 @@ int tlb_flush(void *tlb, tlb_t tlb_type){
 }
 
 
-int tlb_hit( const virt_addr_t * vaddr,
-             phy_addr_t * paddr,
-             const void  * tlb,
-             tlb_t tlb_type){
+//invalidating the entries of asid mapping a page between the (4 kiB) virtual
+//page numbers first and last: the page number of an entry is its tag followed
+//by the bits of its line index, once the ASID is removed from it
+#define invalidate_entries(tlb_type, tlb_lines, tlb_lines_bits) \
+	tlb_type* entries = tlb; \
+	for(size_t line = 0; line < tlb_lines; ++line){ \
+		if(entries[line].v == 1 && entries[line].asid == asid){ \
+			const uint64_t page_num = ((uint64_t) entries[line].tag << tlb_lines_bits) \
+				| TLB_LINE_INDEX(line, asid, tlb_lines); \
+			const uint64_t first_mapped = page_num << PAGE_SIZE_SHIFT(entries[line].size); \
+			const uint64_t last_mapped = first_mapped + PAGE_SIZE_MASK(entries[line].size); \
+			if(first_mapped <= last && first <= last_mapped){ \
+				entries[line].v = 0; \
+			} \
+		} \
+	}
+
+static void invalidate(void * tlb, tlb_t tlb_type, uint16_t asid, uint64_t first, uint64_t last){
+	if(tlb_type == L1_ITLB){
+		invalidate_entries(l1_itlb_entry_t, L1_ITLB_LINES, L1_ITLB_LINES_BITS);
+	}else if(tlb_type == L1_DTLB){
+		invalidate_entries(l1_dtlb_entry_t, L1_DTLB_LINES, L1_DTLB_LINES_BITS);
+	}else{
+		invalidate_entries(l2_tlb_entry_t, L2_TLB_LINES, L2_TLB_LINES_BITS);
+	}
+}
+
+//the three TLBs at once
+static int invalidate_all( uint16_t asid,
+                           uint64_t first,
+                           uint64_t last,
+                           l1_itlb_entry_t * l1_itlb,
+                           l1_dtlb_entry_t * l1_dtlb,
+                           l2_tlb_entry_t * l2_tlb){
+	M_REQUIRE_NON_NULL(l1_itlb);
+	M_REQUIRE_NON_NULL(l1_dtlb);
+	M_REQUIRE_NON_NULL(l2_tlb);
+
+	invalidate(l1_itlb, L1_ITLB, asid, first, last);
+	invalidate(l1_dtlb, L1_DTLB, asid, first, last);
+	invalidate(l2_tlb, L2_TLB, asid, first, last);
+	return ERR_NONE;
+}
+
+int tlb_invalidate_page( const virt_addr_t * vaddr,
+                         uint16_t asid,
+                         l1_itlb_entry_t * l1_itlb,
+                         l1_dtlb_entry_t * l1_dtlb,
+                         l2_tlb_entry_t * l2_tlb){
+	return tlb_invalidate_range(vaddr, 1, asid, l1_itlb, l1_dtlb, l2_tlb);
+}
+
+int tlb_invalidate_range( const virt_addr_t * vaddr,
+                          uint64_t nb_pages,
+                          uint16_t asid,
+                          l1_itlb_entry_t * l1_itlb,
+                          l1_dtlb_entry_t * l1_dtlb,
+                          l2_tlb_entry_t * l2_tlb){
+	M_REQUIRE_NON_NULL(vaddr);
+	if(nb_pages == 0){
+		return ERR_NONE;
+	}
+
+	const uint64_t first = virt_addr_t_to_virtual_page_number(vaddr);
+	//the range ends with the address space
+	const uint64_t last_page = (UINT64_C(1) << VIRT_PAGE_NUM) - 1;
+	const uint64_t last = (nb_pages - 1 > last_page - first) ? last_page : first + nb_pages - 1;
+	return invalidate_all(asid, first, last, l1_itlb, l1_dtlb, l2_tlb);
+}
+
+int tlb_invalidate_asid( uint16_t asid,
+                         l1_itlb_entry_t * l1_itlb,
+                         l1_dtlb_entry_t * l1_dtlb,
+                         l2_tlb_entry_t * l2_tlb){
+	return invalidate_all(asid, 0, (UINT64_C(1) << VIRT_PAGE_NUM) - 1, l1_itlb, l1_dtlb, l2_tlb);
+}
+
+//tlb_hit(), also telling the size of the page hit
+static int hit_sized( const virt_addr_t * vaddr,
+                      phy_addr_t * paddr,
+                      const void  * tlb,
+                      tlb_t tlb_type,
+                      uint16_t asid,
+                      page_size_t * page_size){
 
 	//since this method should only return 1 or 0 
 	//we simply say "miss" in case of a parameter problem			 
@@ -45,20 +125,36 @@ int tlb_hit( const virt_addr_t * vaddr,
 
 	 if(tlb_type == L1_ITLB){
 		
-		hit_miss_process(l1_itlb_entry_t, L1_ITLB_LINES, L1_ITLB_LINES_BITS);
+		hit_miss_process(l1_itlb_entry_t, L1_ITLB_LINES, L1_ITLB_LINES_BITS, STATS_L1_ITLB);
 		
 	}else if(tlb_type == L1_DTLB){
 			
-		hit_miss_process(l1_dtlb_entry_t, L1_DTLB_LINES, L1_DTLB_LINES_BITS);
+		hit_miss_process(l1_dtlb_entry_t, L1_DTLB_LINES, L1_DTLB_LINES_BITS, STATS_L1_DTLB);
 		
 	}else if(tlb_type == L2_TLB){
 			
-		hit_miss_process(l2_tlb_entry_t, L2_TLB_LINES, L2_TLB_LINES_BITS);
+		hit_miss_process(l2_tlb_entry_t, L2_TLB_LINES, L2_TLB_LINES_BITS, STATS_L2_TLB);
 		
 	}
 	return 0;
 }
 
+int tlb_hit( const virt_addr_t * vaddr,
+             phy_addr_t * paddr,
+             const void  * tlb,
+             tlb_t tlb_type){
+	page_size_t page_size = PAGE_4K;
+	return hit_sized(vaddr, paddr, tlb, tlb_type, 0, &page_size);
+}
+
+//turning an entry initialized by tlb_entry_init() for the (4 kiB) page of
+//virt_page_num into the entry of its page of the given size, in the address space of entry_asid
+#define adjust_entry(entry, page_size, entry_asid, tlb_lines_bits) \
+	(entry).tag = (virt_page_num >> PAGE_SIZE_SHIFT(page_size)) >> (tlb_lines_bits); \
+	(entry).phy_page_num -= virt_page_num & PAGE_SIZE_MASK(page_size); \
+	(entry).size = page_size; \
+	(entry).asid = entry_asid;
+
 
 int tlb_insert( uint32_t line_index,
                 const void * tlb_entry,
@@ -70,15 +166,15 @@ int tlb_insert( uint32_t line_index,
 
 	if(tlb_type == L1_ITLB){
 	
-		insert_tlb_entry(tlb_entry, line_index, l1_itlb_entry_t, L1_ITLB_LINES);
+		insert_tlb_entry(tlb_entry, line_index, l1_itlb_entry_t, L1_ITLB_LINES, STATS_L1_ITLB);
 
 	}else if(tlb_type == L1_DTLB){
 
-		insert_tlb_entry(tlb_entry, line_index, l1_dtlb_entry_t, L1_DTLB_LINES);
+		insert_tlb_entry(tlb_entry, line_index, l1_dtlb_entry_t, L1_DTLB_LINES, STATS_L1_DTLB);
 
 	}else if(tlb_type == L2_TLB){
 		
-		insert_tlb_entry(tlb_entry, line_index, l2_tlb_entry_t, L2_TLB_LINES);
+		insert_tlb_entry(tlb_entry, line_index, l2_tlb_entry_t, L2_TLB_LINES, STATS_L2_TLB);
 
 	}else{
 		return ERR_BAD_PARAMETER;
@@ -118,14 +214,26 @@ int tlb_entry_init( const virt_addr_t * vaddr,
 	return ERR_NONE;							
 }
 
-int tlb_search( const void * mem_space,
-                const virt_addr_t * vaddr,
-                phy_addr_t * paddr,
-                mem_access_t access,
-                l1_itlb_entry_t * l1_itlb,
-                l1_dtlb_entry_t * l1_dtlb,
-                l2_tlb_entry_t * l2_tlb,
-                int* hit_or_miss){
+//what a translation did to each level, at the lines of its page of any size
+typedef struct{
+	uint8_t l1_hit;
+	uint8_t l1_evicted; //a valid entry replaced
+	uint8_t l2_evicted;
+}search_outcome_t;
+
+//tlb_search(), walking through the paging-structure caches pwc (if not NULL) on a miss,
+//telling what it did in outcome (if not NULL)
+static int search_walking( const void * mem_space,
+                           uint32_t cr3,
+                           const virt_addr_t * vaddr,
+                           phy_addr_t * paddr,
+                           mem_access_t access,
+                           l1_itlb_entry_t * l1_itlb,
+                           l1_dtlb_entry_t * l1_dtlb,
+                           l2_tlb_entry_t * l2_tlb,
+                           int* hit_or_miss,
+                           page_walk_cache_t * pwc,
+                           search_outcome_t * outcome){
 					
 
 			M_REQUIRE_NON_NULL(vaddr);		
@@ -149,16 +257,26 @@ int tlb_search( const void * mem_space,
 				tlb = l1_dtlb;
 			}
 			
+			page_size_t page_size = PAGE_4K;
+			const uint16_t asid = CR3_ASID(cr3);
+
+			search_outcome_t outcome_found;
+			if(outcome == NULL){
+				outcome = &outcome_found;
+			}
+			zero_init_ptr(outcome);
+
 			//found in level 1 tlb, tlb_hit handles rest
-			if(tlb_hit(vaddr,paddr,tlb,tlb_type) == 1){
+			if(hit_sized(vaddr,paddr,tlb,tlb_type,asid,&page_size) == 1){
 				
 				*hit_or_miss = 1;	
+				outcome->l1_hit = 1;
 
 			}else{
 				
 				//checking if it's in l2_tlb, if so initializing
 				//and inserting into proper l1_tlb
-				if(tlb_hit(vaddr,paddr,l2_tlb, L2_TLB)){
+				if(hit_sized(vaddr,paddr,l2_tlb, L2_TLB, asid, &page_size)){
 					*hit_or_miss = 1;	
 	
 					size_t line_index = 0;			 
@@ -166,15 +284,19 @@ int tlb_search( const void * mem_space,
 
 					
 					if(tlb_type ==  L1_ITLB){ 		
-						line_index = virt_page_num % L1_ITLB_LINES;		
+						line_index = TLB_LINE_INDEX(virt_page_num >> PAGE_SIZE_SHIFT(page_size), asid, L1_ITLB_LINES);		
 						l1_itlb_entry_t new_l1_itlb_entry;
 						M_EXIT_IF_ERR(tlb_entry_init(vaddr,paddr,&new_l1_itlb_entry,L1_ITLB), "tlb entry initializing");
+						adjust_entry(new_l1_itlb_entry, page_size, asid, L1_ITLB_LINES_BITS);
+						outcome->l1_evicted = l1_itlb[line_index].v;
 						M_EXIT_IF_ERR(tlb_insert(line_index,&new_l1_itlb_entry,l1_itlb,L1_ITLB), "tlb entry inserting");
 
 					}else{
-						line_index = virt_page_num % L1_DTLB_LINES;	
+						line_index = TLB_LINE_INDEX(virt_page_num >> PAGE_SIZE_SHIFT(page_size), asid, L1_DTLB_LINES);	
 						l1_dtlb_entry_t new_l1_dtlb_entry;
 						M_EXIT_IF_ERR(tlb_entry_init(vaddr,paddr,&new_l1_dtlb_entry,L1_DTLB), "tlb entry initializing");
+						adjust_entry(new_l1_dtlb_entry, page_size, asid, L1_DTLB_LINES_BITS);
+						outcome->l1_evicted = l1_dtlb[line_index].v;
 						M_EXIT_IF_ERR(tlb_insert(line_index,&new_l1_dtlb_entry,l1_dtlb,L1_DTLB), "tlb entry inserting");
 					}
 
@@ -187,53 +309,67 @@ int tlb_search( const void * mem_space,
 					
 					*hit_or_miss = 0;
 							
-					M_EXIT_IF_ERR(page_walk(mem_space,vaddr,paddr), "page_walk to acquire physical address");			
+					M_EXIT_IF_ERR(page_walk_cached(mem_space,cr3,vaddr,paddr,pwc,&page_size), "page_walk to acquire physical address");			
 					l2_tlb_entry_t new_l2_tlb_entry;							
 					M_EXIT_IF_ERR(tlb_entry_init(vaddr,paddr,&new_l2_tlb_entry,L2_TLB), "l2 tlb entry initializing");
 		
 					uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr);		
+					adjust_entry(new_l2_tlb_entry, page_size, asid, L2_TLB_LINES_BITS);
+					const uint64_t page_num = virt_page_num >> PAGE_SIZE_SHIFT(page_size);
 					size_t   l1_line_index = 0;
-					size_t   l2_line_index = virt_page_num % L2_TLB_LINES; 
+					size_t   l2_line_index = TLB_LINE_INDEX(page_num, asid, L2_TLB_LINES); 
 	
 					//eviction policy
 					uint8_t valid_replacement = 0;
 					uint32_t adjusted_tag = 0;
+					uint8_t evicted_size = PAGE_4K;
+					uint16_t evicted_asid = 0;
 					
 					//case the "to-be-replaced entry" is valid
 					if(l2_tlb[l2_line_index].v == 1){
 						
 						//adding two bits from l2_line_index in order to 
 						//compare with an 32 bit tag from l1
+						//(the same line of l1 for pages of any size)
+						evicted_size = l2_tlb[l2_line_index].size;
+						evicted_asid = l2_tlb[l2_line_index].asid;
 						adjusted_tag = l2_tlb[l2_line_index].tag << 2;
-						adjusted_tag |= (l2_line_index >> 4);
+						adjusted_tag |= (TLB_LINE_INDEX(l2_line_index, evicted_asid, L2_TLB_LINES) >> 4);
 						valid_replacement = 1;
 					}                   
 
+					outcome->l2_evicted = valid_replacement;
 					M_EXIT_IF_ERR(tlb_insert(l2_line_index,&new_l2_tlb_entry,l2_tlb, L2_TLB),"l2 tlb entry inserting");
 
 					//after inserting a non existing tlb to level 2, we should initialize
 					//and insert into level 1 tlb as well, according to access -tlb_type-
 					if(tlb_type == L1_ITLB){
 						
-						l1_line_index = virt_page_num % L1_ITLB_LINES;				
+						l1_line_index = TLB_LINE_INDEX(page_num, asid, L1_ITLB_LINES);				
 						l1_itlb_entry_t l1_insertion_entry;
 						M_EXIT_IF_ERR(tlb_entry_init(vaddr,paddr, &l1_insertion_entry, L1_ITLB),"l1 tlb entry initializing");
+						adjust_entry(l1_insertion_entry, page_size, asid, L1_ITLB_LINES_BITS);
+						outcome->l1_evicted = l1_itlb[l1_line_index].v;
 						M_EXIT_IF_ERR(tlb_insert(l1_line_index, &l1_insertion_entry,l1_itlb, tlb_type), "l1 tlb entry inserting");	
 						
 						//if there were a valid tag and it corresponds to a entry in other l1_tlb
-						if((valid_replacement == 1) && (l1_dtlb[l1_line_index].tag == adjusted_tag)){
+						if((valid_replacement == 1) && (l1_dtlb[l1_line_index].tag == adjusted_tag)
+							&& l1_dtlb[l1_line_index].size == evicted_size && l1_dtlb[l1_line_index].asid == evicted_asid){
 							l1_dtlb[l1_line_index].v =0;                                                                       
 						}
 					
 
 					}else if(tlb_type == L1_DTLB){	
-						l1_line_index = virt_page_num % L1_DTLB_LINES;
+						l1_line_index = TLB_LINE_INDEX(page_num, asid, L1_DTLB_LINES);
 						l1_dtlb_entry_t l1_insertion_entry;
 						M_EXIT_IF_ERR(tlb_entry_init(vaddr,paddr,&l1_insertion_entry, L1_DTLB),"l1 tlb entry initializing");
+						adjust_entry(l1_insertion_entry, page_size, asid, L1_DTLB_LINES_BITS);
+						outcome->l1_evicted = l1_dtlb[l1_line_index].v;
 						M_EXIT_IF_ERR(tlb_insert(l1_line_index, &l1_insertion_entry,l1_dtlb, tlb_type), "l1 tlb entry inserting");
 						
 						//if there were a valid tag and it corresponds to a entry in other l1_tlb
-						if((valid_replacement == 1) && (l1_itlb[l1_line_index].tag == adjusted_tag)){
+						if((valid_replacement == 1) && (l1_itlb[l1_line_index].tag == adjusted_tag)
+							&& l1_itlb[l1_line_index].size == evicted_size && l1_itlb[l1_line_index].asid == evicted_asid){
 							l1_itlb[l1_line_index].v = 0; 
 						}
 					}		
@@ -244,3 +380,78 @@ int tlb_search( const void * mem_space,
 			
 	return ERR_NONE;				
 }
+
+int tlb_search( const void * mem_space,
+                const virt_addr_t * vaddr,
+                phy_addr_t * paddr,
+                mem_access_t access,
+                l1_itlb_entry_t * l1_itlb,
+                l1_dtlb_entry_t * l1_dtlb,
+                l2_tlb_entry_t * l2_tlb,
+                int* hit_or_miss){
+	return search_walking(mem_space, 0, vaddr, paddr, access, l1_itlb, l1_dtlb, l2_tlb, hit_or_miss, NULL, NULL);
+}
+
+int tlb_search_batch( const void * mem_space,
+                      uint32_t cr3,
+                      const virt_addr_t * vaddrs,
+                      const mem_access_t * accesses,
+                      phy_addr_t * paddrs,
+                      int * hits_or_misses,
+                      size_t nb_addresses,
+                      l1_itlb_entry_t * l1_itlb,
+                      l1_dtlb_entry_t * l1_dtlb,
+                      l2_tlb_entry_t * l2_tlb,
+                      page_walk_cache_t * pwc,
+                      sim_stats_t * stats){
+
+	M_REQUIRE_NON_NULL(vaddrs);
+	M_REQUIRE_NON_NULL(accesses);
+	M_REQUIRE_NON_NULL(paddrs);
+	M_REQUIRE_NON_NULL(hits_or_misses);
+	M_REQUIRE_NON_NULL(l1_itlb);
+	M_REQUIRE_NON_NULL(l1_dtlb);
+	M_REQUIRE_NON_NULL(l2_tlb);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(mem_space, ERR_MEM);
+
+	const uint16_t asid = CR3_ASID(cr3);
+	for(size_t i = 0; i < nb_addresses; ++i){
+		M_REQUIRE(accesses[i] == INSTRUCTION || accesses[i] == DATA, ERR_BAD_PARAMETER,
+			"access asked for address %zu is neither instruction nor data", i);
+
+		//both L1 TLBs have the same entries
+		const l1_itlb_entry_t* const l1_tlb = (accesses[i] == INSTRUCTION) ? l1_itlb : l1_dtlb;
+		const uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(&vaddrs[i]);
+		const size_t index = TLB_LINE_INDEX(virt_page_num, asid, L1_ITLB_LINES);
+
+		const stats_level_t l1_level = (accesses[i] == INSTRUCTION) ? STATS_L1_ITLB : STATS_L1_DTLB;
+
+		//found in level 1 tlb (as a 4 kiB page): nothing else changes
+		if(l1_tlb[index].v == 1 && l1_tlb[index].size == PAGE_4K && l1_tlb[index].asid == asid
+			&& l1_tlb[index].tag == (virt_page_num >> L1_ITLB_LINES_BITS)){
+			paddrs[i].phy_page_num = l1_tlb[index].phy_page_num;
+			paddrs[i].page_offset = vaddrs[i].page_offset;
+			hits_or_misses[i] = 1;
+			HEATMAP_RECORD(l1_level, index, paddrs[i].phy_page_num, HEATMAP_HIT);
+			if(stats != NULL){
+				stats_access(stats, l1_level, TLB_PAGE_KEY(virt_page_num, asid), true);
+			}
+		}else{
+			//an entry of a huge page may still hit in level 1
+			search_outcome_t outcome;
+			M_EXIT_IF_ERR(search_walking(mem_space, cr3, &vaddrs[i], &paddrs[i], accesses[i], l1_itlb, l1_dtlb, l2_tlb,
+				&hits_or_misses[i], pwc, &outcome), "translating address");
+
+			if(stats != NULL){
+				stats_access(stats, l1_level, TLB_PAGE_KEY(virt_page_num, asid), outcome.l1_hit == 1);
+				if(outcome.l1_hit == 0){
+					stats_access(stats, STATS_L2_TLB, TLB_PAGE_KEY(virt_page_num, asid), hits_or_misses[i] == 1);
+				}
+				stats->levels[l1_level].evictions += outcome.l1_evicted;
+				stats->levels[STATS_L2_TLB].evictions += outcome.l2_evicted;
+			}
+		}
+	}
+
+	return ERR_NONE;
+}
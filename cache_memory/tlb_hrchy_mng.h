@@ -11,6 +11,9 @@
 #include "tlb_hrchy.h"
 #include "mem_access.h"
 #include "addr.h"
+#include "stats.h"
+#include "heatmap.h"
+#include "page_walk.h" // for page_walk_cache_t
 
 //some macros in order to fasten the tlb processes
 #define initialize_tlb_entries(tlb_type, nb_entry) \
@@ -19,33 +22,54 @@
 		zero_init_var(ptr[i]); \
 	} \
 
-#define insert_tlb_entry(tlb_entry, line_index, tlb_type, tlb_lines) \
+//entries are only inserted on a miss of their TLB, which the heatmap counts there
+//(tlb_hit() cannot tell the physical page of a miss), with the valid entry replaced
+#ifdef HEATMAP
+#define heatmap_tlb_insertion(old_entry, new_entry, line_index, level) \
+	HEATMAP_RECORD(level, line_index, (new_entry).phy_page_num, HEATMAP_MISS); \
+	if((old_entry).v == 1){ \
+		HEATMAP_RECORD(level, line_index, (old_entry).phy_page_num, HEATMAP_EVICTION); \
+	}
+#else
+#define heatmap_tlb_insertion(old_entry, new_entry, line_index, level)
+#endif
+
+#define insert_tlb_entry(tlb_entry, line_index, tlb_type, tlb_lines, level) \
 	tlb_type *  tlb_to_insert = tlb; \
 	if(line_index < tlb_lines){	\
 		const tlb_type * new_tlb_entry = tlb_entry; \
+		heatmap_tlb_insertion(tlb_to_insert[line_index], *new_tlb_entry, line_index, level) \
 		tlb_to_insert[line_index] = *new_tlb_entry; \
 	}else{ \
 		return ERR_BAD_PARAMETER; \
 	} \
 
 //in case of a match(condition on if) sets the corresponding paddr fields
-//and returns 1 meaning hit 0 otherwise
-#define hit_miss_process(tlb_type, tlb_lines, tlb_lines_bits) \
-	index = virt_page_num % tlb_lines; \
+//and page_size, and returns 1 meaning hit 0 otherwise;
+//the line of each page size is checked in turn, smallest first
+#define hit_miss_process(tlb_type, tlb_lines, tlb_lines_bits, level) \
 	const tlb_type*  new_tlb = tlb; \
-	if(new_tlb[index].v == 1 && (new_tlb[index].tag == (virt_page_num >> tlb_lines_bits))){ \
-		paddr->phy_page_num = new_tlb[index].phy_page_num; \
-		paddr->page_offset = vaddr->page_offset; \
-		return 1; \
-	}else{ \
-		return 0; \
+	for(page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size){ \
+		const uint64_t page_num = virt_page_num >> PAGE_SIZE_SHIFT(size); \
+		index = TLB_LINE_INDEX(page_num, asid, tlb_lines); \
+		if(new_tlb[index].v == 1 && new_tlb[index].size == size && new_tlb[index].asid == asid \
+			&& (new_tlb[index].tag == (page_num >> tlb_lines_bits))){ \
+			paddr->phy_page_num = new_tlb[index].phy_page_num + (virt_page_num & PAGE_SIZE_MASK(size)); \
+			paddr->page_offset = vaddr->page_offset; \
+			*page_size = size; \
+			HEATMAP_RECORD(level, index, paddr->phy_page_num, HEATMAP_HIT); \
+			return 1; \
+		} \
 	} \
+	return 0; \
 
 #define set_init_values(tlb_type, tlb_line_bits) \
 	tlb_type* tlb_init = tlb_entry; \
 	tlb_init->tag = (virt_page_num >>  tlb_line_bits); \
 	tlb_init->phy_page_num = phy_page_num; \
 	tlb_init->v = 1; \
+	tlb_init->size = PAGE_4K; \
+	tlb_init->asid = 0; \
 
 
 //=========================================================================
@@ -60,12 +84,67 @@
 
 int tlb_flush(void *tlb, tlb_t tlb_type);
 
+//=========================================================================
+/**
+ * @brief Invalidate the entries of a page (INVLPG) in the three TLBs:
+ * those of the address space of an ASID mapping the page of an address,
+ * whatever the size of that page.
+ * @param vaddr pointer to virtual address
+ * @param asid the ASID of the address space
+ * @param l1_itlb pointer to the beginning of L1 ITLB
+ * @param l1_dtlb pointer to the beginning of L1 DTLB
+ * @param l2_tlb pointer to the beginning of L2 TLB
+ * @return error code
+ */
+
+int tlb_invalidate_page( const virt_addr_t * vaddr,
+                         uint16_t asid,
+                         l1_itlb_entry_t * l1_itlb,
+                         l1_dtlb_entry_t * l1_dtlb,
+                         l2_tlb_entry_t * l2_tlb);
+
+//=========================================================================
+/**
+ * @brief Invalidate the entries of a virtual range in the three TLBs:
+ * those of the address space of an ASID mapping any of its pages.
+ * @param vaddr pointer to virtual address, in the first page of the range
+ * @param nb_pages number of 4 kiB pages of the range
+ * @param asid the ASID of the address space
+ * @param l1_itlb pointer to the beginning of L1 ITLB
+ * @param l1_dtlb pointer to the beginning of L1 DTLB
+ * @param l2_tlb pointer to the beginning of L2 TLB
+ * @return error code
+ */
+
+int tlb_invalidate_range( const virt_addr_t * vaddr,
+                          uint64_t nb_pages,
+                          uint16_t asid,
+                          l1_itlb_entry_t * l1_itlb,
+                          l1_dtlb_entry_t * l1_dtlb,
+                          l2_tlb_entry_t * l2_tlb);
+
+//=========================================================================
+/**
+ * @brief Invalidate all the entries of an address space in the three TLBs
+ * (shootdown of an ASID), leaving those of the other ones.
+ * @param asid the ASID of the address space
+ * @param l1_itlb pointer to the beginning of L1 ITLB
+ * @param l1_dtlb pointer to the beginning of L1 DTLB
+ * @param l2_tlb pointer to the beginning of L2 TLB
+ * @return error code
+ */
+
+int tlb_invalidate_asid( uint16_t asid,
+                         l1_itlb_entry_t * l1_itlb,
+                         l1_dtlb_entry_t * l1_dtlb,
+                         l2_tlb_entry_t * l2_tlb);
+
 //=========================================================================
 /**
  * @brief Check if a TLB entry exists in the TLB.
  *
  * On hit, return success (1) and update the physical page number passed as the pointer to the function.
- * On miss, return miss (0).
+ * On miss, return miss (0). Only the entries of ASID 0 are looked at.
  *
  * @param vaddr pointer to virtual address
  * @param paddr (modified) pointer to physical address
@@ -112,7 +191,7 @@ int tlb_entry_init( const virt_addr_t * vaddr,
 
 //=========================================================================
 /**
- * @brief Ask TLB for the translation.
+ * @brief Ask TLB for the translation, in the address space of CR3 0 (see addr.h).
  *
  * @param mem_space pointer to the memory space
  * @param vaddr pointer to virtual address
@@ -133,3 +212,40 @@ int tlb_search( const void * mem_space,
                 l1_dtlb_entry_t * l1_dtlb,
                 l2_tlb_entry_t * l2_tlb,
                 int* hit_or_miss);
+
+//=========================================================================
+/**
+ * @brief Ask TLB for the translations of several virtual addresses,
+ *        one after the other, as tlb_search() does for each of them.
+ *
+ * Arguments are checked once and L1 hits are resolved without going
+ * through tlb_search(). On error, translation stops at the faulty address
+ * and the following paddrs/hits_or_misses are left unchanged.
+ *
+ * @param mem_space pointer to the memory space
+ * @param cr3 root of the address space of vaddrs, whose ASID tags the TLB entries (see addr.h)
+ * @param vaddrs the nb_addresses virtual addresses to translate
+ * @param accesses for each address, fetching an instruction or reading/writing data
+ * @param paddrs (modified) the nb_addresses physical addresses
+ * @param hits_or_misses (modified) for each address, hit (1) or miss (0)
+ * @param nb_addresses number of addresses to translate
+ * @param l1_itlb pointer to the beginning of L1 ITLB
+ * @param l1_dtlb pointer to the beginning of L1 DTLB
+ * @param l2_tlb pointer to the beginning of L2 TLB
+ * @param pwc (modified) paging-structure caches the misses of L2 TLB walk through, NULL for none
+ * @param stats (modified) hits, misses and evictions of the three TLBs, NULL for none
+ * @return error code
+ */
+
+int tlb_search_batch( const void * mem_space,
+                      uint32_t cr3,
+                      const virt_addr_t * vaddrs,
+                      const mem_access_t * accesses,
+                      phy_addr_t * paddrs,
+                      int * hits_or_misses,
+                      size_t nb_addresses,
+                      l1_itlb_entry_t * l1_itlb,
+                      l1_dtlb_entry_t * l1_dtlb,
+                      l2_tlb_entry_t * l2_tlb,
+                      page_walk_cache_t * pwc,
+                      sim_stats_t * stats);
@@ -8,6 +8,20 @@
 
 #define SIMPLE_TLB_SIZE 128
 
+//least recently used line
+#define policy_front(POLICY) \
+	(((POLICY)->lru != NULL) ? (POLICY)->lru->front : (POLICY)->ll->front->value)
+
+//line becoming the most recently used one; NODE is its node in ll, if ll is used
+#define policy_move_back(POLICY, LINE, NODE) \
+	do { \
+		if((POLICY)->lru != NULL){ \
+			index_move_back((POLICY)->lru, (uint16_t)(LINE)); \
+		}else{ \
+			(POLICY)->move_back((POLICY)->ll, NODE); \
+		} \
+	} while(0)
+
 //simply set all fields of entries to 0
 int tlb_flush(tlb_entry_t * tlb){
 	
@@ -23,6 +37,33 @@ int tlb_flush(tlb_entry_t * tlb){
 }
 
 
+int tlb_invalidate_range(const virt_addr_t * vaddr,
+                         uint64_t nb_pages,
+                         tlb_entry_t * tlb,
+                         replacement_policy_t * replacement_policy){
+
+	M_REQUIRE_NON_NULL(vaddr);
+	M_REQUIRE_NON_NULL(tlb);
+	M_REQUIRE_NON_NULL(replacement_policy);
+
+	const uint64_t first = virt_addr_t_to_virtual_page_number(vaddr);
+
+	for(int i=0; i<TLB_LINES; i++){
+		
+		if(tlb[i].v == 1 && tlb[i].tag >= first && tlb[i].tag - first < nb_pages){
+			//an invalid line must not be found through the hash
+			if(replacement_policy->hash != NULL){
+				M_EXIT_IF_ERR(tlb_hash_remove(replacement_policy->hash, tlb[i].tag), "removing invalidated tag");
+			}
+			tlb[i].v = 0;
+		}
+		
+	}
+	
+	return ERR_NONE;
+}
+
+
 int tlb_hit(const virt_addr_t * vaddr,
             phy_addr_t * paddr,
             const tlb_entry_t * tlb,
@@ -33,6 +74,30 @@ int tlb_hit(const virt_addr_t * vaddr,
 	}
 	
 	uint64_t virt_page_number = virt_addr_t_to_virtual_page_number(vaddr);
+	
+	//with a hash, the only line which may hold the tag is known at once
+	if(replacement_policy->hash != NULL){
+		const uint16_t index = tlb_hash_find(replacement_policy->hash, virt_page_number);
+		if(index == TLB_HASH_EMPTY || tlb[index].tag != virt_page_number || tlb[index].v != 1){
+			return 0;
+		}
+		paddr->phy_page_num = tlb[index].phy_page_num;
+		paddr->page_offset = vaddr->page_offset;
+		policy_move_back(replacement_policy, index, replacement_policy->hash->nodes[index]);
+		return 1;
+	}
+	
+	if(replacement_policy->lru != NULL){
+		for_all_indices_reverse(index, replacement_policy->lru){
+			if(tlb[index].tag == virt_page_number && tlb[index].v == 1){
+				paddr->phy_page_num = tlb[index].phy_page_num;
+				paddr->page_offset = vaddr->page_offset;
+				index_move_back(replacement_policy->lru, index);
+				return 1;
+			}
+		}
+		return 0;
+	}
 		
 		
 		//going backwards the link list and if there is a hit
@@ -122,9 +187,20 @@ int tlb_search( const void * mem_space,
 			
 			M_EXIT_IF_ERR(tlb_entry_init(vaddr, paddr, &new_tlb_entry), "initializing tlb entry");
 			
-			M_EXIT_IF_ERR(tlb_insert(replacement_policy->ll->front->value, &new_tlb_entry, tlb), "inserting tlb entry");
+			const list_content_t line_index = policy_front(replacement_policy);
+			
+			//the evicted tag leaves the hash, the new one enters it
+			if(replacement_policy->hash != NULL){
+				if(line_index < TLB_LINES && tlb[line_index].v == 1){
+					M_EXIT_IF_ERR(tlb_hash_remove(replacement_policy->hash, tlb[line_index].tag), "removing evicted tag");
+				}
+				M_EXIT_IF_ERR(tlb_hash_insert(replacement_policy->hash, new_tlb_entry.tag, (uint16_t) line_index), 
+					"hashing tlb entry");
+			}
+			
+			M_EXIT_IF_ERR(tlb_insert(line_index, &new_tlb_entry, tlb), "inserting tlb entry");
 
-			replacement_policy->move_back(replacement_policy->ll, replacement_policy->ll->front);
+			policy_move_back(replacement_policy, line_index, replacement_policy->ll->front);
 				
 		}
 			              
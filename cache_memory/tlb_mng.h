@@ -12,6 +12,8 @@
 #include "addr.h"
 #include "list.h"
 #include "addr_mng.h"
+#include "tlb_hash.h"
+#include "index_list.h"
 
 
 typedef struct {
@@ -19,6 +21,13 @@ typedef struct {
 	 list_t* ll;
 	 node_t* (*push_back)(list_t* this, const list_content_t* value);
 	 void (*move_back)(list_t* this, node_t* n);
+	 // optional (may be NULL): finds the line of a tag in O(1) instead of
+	 // walking ll; then the TLB must only be filled through tlb_search(),
+	 // and the hash cleared (tlb_hash_clear()) whenever the TLB is flushed
+	 tlb_hash_t* hash;
+	 // optional (may be NULL): array-backed LRU list of the TLB lines, used
+	 // instead of ll (and the two function pointers), which may then be NULL
+	 index_list_t* lru;
 
 }replacement_policy_t ;
  
@@ -33,6 +42,21 @@ typedef struct {
  */
 int tlb_flush(tlb_entry_t * tlb);
 
+//=========================================================================
+/**
+ * @brief Invalidate the entries of the pages of a virtual range (INVLPG for one page).
+ * Their lines keep their place in the replacement order.
+ * @param vaddr pointer to virtual address, in the first page of the range
+ * @param nb_pages number of pages of the range
+ * @param tlb pointer to the beginning of the TLB
+ * @param replacement_policy the eviction/replacement policy used by the TLB
+ * @return error code
+ */
+int tlb_invalidate_range(const virt_addr_t * vaddr,
+                         uint64_t nb_pages,
+                         tlb_entry_t * tlb,
+                         replacement_policy_t * replacement_policy);
+
 //=========================================================================
 /**
  * @brief Check if a TLB entry exists in the TLB.
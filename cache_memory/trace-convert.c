@@ -0,0 +1,49 @@
+/**
+ * @file trace-convert.c
+ * @brief Convert programs between the text and the binary (see trace_bin.h) formats
+ */
+
+#include "error.h"
+#include "commands.h"
+#include "trace_bin.h"
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || (strcmp(argv[1], "bin") && strcmp(argv[1], "txt"))) {
+        fprintf(stderr, "usage:    %s (bin|txt) input_filename output_filename\n", argv[0]);
+        fprintf(stderr, "examples: %s bin commands.txt commands.bin\n", argv[0]);
+        fprintf(stderr, "          %s txt commands.bin commands.txt\n", argv[0]);
+        return 1;
+    }
+
+    if (!strcmp(argv[1], "bin")) {
+        const int err = trace_convert_to_bin(argv[2], argv[3]);
+        if (err != ERR_NONE) {
+            fprintf(stderr, "Cannot convert \"%s\": %s\n", argv[2], ERR_MESSAGES[err - ERR_NONE]);
+            return 2;
+        }
+        return 0;
+    }
+
+    FILE* out = fopen(argv[3], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot open \"%s\" for writting.\n", argv[3]);
+        return 3;
+    }
+
+    program_t pgm;
+    int err = program_read(argv[2], &pgm);
+    if (err == ERR_NONE) {
+        err = program_print(out, &pgm);
+    }
+    (void)program_free(&pgm);
+    fclose(out);
+
+    if (err != ERR_NONE) {
+        fprintf(stderr, "Cannot convert \"%s\": %s\n", argv[2], ERR_MESSAGES[err - ERR_NONE]);
+        return 2;
+    }
+    return 0;
+}
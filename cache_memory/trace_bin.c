@@ -0,0 +1,286 @@
+/**
+ * @file trace_bin.c
+ * @brief Compact binary format for programs (lists of commands)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h> // for PRIu64
+#include "trace_bin.h"
+#include "commands.h"
+#include "addr_mng.h"
+#include "error.h"
+#include "util.h"
+
+#define BYTE_BITS 8
+#define VARINT_BITS 7
+#define VARINT_MASK 0x7F
+#define VARINT_MORE 0x80
+#define VARINT_MAX_BYTES 10 // ceil(64 / 7)
+
+#define TRACE_BIN_FLAGS (TRACE_BIN_WRITE | TRACE_BIN_DATA | TRACE_BIN_BYTE)
+#define TRACE_BIN_WRITE_BUFFER 4096
+
+//little-endian helpers
+static inline void put_le(uint8_t* buf, uint64_t value, size_t bytes){
+	for(size_t i = 0; i < bytes; ++i){
+		buf[i] = (uint8_t)(value >> (BYTE_BITS * i));
+	}
+}
+
+static inline uint64_t get_le(const uint8_t* buf, size_t bytes){
+	uint64_t value = 0;
+	for(size_t i = 0; i < bytes; ++i){
+		value |= (uint64_t) buf[i] << (BYTE_BITS * i);
+	}
+	return value;
+}
+
+//zigzag encoding keeps small negative differences small
+static inline uint64_t zigzag_encode(uint64_t delta){
+	return (delta << 1) ^ (uint64_t)(-(int64_t)(delta >> 63));
+}
+
+static inline uint64_t zigzag_decode(uint64_t value){
+	return (value >> 1) ^ (uint64_t)(-(int64_t)(value & 1));
+}
+
+int trace_bin_header_read(const uint8_t* buf, size_t len, uint64_t* nb_lines){
+	M_REQUIRE_NON_NULL(buf);
+	M_REQUIRE_NON_NULL(nb_lines);
+
+	if(len < TRACE_BIN_HEADER_SIZE || memcmp(buf, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_SIZE) != 0){
+		return ERR_IO;
+	}
+	M_REQUIRE(get_le(buf + TRACE_BIN_MAGIC_SIZE, sizeof(uint32_t)) == TRACE_BIN_VERSION, ERR_IO,
+		"unsupported binary trace version %" PRIu64, get_le(buf + TRACE_BIN_MAGIC_SIZE, sizeof(uint32_t)));
+
+	*nb_lines = get_le(buf + TRACE_BIN_MAGIC_SIZE + 2 * sizeof(uint32_t), sizeof(uint64_t));
+	return ERR_NONE;
+}
+
+int trace_bin_header_write(uint8_t* buf, uint64_t nb_lines){
+	M_REQUIRE_NON_NULL(buf);
+
+	memcpy(buf, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_SIZE);
+	put_le(buf + TRACE_BIN_MAGIC_SIZE, TRACE_BIN_VERSION, sizeof(uint32_t));
+	put_le(buf + TRACE_BIN_MAGIC_SIZE + sizeof(uint32_t), 0, sizeof(uint32_t));
+	put_le(buf + TRACE_BIN_MAGIC_SIZE + 2 * sizeof(uint32_t), nb_lines, sizeof(uint64_t));
+	return ERR_NONE;
+}
+
+int trace_bin_encode(uint8_t* buf, const command_t* command, uint64_t* prev_vaddr, size_t* size){
+	M_REQUIRE_NON_NULL(buf);
+	M_REQUIRE_NON_NULL(command);
+	M_REQUIRE_NON_NULL(prev_vaddr);
+	M_REQUIRE_NON_NULL(size);
+
+	uint8_t flags = 0;
+	if(command->order == SWITCH){
+		flags = TRACE_BIN_SWITCH;
+	}else if(command->order == INVALIDATE){
+		flags = TRACE_BIN_INVALIDATE;
+	}else{
+		if(command->order == WRITE) flags |= TRACE_BIN_WRITE;
+		if(command->type == DATA) flags |= TRACE_BIN_DATA;
+		if(command->data_size == sizeof(byte_t)) flags |= TRACE_BIN_BYTE;
+	}
+
+	size_t used = 0;
+	buf[used++] = (command->core != 0) ? flags | TRACE_BIN_CORE : flags;
+	if(command->core != 0){
+		buf[used++] = command->core;
+	}
+
+	//context switches keep the previous address for the next difference
+	if(command->order == SWITCH){
+		put_le(buf + used, command->write_data, sizeof(word_t));
+		*size = used + sizeof(word_t);
+		return ERR_NONE;
+	}
+
+	const uint64_t vaddr = virt_addr_t_to_uint64_t(&command->vaddr);
+	uint64_t varint = zigzag_encode(vaddr - *prev_vaddr);
+	*prev_vaddr = vaddr;
+
+	while(varint > VARINT_MASK){
+		buf[used++] = (uint8_t)((varint & VARINT_MASK) | VARINT_MORE);
+		varint >>= VARINT_BITS;
+	}
+	buf[used++] = (uint8_t) varint;
+
+	if(command->order == WRITE || command->order == INVALIDATE){
+		put_le(buf + used, command->write_data, command->data_size);
+		used += command->data_size;
+	}
+
+	*size = used;
+	return ERR_NONE;
+}
+
+int trace_bin_decode(const uint8_t* buf, size_t len, command_t* command, uint64_t* prev_vaddr, size_t* size){
+	M_REQUIRE_NON_NULL(buf);
+	M_REQUIRE_NON_NULL(command);
+	M_REQUIRE_NON_NULL(prev_vaddr);
+	M_REQUIRE_NON_NULL(size);
+
+	if(len == 0){
+		return ERR_EOF;
+	}
+
+	const uint8_t flags = buf[0] & ~TRACE_BIN_CORE;
+	size_t used = 1;
+	uint8_t core = 0;
+	if(buf[0] & TRACE_BIN_CORE){
+		if(len == used){
+			return ERR_EOF;
+		}
+		core = buf[used++];
+	}
+
+	if(flags == TRACE_BIN_SWITCH){
+		if(len - used < sizeof(word_t)){
+			return ERR_EOF;
+		}
+		zero_init_ptr(command);
+		command->order = SWITCH;
+		command->type = DATA;
+		command->data_size = sizeof(word_t);
+		command->write_data = (word_t) get_le(buf + used, sizeof(word_t));
+		command->core = core;
+		*size = used + sizeof(word_t);
+		return ERR_NONE;
+	}
+	M_REQUIRE(flags == TRACE_BIN_INVALIDATE || (flags & ~TRACE_BIN_FLAGS) == 0, ERR_IO,
+		"unknown record flags 0x%02x", buf[0]);
+
+	uint64_t varint = 0;
+	unsigned int shift = 0;
+	uint8_t byte = 0;
+	do{
+		if(used == len){
+			return ERR_EOF;
+		}
+		M_REQUIRE(shift < VARINT_MAX_BYTES * VARINT_BITS, ERR_IO, "varint too long at %zu", used);
+		byte = buf[used++];
+		varint |= (uint64_t)(byte & VARINT_MASK) << shift;
+		shift += VARINT_BITS;
+	}while(byte & VARINT_MORE);
+
+	zero_init_ptr(command);
+	command->order = (flags & TRACE_BIN_INVALIDATE) ? INVALIDATE : (flags & TRACE_BIN_WRITE) ? WRITE : READ;
+	command->type = (flags & (TRACE_BIN_DATA | TRACE_BIN_INVALIDATE)) ? DATA : INSTRUCTION;
+	command->data_size = (flags & TRACE_BIN_BYTE) ? sizeof(byte_t) : sizeof(word_t);
+	command->core = core;
+
+	if(command->order == WRITE || command->order == INVALIDATE){
+		if(len - used < command->data_size){
+			return ERR_EOF;
+		}
+		command->write_data = (word_t) get_le(buf + used, command->data_size);
+		used += command->data_size;
+	}
+
+	const uint64_t vaddr = *prev_vaddr + zigzag_decode(varint);
+	M_EXIT_IF_ERR(init_virt_addr64(&command->vaddr, vaddr), "decoding virtual address");
+
+	*prev_vaddr = vaddr;
+	*size = used;
+	return ERR_NONE;
+}
+
+//writing the records of a batch through a small buffer
+static int write_records(FILE* out, const command_t* commands, size_t nb_lines, uint64_t* prev_vaddr){
+	uint8_t buf[TRACE_BIN_WRITE_BUFFER];
+	size_t used = 0;
+
+	for(size_t i = 0; i < nb_lines; ++i){
+		if(TRACE_BIN_WRITE_BUFFER - used < TRACE_BIN_MAX_RECORD){
+			M_REQUIRE(fwrite(buf, 1, used, out) == used, ERR_IO, "writing %zu bytes", used);
+			used = 0;
+		}
+		size_t size = 0;
+		M_EXIT_IF_ERR(trace_bin_encode(buf + used, &commands[i], prev_vaddr, &size), "encoding command");
+		used += size;
+	}
+
+	M_REQUIRE(fwrite(buf, 1, used, out) == used, ERR_IO, "writing %zu bytes", used);
+	return ERR_NONE;
+}
+
+int program_write_bin(const char* filename, const program_t* program){
+	M_REQUIRE_NON_NULL(filename);
+	M_REQUIRE_NON_NULL(program);
+	M_REQUIRE_NON_NULL(program->listing);
+
+	FILE* out = fopen(filename, "wb");
+	M_REQUIRE(out != NULL, ERR_IO, "cannot open %s", filename);
+
+	uint8_t header[TRACE_BIN_HEADER_SIZE];
+	trace_bin_header_write(header, program->nb_lines);
+	uint64_t prev_vaddr = 0;
+
+	int err = ERR_NONE;
+	if(fwrite(header, 1, TRACE_BIN_HEADER_SIZE, out) != TRACE_BIN_HEADER_SIZE){
+		err = ERR_IO;
+	}
+	if(err == ERR_NONE){
+		err = write_records(out, program->listing, program->nb_lines, &prev_vaddr);
+	}
+
+	if(fclose(out) != 0 && err == ERR_NONE){
+		err = ERR_IO;
+	}
+	return err;
+}
+
+int trace_convert_to_bin(const char* in_filename, const char* out_filename){
+	M_REQUIRE_NON_NULL(in_filename);
+	M_REQUIRE_NON_NULL(out_filename);
+
+	program_stream_t stream;
+	M_EXIT_IF_ERR(program_stream_open(in_filename, &stream, PROGRAM_STREAM_BATCH), "opening trace");
+
+	FILE* out = fopen(out_filename, "wb");
+	if(out == NULL){
+		program_stream_close(&stream);
+		M_EXIT(ERR_IO, "cannot open %s", out_filename);
+	}
+
+	//the number of commands is only known at the end: header is rewritten then
+	uint8_t header[TRACE_BIN_HEADER_SIZE];
+	trace_bin_header_write(header, 0);
+	uint64_t prev_vaddr = 0;
+	uint64_t total = 0;
+
+	int err = ERR_NONE;
+	if(fwrite(header, 1, TRACE_BIN_HEADER_SIZE, out) != TRACE_BIN_HEADER_SIZE){
+		err = ERR_IO;
+	}
+
+	const command_t* batch = NULL;
+	size_t nb_lines = 0;
+	while(err == ERR_NONE){
+		err = program_stream_next(&stream, &batch, &nb_lines);
+		if(err != ERR_NONE || nb_lines == 0){
+			break;
+		}
+		err = write_records(out, batch, nb_lines, &prev_vaddr);
+		total += nb_lines;
+	}
+
+	if(err == ERR_NONE){
+		trace_bin_header_write(header, total);
+		if(fseek(out, 0L, SEEK_SET) != 0 || fwrite(header, 1, TRACE_BIN_HEADER_SIZE, out) != TRACE_BIN_HEADER_SIZE){
+			err = ERR_IO;
+		}
+	}
+
+	program_stream_close(&stream);
+	if(fclose(out) != 0 && err == ERR_NONE){
+		err = ERR_IO;
+	}
+	return err;
+}
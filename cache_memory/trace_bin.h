@@ -0,0 +1,106 @@
+#pragma once
+
+/**
+ * @file trace_bin.h
+ * @brief Compact binary format for programs (lists of commands)
+ *
+ * All integers are little-endian. A file starts with a header:
+ *   - TRACE_BIN_MAGIC (8 bytes)
+ *   - format version (uint32_t)
+ *   - reserved, 0 (uint32_t)
+ *   - number of commands (uint64_t)
+ * followed by one record per command:
+ *   - one flags byte, made of TRACE_BIN_WRITE, TRACE_BIN_DATA and TRACE_BIN_BYTE;
+ *     other bits must be 0
+ *   - the virtual address, as the difference with the virtual address of the
+ *     previous command (0 for the first one), zigzag-encoded into a LEB128 varint
+ *   - for writes only: the data to write, 1 byte for DB and 4 bytes for DW
+ *   - for invalidations only (TRACE_BIN_INVALIDATE): the number of pages (uint32_t)
+ * except for context switches, whose record is the TRACE_BIN_SWITCH flags
+ * byte followed by the new CR3 (uint32_t), without any address.
+ * Commands of a core other than 0 add TRACE_BIN_CORE to their flags,
+ * followed by the core number (one byte) before the rest of their record.
+ *
+ * program_read() and program_stream_open() (see commands.h) recognise this
+ * format by its magic number, so binary traces can be used wherever text ones are.
+ */
+
+#include "commands.h"
+#include <stdint.h>
+#include <stddef.h> // for size_t
+
+#define TRACE_BIN_MAGIC      "PPSTRACE"
+#define TRACE_BIN_MAGIC_SIZE 8
+#define TRACE_BIN_VERSION    1
+#define TRACE_BIN_HEADER_SIZE 24 // magic + version + reserved + number of commands
+
+#define TRACE_BIN_WRITE 0x01 // order is WRITE (READ otherwise)
+#define TRACE_BIN_DATA  0x02 // type is DATA (INSTRUCTION otherwise)
+#define TRACE_BIN_BYTE  0x04 // data size is one byte (one word otherwise)
+#define TRACE_BIN_SWITCH 0x08 // context switch, alone
+#define TRACE_BIN_INVALIDATE 0x10 // invalidation, alone
+#define TRACE_BIN_CORE 0x20 // issued by the core of the next byte (core 0 otherwise), with any of the above
+
+#define TRACE_BIN_MAX_RECORD 16 // flags + core + 10 bytes of varint + 4 bytes of data
+
+//=========================================================================
+/**
+ * @brief Check a binary trace header.
+ * @param buf pointer to the first bytes of the file
+ * @param len number of bytes available in buf
+ * @param nb_lines (modified) number of commands announced by the header
+ * @return ERR_NONE if buf starts with a valid header, ERR_IO otherwise
+ */
+int trace_bin_header_read(const uint8_t* buf, size_t len, uint64_t* nb_lines);
+
+//=========================================================================
+/**
+ * @brief Write a binary trace header.
+ * @param buf (modified) where to write TRACE_BIN_HEADER_SIZE bytes to
+ * @param nb_lines number of commands in the trace
+ * @return ERR_NONE if ok, appropriate error code otherwise
+ */
+int trace_bin_header_write(uint8_t* buf, uint64_t nb_lines);
+
+//=========================================================================
+/**
+ * @brief Encode one command.
+ * @param buf (modified) where to write the record, at least TRACE_BIN_MAX_RECORD bytes
+ * @param command the command to encode
+ * @param prev_vaddr (modified) virtual address of the previous command, updated to this one
+ * @param size (modified) number of bytes written
+ * @return ERR_NONE if ok, appropriate error code otherwise
+ */
+int trace_bin_encode(uint8_t* buf, const command_t* command, uint64_t* prev_vaddr, size_t* size);
+
+//=========================================================================
+/**
+ * @brief Decode one command.
+ * @param buf pointer to the record
+ * @param len number of bytes available in buf
+ * @param command (modified) the decoded command
+ * @param prev_vaddr (modified) virtual address of the previous command, updated to this one
+ * @param size (modified) number of bytes used by the record
+ * @return ERR_NONE if ok, ERR_EOF if the record is not complete within len bytes,
+ *         ERR_IO if it is malformed
+ */
+int trace_bin_decode(const uint8_t* buf, size_t len, command_t* command, uint64_t* prev_vaddr, size_t* size);
+
+//=========================================================================
+/**
+ * @brief Write a whole program to a binary trace file.
+ * @param filename the name of the file to write to
+ * @param program the program to be written
+ * @return ERR_NONE if ok, appropriate error code otherwise
+ */
+int program_write_bin(const char* filename, const program_t* program);
+
+//=========================================================================
+/**
+ * @brief Convert a trace file (text or binary) into a binary trace file,
+ * batch by batch, in constant memory.
+ * @param in_filename the name of the trace to read from
+ * @param out_filename the name of the binary trace to write to
+ * @return ERR_NONE if ok, appropriate error code otherwise
+ */
+int trace_convert_to_bin(const char* in_filename, const char* out_filename);